@@ -12,6 +12,7 @@ static jsmntok_t *jsmn_alloc_token(jsmn_parser *parser,
     tok = &tokens[parser->toknext++];
     tok->start = tok->end = -1;
     tok->size = 0;
+    tok->skip = 1;
 #ifdef JSMN_PARENT_LINKS
     tok->parent = -1;
 #endif
@@ -194,6 +195,7 @@ int jsmn_parse(jsmn_parser *parser, const char *js, size_t len,
 							return JSMN_ERROR_INVAL;
 						}
 						token->end = parser->pos + 1;
+						token->skip = parser->toknext - (token - tokens);
 						parser->toksuper = token->parent;
 						break;
 					}
@@ -214,6 +216,7 @@ int jsmn_parse(jsmn_parser *parser, const char *js, size_t len,
                         }
                         parser->toksuper = -1;
                         token->end = parser->pos + 1;
+                        token->skip = parser->toknext - i;
                         break;
                     }
                 }
@@ -36,12 +36,14 @@ enum jsmnerr {
  * type		type (object, array, string etc.)
  * start	start position in JSON data string
  * end		end position in JSON data string
+ * skip		number of tokens in the subtree including this one, set when a container is closed
  */
 typedef struct {
     jsmntype_t type;
     int start;
     int end;
     int size;
+    int skip;
 #ifdef JSMN_PARENT_LINKS
     int parent;
 #endif
@@ -4,6 +4,11 @@
 
 Account account{};
 
+#define ACCOUNT_KEYS(KEY) \
+    KEY(Account_Key_Id, "id")
+
+DEFINE_JSON_KEYS(Account_Key, json_to_account_key, ACCOUNT_KEYS)
+
 void process_account_data(char *json, u32 data_size, jsmntok_t *&token) {
     for (u32 array_index = 0; array_index < data_size; array_index++) {
         jsmntok_t* object_token = token++;
@@ -17,11 +22,16 @@ void process_account_data(char *json, u32 data_size, jsmntok_t *&token) {
 
             jsmntok_t* next_token = token;
 
-            if (json_string_equals(json, property_token, "id")) {
-                json_token_to_id8(json, next_token, account.id);
-            } else {
-                eat_json(token);
-                token--;
+            switch (json_to_account_key(json, property_token)) {
+                case Account_Key_Id: {
+                    json_token_to_id8(json, next_token, account.id);
+                    break;
+                }
+
+                default: {
+                    json_skip(token);
+                    token--;
+                }
             }
         }
     }
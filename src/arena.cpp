@@ -0,0 +1,130 @@
+#include <mutex>
+#include "arena.h"
+
+static const u32 min_arena_block_size = 64 * 1024;
+static const u32 arena_alignment = 16;
+static const u32 max_pooled_arena_bytes = 128 * 1024 * 1024;
+
+struct Arena_Block {
+    Arena_Block* next;
+    char* data; // Aligned
+    u32 size;
+    u32 used;
+};
+
+// Arenas are built on worker threads and released on the main thread
+static std::mutex arena_pool_mutex;
+static Arena_Block* pooled_blocks = NULL;
+static u32 pooled_bytes = 0;
+
+static inline u32 align_arena_offset(u32 offset, u32 alignment) {
+    return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+// The smallest pooled block which fits, a new one if none does
+static Arena_Block* take_arena_block(u32 min_size) {
+    {
+        std::lock_guard<std::mutex> lock(arena_pool_mutex);
+
+        Arena_Block** best = NULL;
+
+        for (Arena_Block** block = &pooled_blocks; *block; block = &(*block)->next) {
+            if ((*block)->size >= min_size && (!best || (*block)->size < (*best)->size)) {
+                best = block;
+            }
+        }
+
+        if (best) {
+            Arena_Block* result = *best;
+
+            *best = result->next;
+            pooled_bytes -= result->size;
+
+            result->next = NULL;
+            result->used = 0;
+
+            return result;
+        }
+    }
+
+    Arena_Block* block = (Arena_Block*) MALLOC(sizeof(Arena_Block) + min_size + arena_alignment - 1);
+    block->next = NULL;
+    block->data = (char*) (((uintptr_t) (block + 1) + arena_alignment - 1) & ~(uintptr_t) (arena_alignment - 1));
+    block->size = min_size;
+    block->used = 0;
+
+    return block;
+}
+
+static void* arena_alloc_aligned(Arena& arena, u32 size, u32 alignment) {
+    Arena_Block* block = arena.current_block;
+    u32 offset = block ? align_arena_offset(block->used, alignment) : 0;
+
+    if (!block || offset + size > block->size) {
+        u32 previous_size = block ? block->size : 0;
+        u32 block_size = MAX(MAX(previous_size * 2, min_arena_block_size), size);
+
+        Arena_Block* new_block = take_arena_block(block_size);
+
+        if (block) {
+            block->next = new_block;
+        } else {
+            arena.first_block = new_block;
+        }
+
+        arena.current_block = new_block;
+        arena.bytes_reserved += new_block->size;
+
+        block = new_block;
+        offset = 0;
+    }
+
+    block->used = offset + size;
+
+    return block->data + offset;
+}
+
+void* arena_alloc(Arena& arena, u32 size) {
+    return arena_alloc_aligned(arena, size, arena_alignment);
+}
+
+void* arena_calloc(Arena& arena, u32 size) {
+    void* result = arena_alloc(arena, size);
+
+    memset(result, 0, size);
+
+    return result;
+}
+
+void arena_free(Arena& arena) {
+    std::lock_guard<std::mutex> lock(arena_pool_mutex);
+
+    Arena_Block* block = arena.first_block;
+
+    while (block) {
+        Arena_Block* next = block->next;
+
+        if (pooled_bytes + block->size <= max_pooled_arena_bytes) {
+            block->next = pooled_blocks;
+            pooled_blocks = block;
+            pooled_bytes += block->size;
+        } else {
+            FREE(block);
+        }
+
+        block = next;
+    }
+
+    arena = {};
+}
+
+String arena_copy_string(Arena& arena, String& string) {
+    String result;
+    // Strings are packed without alignment, most of them are short
+    result.start = (char*) arena_alloc_aligned(arena, string.length, 1);
+    result.length = string.length;
+
+    memcpy(result.start, string.start, string.length);
+
+    return result;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "common.h"
+
+// Allocations with a shared lifetime, like everything parsed out of one response, which are released together.
+// Blocks are chained, every new block is at least twice as large as the previous one.
+// Released blocks are kept in a pool shared by all arenas, so a freed arena's memory becomes the next arena's memory
+struct Arena_Block;
+
+struct Arena {
+    Arena_Block* first_block;
+    Arena_Block* current_block;
+    u32 bytes_reserved;
+};
+
+// 16 byte aligned, not zeroed. Copied strings are not aligned
+void* arena_alloc(Arena& arena, u32 size);
+void* arena_calloc(Arena& arena, u32 size);
+void arena_free(Arena& arena);
+String arena_copy_string(Arena& arena, String& string);
+
+template <typename T>
+inline T* arena_alloc_array(Arena& arena, u32 length) {
+    return (T*) arena_alloc(arena, sizeof(T) * length);
+}
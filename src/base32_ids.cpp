@@ -0,0 +1,135 @@
+#include "base32_ids.h"
+#include "platform.h"
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+
+// Two groups of 8 characters, first character of each group in the lowest byte
+static inline __m128i decode_two_id_groups(const u8* first, const u8* second) {
+    __m128i chars = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*) first), _mm_loadl_epi64((const __m128i*) second));
+
+    // 'A'..'Z' map to 0..25, '2'..'7' map to 26..31
+    __m128i is_letter = _mm_cmpgt_epi8(chars, _mm_set1_epi8('A' - 1));
+    __m128i offset = _mm_add_epi8(_mm_set1_epi8('2' - 26), _mm_and_si128(is_letter, _mm_set1_epi8('A' - ('2' - 26))));
+    __m128i values = _mm_sub_epi8(chars, offset);
+
+    // Merge neighbours, characters come first in memory but are more significant: 5 -> 10 -> 20 -> 40 bits
+    __m128i pairs = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(values, _mm_set1_epi16(0x00FF)), 5), _mm_srli_epi16(values, 8));
+    __m128i quads = _mm_or_si128(_mm_slli_epi32(_mm_and_si128(pairs, _mm_set1_epi32(0xFFFF)), 10), _mm_srli_epi32(pairs, 16));
+    __m128i groups = _mm_or_si128(_mm_slli_epi64(_mm_and_si128(quads, _mm_set_epi32(0, -1, 0, -1)), 20), _mm_srli_epi64(quads, 32));
+
+    // Low 32 bits of both groups end up in the low half
+    return _mm_shuffle_epi32(groups, _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+#endif
+
+void base32_decode_id_tokens(char* json, jsmntok_t* tokens, u32 num_tokens, u32 group_offset, s32* ids) {
+    u8* base = (u8*) json + group_offset;
+    u32 index = 0;
+
+#if defined(__SSE2__)
+    for (; index + 4 <= num_tokens; index += 4) {
+        jsmntok_t* token = tokens + index;
+
+        __m128i low = decode_two_id_groups(base + token[0].start, base + token[1].start);
+        __m128i high = decode_two_id_groups(base + token[2].start, base + token[3].start);
+
+        _mm_storeu_si128((__m128i*) (ids + index), _mm_unpacklo_epi64(low, high));
+    }
+#endif
+
+    for (; index < num_tokens; index++) {
+        ids[index] = base32_decode_id_group(base + tokens[index].start);
+    }
+}
+
+#if BENCHMARK
+void base32_benchmark_ids() {
+    const u32 num_ids = 100000;
+    const u32 id_length = 16;
+
+    s32* expected_ids = (s32*) malloc(sizeof(s32) * num_ids);
+    s32* decoded_ids = (s32*) malloc(sizeof(s32) * num_ids);
+    char* json = (char*) malloc(num_ids * id_length);
+    u8* encoded = (u8*) malloc(num_ids * id_length);
+    jsmntok_t* tokens = (jsmntok_t*) malloc(sizeof(jsmntok_t) * num_ids);
+
+    srand(3637);
+
+    for (u32 index = 0; index < num_ids; index++) {
+        expected_ids[index] = (s32) (((u32) rand() << 16) ^ (u32) rand());
+
+        tokens[index].type = JSMN_STRING;
+        tokens[index].start = index * id_length;
+        tokens[index].end = tokens[index].start + id_length;
+        tokens[index].size = 0;
+        tokens[index].parent = -1;
+    }
+
+    // Reference encoder, also produces the input for the decoders
+    u64 encode_start = platform_get_app_time_precise();
+
+    for (u32 index = 0; index < num_ids; index++) {
+        s32 id = expected_ids[index];
+        u8 input[] = { 'A', 0, 0, 0, 42, 'T', (u8) (id >> 24), (u8) (id >> 16), (u8) (id >> 8), (u8) id };
+
+        base32_encode(input, ARRAY_SIZE(input), (u8*) json + index * id_length);
+    }
+
+    float reference_encode_time = platform_get_delta_time_ms(encode_start);
+
+    encode_start = platform_get_app_time_precise();
+
+    for (u32 index = 0; index < num_ids; index++) {
+        fill_id16('A', 42, 'T', expected_ids[index], encoded + index * id_length);
+    }
+
+    float encode_time = platform_get_delta_time_ms(encode_start);
+    bool same_encoding = memcmp(encoded, json, num_ids * id_length) == 0;
+
+    u64 decode_start = platform_get_app_time_precise();
+
+    for (u32 index = 0; index < num_ids; index++) {
+        u8 result[UNBASE32_LEN(16)];
+
+        base32_decode((u8*) json + tokens[index].start, 16, result);
+
+        decoded_ids[index] = (s32) (((u32) result[6] << 24) | ((u32) result[7] << 16) | ((u32) result[8] << 8) | result[9]);
+    }
+
+    float reference_decode_time = platform_get_delta_time_ms(decode_start);
+    bool same_reference = memcmp(decoded_ids, expected_ids, sizeof(s32) * num_ids) == 0;
+
+    decode_start = platform_get_app_time_precise();
+
+    for (u32 index = 0; index < num_ids; index++) {
+        decoded_ids[index] = base32_decode_id_group((u8*) json + tokens[index].start + 8);
+    }
+
+    float single_decode_time = platform_get_delta_time_ms(decode_start);
+    bool same_single = memcmp(decoded_ids, expected_ids, sizeof(s32) * num_ids) == 0;
+
+    memset(decoded_ids, 0, sizeof(s32) * num_ids);
+
+    decode_start = platform_get_app_time_precise();
+
+    base32_decode_id_tokens(json, tokens, num_ids, 8, decoded_ids);
+
+    float batch_decode_time = platform_get_delta_time_ms(decode_start);
+    bool same_batch = memcmp(decoded_ids, expected_ids, sizeof(s32) * num_ids) == 0;
+
+    printf("Base32 benchmark on %u ids: encode base32.c %.3fms, fill_id16 %.3fms, decode base32.c %.3fms, single %.3fms, batch %.3fms, %s\n",
+           num_ids, reference_encode_time, encode_time, reference_decode_time, single_decode_time, batch_decode_time,
+           same_encoding && same_reference && same_single && same_batch ? "same output" : "OUTPUT MISMATCH"
+    );
+
+    free(expected_ids);
+    free(decoded_ids);
+    free(json);
+    free(encoded);
+    free(tokens);
+}
+#endif
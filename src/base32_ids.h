@@ -0,0 +1,14 @@
+#pragma once
+
+#include "common.h"
+#include <jsmn.h>
+
+// Decodes the s32 from the 8 character group at group_offset (0 for id8, 8 for the right part
+//  of id16) of every token, 4 tokens at a time when SSE2 is available.
+// Every token has to be at least group_offset + 8 characters long.
+void base32_decode_id_tokens(char* json, jsmntok_t* tokens, u32 num_tokens, u32 group_offset, s32* ids);
+
+#if BENCHMARK
+// Compares the ID decoders and encoders against base32.c and prints the timings
+void base32_benchmark_ids();
+#endif
@@ -0,0 +1,44 @@
+#include "benchmark.h"
+#include "base32_ids.h"
+#include "id_hash_map.h"
+#include "search.h"
+#include "task_list.h"
+#include <cstring>
+#include <cstdio>
+
+bool benchmark_network = false;
+bool benchmark_json_tokenizers = false;
+
+bool run_benchmarks(int argc, char** argv) {
+    bool start_app = false;
+
+    if (argc < 2) {
+        printf("Usage: %s [network] [json] [base32] [hash_map] [search] [task_list]\n", argv[0]);
+        return false;
+    }
+
+    for (int arg = 1; arg < argc; arg++) {
+        const char* name = argv[arg];
+
+        if (strcmp(name, "network") == 0) {
+            benchmark_network = true;
+            start_app = true;
+        } else if (strcmp(name, "json") == 0) {
+            benchmark_json_tokenizers = true;
+            start_app = true;
+        } else if (strcmp(name, "base32") == 0) {
+            base32_benchmark_ids();
+        } else if (strcmp(name, "hash_map") == 0) {
+            id_hash_map_benchmark();
+        } else if (strcmp(name, "search") == 0) {
+            search_benchmark();
+        } else if (strcmp(name, "task_list") == 0) {
+            task_list_benchmark();
+        } else {
+            printf("Unknown benchmark %s\n", name);
+            return false;
+        }
+    }
+
+    return start_app;
+}
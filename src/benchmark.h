@@ -0,0 +1,17 @@
+#pragma once
+
+#include "common.h"
+
+// Only compiled into the wrike-imgui-benchmark executable, which is built with BENCHMARK=1
+//  wrike-imgui-benchmark [network] [json] [base32] [hash_map] [search] [task_list]
+// base32, hash_map, search and task_list run on synthetic data and exit,
+// network and json keep the app running and print timings for every response
+
+// Connection timings of every finished transfer
+extern bool benchmark_network;
+
+// Every response is tokenized with both tokenizers, the result comes from the selected one
+extern bool benchmark_json_tokenizers;
+
+// Called after platform_early_init, returns false when the app should not start
+bool run_benchmarks(int argc, char** argv);
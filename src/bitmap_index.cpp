@@ -0,0 +1,188 @@
+#include "bitmap_index.h"
+
+void value_bitmap_index_init(Value_Bitmap_Index& index, u32 num_ids) {
+    index.num_ids = num_ids;
+
+    id_hash_map_init(&index.value_to_set);
+}
+
+void value_bitmap_index_destroy(Value_Bitmap_Index& index) {
+    for (u32 set_index = 0; set_index < index.sets.length; set_index++) {
+        Id_Set* set = &index.sets[set_index];
+
+        if (set->ids) FREE(set->ids);
+        if (set->words) FREE(set->words);
+    }
+
+    if (index.sets.data) lazy_array_clear(index.sets);
+
+    id_hash_map_destroy(&index.value_to_set);
+}
+
+void value_bitmap_index_count(Value_Bitmap_Index& index, s32 value) {
+    u32 hash = hash_id(value);
+    s32 set_index = id_hash_map_get(&index.value_to_set, value, hash);
+
+    if (set_index == -1) {
+        set_index = (s32) index.sets.length;
+
+        Id_Set* set = lazy_array_add_n_values(index.sets, 1);
+        *set = {};
+
+        id_hash_map_put(&index.value_to_set, set_index, value, hash);
+    }
+
+    index.sets[set_index].cardinality++;
+}
+
+void value_bitmap_index_allocate(Value_Bitmap_Index& index) {
+    u32 num_words = bitmap_words_for_ids(index.num_ids);
+
+    for (u32 set_index = 0; set_index < index.sets.length; set_index++) {
+        Id_Set* set = &index.sets[set_index];
+
+        if (set->cardinality * sizeof(u32) > num_words * sizeof(u64)) {
+            set->words = (u64*) CALLOC(num_words, sizeof(u64));
+        } else {
+            set->ids = (u32*) MALLOC(sizeof(u32) * set->cardinality);
+        }
+
+        set->cardinality = 0;
+    }
+}
+
+void value_bitmap_index_add(Value_Bitmap_Index& index, s32 value, u32 id) {
+    Id_Set* set = value_bitmap_index_find(index, value);
+
+    assert(set);
+
+    if (set->words) {
+        if (!bitmap_test(set->words, id)) {
+            bitmap_set(set->words, id);
+            set->cardinality++;
+        }
+    } else if (!set->cardinality || set->ids[set->cardinality - 1] != id) {
+        // The same value can be listed twice for an id, like a duplicate assignee
+        set->ids[set->cardinality++] = id;
+    }
+}
+
+// First position with an id not less than the given one
+static u32 id_set_lower_bound(Id_Set* set, u32 id) {
+    u32 low = 0, high = set->cardinality;
+
+    while (low < high) {
+        u32 middle = (low + high) / 2;
+
+        if (set->ids[middle] < id) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+void value_bitmap_index_insert(Value_Bitmap_Index& index, s32 value, u32 id) {
+    Id_Set* set = value_bitmap_index_find(index, value);
+
+    if (!set) {
+        s32 set_index = (s32) index.sets.length;
+
+        set = lazy_array_add_n_values(index.sets, 1);
+        *set = {};
+
+        id_hash_map_put(&index.value_to_set, set_index, value, hash_id(value));
+    }
+
+    if (set->words) {
+        if (!bitmap_test(set->words, id)) {
+            bitmap_set(set->words, id);
+            set->cardinality++;
+        }
+
+        return;
+    }
+
+    u32 position = id_set_lower_bound(set, id);
+
+    if (position < set->cardinality && set->ids[position] == id) {
+        return;
+    }
+
+    u32 num_words = bitmap_words_for_ids(index.num_ids);
+
+    // Same threshold as when the sets are allocated
+    if ((set->cardinality + 1) * sizeof(u32) > num_words * sizeof(u64)) {
+        set->words = (u64*) CALLOC(num_words, sizeof(u64));
+
+        for (u32 id_index = 0; id_index < set->cardinality; id_index++) {
+            bitmap_set(set->words, set->ids[id_index]);
+        }
+
+        if (set->ids) FREE(set->ids);
+
+        set->ids = NULL;
+
+        bitmap_set(set->words, id);
+        set->cardinality++;
+
+        return;
+    }
+
+    set->ids = (u32*) REALLOC(set->ids, sizeof(u32) * (set->cardinality + 1));
+
+    memmove(set->ids + position + 1, set->ids + position, sizeof(u32) * (set->cardinality - position));
+
+    set->ids[position] = id;
+    set->cardinality++;
+}
+
+void value_bitmap_index_remove(Value_Bitmap_Index& index, s32 value, u32 id) {
+    Id_Set* set = value_bitmap_index_find(index, value);
+
+    if (!set) {
+        return;
+    }
+
+    // Dense sets stay dense
+    if (set->words) {
+        if (bitmap_test(set->words, id)) {
+            set->words[id / 64] &= ~(1ull << (id % 64));
+            set->cardinality--;
+        }
+
+        return;
+    }
+
+    u32 position = id_set_lower_bound(set, id);
+
+    if (position < set->cardinality && set->ids[position] == id) {
+        memmove(set->ids + position, set->ids + position + 1, sizeof(u32) * (set->cardinality - position - 1));
+
+        set->cardinality--;
+    }
+}
+
+Id_Set* value_bitmap_index_find(Value_Bitmap_Index& index, s32 value) {
+    s32 set_index = id_hash_map_get(&index.value_to_set, value, hash_id(value));
+
+    if (set_index == -1) {
+        return NULL;
+    }
+
+    return &index.sets[set_index];
+}
+
+void id_set_or_into_bitmap(Id_Set* set, u64* words, u32 num_words) {
+    if (set->words) {
+        for (u32 word = 0; word < num_words; word++) {
+            words[word] |= set->words[word];
+        }
+    } else {
+        for (u32 id_index = 0; id_index < set->cardinality; id_index++) {
+            bitmap_set(words, set->ids[id_index]);
+        }
+    }
+}
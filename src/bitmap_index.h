@@ -0,0 +1,49 @@
+#pragma once
+
+#include "common.h"
+#include "lazy_array.h"
+#include "id_hash_map.h"
+
+// Sets of dense u32 ids (task indices, usually) for filtering. Like roaring bitmap containers, a set is kept
+//  as a sorted array of ids while that takes less memory than a bitmap over all ids, and as a bitmap otherwise.
+// Queries combine sets into plain word bitmaps where predicates are then intersected a word at a time.
+struct Id_Set {
+    u32* ids; // Sorted, NULL when the set is dense
+    u64* words; // NULL when the set is sparse
+    u32 cardinality;
+};
+
+// Set of ids for every distinct value, built in two passes over the ids:
+//  every (value, id) pair is counted first, then added again in the same order after allocating the sets
+struct Value_Bitmap_Index {
+    Id_Hash_Map<s32, s32, -1> value_to_set{};
+    Lazy_Array<Id_Set, 16> sets{};
+    u32 num_ids;
+};
+
+inline u32 bitmap_words_for_ids(u32 num_ids) {
+    return (num_ids + 63) / 64;
+}
+
+inline bool bitmap_test(u64* words, u32 id) {
+    return (words[id / 64] >> (id % 64)) & 1;
+}
+
+inline void bitmap_set(u64* words, u32 id) {
+    words[id / 64] |= 1ull << (id % 64);
+}
+
+void value_bitmap_index_init(Value_Bitmap_Index& index, u32 num_ids);
+void value_bitmap_index_destroy(Value_Bitmap_Index& index);
+void value_bitmap_index_count(Value_Bitmap_Index& index, s32 value);
+// Picks the container of every set once all values are counted
+void value_bitmap_index_allocate(Value_Bitmap_Index& index);
+// Ids have to be added in increasing order
+void value_bitmap_index_add(Value_Bitmap_Index& index, s32 value, u32 id);
+// For changes after the index is built, ids can come in any order
+void value_bitmap_index_insert(Value_Bitmap_Index& index, s32 value, u32 id);
+void value_bitmap_index_remove(Value_Bitmap_Index& index, s32 value, u32 id);
+// NULL if no id has the value
+Id_Set* value_bitmap_index_find(Value_Bitmap_Index& index, s32 value);
+
+void id_set_or_into_bitmap(Id_Set* set, u64* words, u32 num_words);
@@ -83,169 +83,157 @@ void load_png_from_disk_async(const char* path, Image_Load_Callback callback) {
     }
 }
 
-s32 _min(s32 d0, s32 d1, s32 d2, s32 bx, s32 ay)
-{
-    return d0 < d1 || d2 < d1
-           ? d0 > d2
-             ? d2 + 1
-             : d0 + 1
-           : bx == ay
-                    ? d1
-                    : d1 + 1;
-}
+void myers_build_equalities(const char* pattern, u32 pattern_length, u64* equalities) {
+    u32 num_blocks = MYERS_NUM_BLOCKS(pattern_length);
 
-s32 hackenstein(const char* a, const char* b, u32 a_length, u32 b_length) {
-    if (a == b) {
-        return 0;
+    memset(equalities, 0, sizeof(u64) * 256 * num_blocks);
+
+    for (u32 index = 0; index < pattern_length; index++) {
+        equalities[(u8) pattern[index] * num_blocks + index / 64] |= 1ull << (index % 64);
     }
+}
 
-    if (a_length > b_length) {
-        const char* tmp_char = a;
-        a = b;
-        b = tmp_char;
+// Hyyro's blocked version of Myers' bit-vector algorithm, 64 pattern characters per block.
+// Only the rows below the last pattern character are garbage in the last block and carries never move
+//  information down, so the score is read from the real last row instead of padding the pattern.
+u32 myers_edit_distance_with_equalities(const u64* equalities, u32 pattern_length, const char* text, u32 text_length, bool anywhere_in_text) {
+    if (!pattern_length) {
+        return anywhere_in_text ? 0 : text_length;
+    }
 
-        u32 tmp_l = a_length;
-        a_length = b_length;
-        b_length = tmp_l;
+    if (!text_length) {
+        return pattern_length;
     }
 
-    u32 la = a_length;
-    u32 lb = b_length;
+    const u32 stack_blocks = 4;
 
-    // TODO can be done using char*?
-    while (la > 0 && (a[la - 1] == b[lb - 1])) {
-        la--;
-        lb--;
-    }
+    u32 num_blocks = MYERS_NUM_BLOCKS(pattern_length);
 
-    u32 offset = 0;
+    // Search queries are almost always shorter than 64 characters
+    if (num_blocks == 1) {
+        const u64 last_row_bit = 1ull << (pattern_length - 1);
+        const u64 top_row = anywhere_in_text ? 0 : 1;
 
-    while (offset < la && (a[offset] == b[offset])) {
-        offset++;
-    }
+        u64 pv = ~0ull;
+        u64 mv = 0;
 
-    la -= offset;
-    lb -= offset;
+        u32 score = pattern_length;
+        u32 best_score = score;
 
-    if (la == 0 || lb == 1) {
-        return lb;
-    }
+        for (u32 text_index = 0; text_index < text_length; text_index++) {
+            u64 eq = equalities[(u8) text[text_index]];
 
-    s32 x = 0;
-    s32 y;
-    s32 d0;
-    s32 d1;
-    s32 d2;
-    s32 d3;
-    s32 dd = 0;
-    s32 dy;
-    s32 ay;
-    s32 bx0;
-    s32 bx1;
-    s32 bx2;
-    s32 bx3;
-
-    static s32 vector[256];
-    static u32 vector_head;
-
-    vector_head = 0;
-
-    for (y = 0; y < la; y++) {
-        vector[vector_head++] = y + 1;
-        vector[vector_head++] = a[offset + y];
-    }
+            u64 xv = eq | mv;
+            u64 xh = (((eq & pv) + pv) ^ pv) | eq;
+            u64 ph = mv | ~(xh | pv);
+            u64 mh = pv & xh;
+
+            score += (ph & last_row_bit) != 0;
+            score -= (mh & last_row_bit) != 0;
+            best_score = MIN(best_score, score);
+
+            ph = (ph << 1) | top_row;
+            mh <<= 1;
 
-    for (; (x + 3) < lb;) {
-        bx0 = b[offset + (d0 = x)];
-        bx1 = b[offset + (d1 = x + 1)];
-        bx2 = b[offset + (d2 = x + 2)];
-        bx3 = b[offset + (d3 = x + 3)];
-        dd = (x += 4);
-        for (y = 0; y < vector_head; y += 2) {
-            dy = vector[y];
-            ay = vector[y + 1];
-            d0 = _min(dy, d0, d1, bx0, ay);
-            d1 = _min(d0, d1, d2, bx1, ay);
-            d2 = _min(d1, d2, d3, bx2, ay);
-            dd = _min(d2, d3, dd, bx3, ay);
-            vector[y] = dd;
-            d3 = d2;
-            d2 = d1;
-            d1 = d0;
-            d0 = dy;
+            pv = mh | ~(xv | ph);
+            mv = ph & xv;
         }
+
+        return anywhere_in_text ? best_score : score;
     }
-    for (; x < lb;) {
-        bx0 = b[offset + (d0 = x)];
-        dd = ++x;
-        for (y = 0; y < vector_head; y += 2) {
-            dy = vector[y];
-            vector[y] = dd = dy < d0 || dd < d0
-                             ? dy > dd ? dd + 1 : dy + 1
-                             : bx0 == vector[y + 1]
-                                        ? d0
-                                        : d0 + 1;
-            d0 = dy;
-        }
+
+    u64 stack_vertical[2 * stack_blocks];
+    u64* vertical = num_blocks <= stack_blocks ? stack_vertical : (u64*) MALLOC(sizeof(u64) * 2 * num_blocks);
+
+    u64* positive_vertical = vertical;
+    u64* negative_vertical = vertical + num_blocks;
+
+    for (u32 block = 0; block < num_blocks; block++) {
+        positive_vertical[block] = ~0ull;
+        negative_vertical[block] = 0;
     }
 
-    return dd;
-};
+    const u64 high_bit = 1ull << 63;
+    const u64 last_row_bit = 1ull << ((pattern_length - 1) % 64);
 
-int levenshtein(const char* a, const char* b, u32 a_length, u32 b_length) {
-    static int levenstein_cache[1024];
+    u32 score = pattern_length;
+    u32 best_score = score;
 
-    assert(a_length <= ARRAY_SIZE(levenstein_cache));
+    for (u32 text_index = 0; text_index < text_length; text_index++) {
+        const u64* text_equalities = equalities + (u8) text[text_index] * num_blocks;
 
-    int index = 0;
-    int bIndex = 0;
-    int distance;
-    int bDistance;
-    int result;
-    char code;
+        // Horizontal delta coming into the top of the column, the first row is all zeroes when matching
+        //  anywhere in the text and counts up otherwise
+        s32 horizontal = anywhere_in_text ? 0 : 1;
 
-    /* Shortcut optimizations / degenerate cases. */
-    if (a == b) {
-        return 0;
-    }
+        for (u32 block = 0; block < num_blocks; block++) {
+            u64 pv = positive_vertical[block];
+            u64 mv = negative_vertical[block];
+            u64 eq = text_equalities[block];
 
-    if (a_length == 0) {
-        return b_length;
-    }
+            u64 carry_negative = horizontal < 0 ? 1 : 0;
+            u64 carry_positive = horizontal > 0 ? 1 : 0;
+
+            u64 xv = eq | mv;
+            eq |= carry_negative;
 
-    if (b_length == 0) {
-        return a_length;
+            u64 xh = (((eq & pv) + pv) ^ pv) | eq;
+            u64 ph = mv | ~(xh | pv);
+            u64 mh = pv & xh;
+
+            u64 out_bit = block == num_blocks - 1 ? last_row_bit : high_bit;
+
+            horizontal = (ph & out_bit) ? 1 : (mh & out_bit) ? -1 : 0;
+
+            ph = (ph << 1) | carry_positive;
+            mh = (mh << 1) | carry_negative;
+
+            positive_vertical[block] = mh | ~(xv | ph);
+            negative_vertical[block] = ph & xv;
+        }
+
+        score += horizontal;
+        best_score = MIN(best_score, score);
     }
 
-    /* initialize the vector. */
-    while (index < a_length) {
-        levenstein_cache[index] = index + 1;
-        index++;
+    if (vertical != stack_vertical) {
+        FREE(vertical);
     }
 
-    /* Loop. */
-    while (bIndex < b_length) {
-        code = b[bIndex];
-        result = distance = bIndex++;
-        index = -1;
-
-        while (++index < a_length) {
-            bDistance = code == a[index] ? distance : distance + 1;
-            distance = levenstein_cache[index];
-
-            levenstein_cache[index] = result = distance > result
-                                               ? bDistance > result
-                                                 ? result + 1
-                                                 : bDistance
-                                               : bDistance > distance
-                                                 ? distance + 1
-                                                 : bDistance;
-        }
+    return anywhere_in_text ? best_score : score;
+}
+
+u32 myers_edit_distance(const char* pattern, u32 pattern_length, const char* text, u32 text_length, bool anywhere_in_text) {
+    const u32 stack_blocks = 4;
+
+    u32 num_blocks = MYERS_NUM_BLOCKS(pattern_length);
+
+    u64 stack_equalities[256 * stack_blocks];
+    u64* equalities = num_blocks <= stack_blocks ? stack_equalities : (u64*) MALLOC(sizeof(u64) * 256 * num_blocks);
+
+    myers_build_equalities(pattern, pattern_length, equalities);
+
+    u32 result = myers_edit_distance_with_equalities(equalities, pattern_length, text, text_length, anywhere_in_text);
+
+    if (equalities != stack_equalities) {
+        FREE(equalities);
     }
 
     return result;
 }
 
+s32 hackenstein(const char* a, const char* b, u32 a_length, u32 b_length) {
+    if (a == b) {
+        return 0;
+    }
+
+    return (s32) myers_edit_distance(a, a_length, b, b_length, false);
+}
+
+int levenshtein(const char* a, const char* b, u32 a_length, u32 b_length) {
+    return hackenstein(a, b, a_length, b_length);
+}
+
 char* string_in_substring(const s8* big, const s8* small, size_t slen) {
     s8 c, sc;
     size_t len;
@@ -265,7 +253,111 @@ char* string_in_substring(const s8* big, const s8* small, size_t slen) {
     return ((char*) big);
 }
 
+#if DEBUG_MEMORY
+// String arguments are often temporary themselves, like names formatted earlier in the frame.
+// Walks the conversions to find them, stops at anything it doesn't know how to skip
+static void check_temporary_string_arguments(const char* format, va_list args) {
+    va_list args_copy;
+    va_copy(args_copy, args);
+
+    for (const char* c = format; *c; c++) {
+        if (*c != '%') {
+            continue;
+        }
+
+        c++;
+
+        if (*c == '%') {
+            continue;
+        }
+
+        while (*c && strchr("-+ #0", *c)) c++;
+
+        if (*c == '*') {
+            va_arg(args_copy, int);
+            c++;
+        } else {
+            while (isdigit(*c)) c++;
+        }
+
+        s32 precision = -1;
+
+        if (*c == '.') {
+            c++;
+
+            if (*c == '*') {
+                precision = va_arg(args_copy, int);
+                c++;
+            } else {
+                precision = 0;
+
+                while (isdigit(*c)) precision = precision * 10 + (*c++ - '0');
+            }
+        }
+
+        u32 num_longs = 0;
+        bool is_size = false;
+
+        for (; *c && strchr("hlzjt", *c); c++) {
+            if (*c == 'l') {
+                num_longs++;
+            } else if (*c != 'h') {
+                is_size = true;
+            }
+        }
+
+        switch (*c) {
+            case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c': {
+                if (num_longs >= 2) {
+                    va_arg(args_copy, long long);
+                } else if (num_longs == 1) {
+                    va_arg(args_copy, long);
+                } else if (is_size) {
+                    va_arg(args_copy, size_t);
+                } else {
+                    va_arg(args_copy, int);
+                }
+
+                break;
+            }
+
+            case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A': {
+                va_arg(args_copy, double);
+                break;
+            }
+
+            case 'p': {
+                va_arg(args_copy, void*);
+                break;
+            }
+
+            case 's': {
+                const char* string = va_arg(args_copy, const char*);
+
+                // Empty strings are not read, they can point right past the end of an allocation
+                if (string && precision != 0) {
+                    TEMPORARY_STORAGE_CHECK_IF_TEMPORARY(string);
+                }
+
+                break;
+            }
+
+            default: {
+                va_end(args_copy);
+                return;
+            }
+        }
+    }
+
+    va_end(args_copy);
+}
+#endif
+
 PRINTLIKE(1, 0) String tprintf(const char* format, va_list args) {
+#if DEBUG_MEMORY
+    check_temporary_string_arguments(format, args);
+#endif
+
     va_list args_copy;
     va_copy(args_copy, args);
 
@@ -299,6 +391,10 @@ PRINTLIKE(1, 4) void tprintf(const char* format, char** start, char** end, ...)
     va_list args;
     va_start(args, end);
 
+#if DEBUG_MEMORY
+    check_temporary_string_arguments(format, args);
+#endif
+
     va_list args_copy;
     va_copy(args_copy, args);
 
@@ -54,6 +54,15 @@ void* calloc_and_log(const char* file, const char* function, u32 line, size_t nu
 void* malloc_and_log(const char* file, const char* function, u32 line, size_t size);
 void* realloc_and_log(const char* file, const char* function, u32 line, void* realloc_what, size_t new_size);
 void free_and_log(const char* file, const char* function, u32 line, void* free_what);
+
+#define TEMPORARY_STORAGE_CHECK(x) temporary_storage_check(__FILE__, __LINE__, x)
+#define TEMPORARY_STORAGE_CHECK_IF_TEMPORARY(x) temporary_storage_check_if_temporary(__FILE__, __LINE__, x)
+
+// Fires if the pointer was allocated on another thread, was released by a reset or the end of the frame,
+//  or is not temporary storage at all
+void temporary_storage_check(const char* file, u32 line, const void* pointer);
+// Same, but pointers which are not in any temporary storage are fine, like string arguments which may or may not be temporary
+void temporary_storage_check_if_temporary(const char* file, u32 line, const void* pointer);
 #else
 
 #define MALLOC(x) malloc(x)
@@ -62,6 +71,9 @@ void free_and_log(const char* file, const char* function, u32 line, void* free_w
 #define FREE(x) free(x)
 #define LOG_MEMORY(x, y) ((void) 0)
 
+#define TEMPORARY_STORAGE_CHECK(x) ((void) 0)
+#define TEMPORARY_STORAGE_CHECK_IF_TEMPORARY(x) ((void) 0)
+
 #endif
 
 const u32 color_background_dark = argb_to_agbr(0xFF1d364c);
@@ -130,6 +142,8 @@ void list_try_resize(Temporary_List<T>* array) {
 
 template<typename T>
 u32 list_add(Temporary_List<T>* array, T value) {
+    if (array->values) TEMPORARY_STORAGE_CHECK(array->values);
+
     list_try_resize(array);
 
     array->values[array->length] = value;
@@ -139,6 +153,8 @@ u32 list_add(Temporary_List<T>* array, T value) {
 
 template<typename T>
 Array<T> list_to_array(Temporary_List<T>* array) {
+    if (array->values) TEMPORARY_STORAGE_CHECK(array->values);
+
     Array<T> result;
     result.data = array->values;
     result.length = array->length;
@@ -189,33 +205,40 @@ inline s32 uchars_to_s32(const u8* chars) {
             ((chars[3] & 0xff)      ));
 }
 
+// IDs are 5 bytes (a type byte followed by a big endian s32) encoded as 8 base32 characters,
+//  or two of those back to back. Only valid [A-Z2-7] characters are expected, no padding.
+inline u8 base32_char_to_bits(u8 c) {
+    return c >= 'A' ? c - 'A' : c - '2' + 26;
+}
+
+// The s32 lives in the low 32 bits of the 40 decoded, so the first character can be skipped
+inline s32 base32_decode_id_group(const u8* coded) {
+    u64 bits = 0;
+
+    for (u32 index = 1; index < 8; index++) {
+        bits = (bits << 5) | base32_char_to_bits(coded[index]);
+    }
+
+    return (s32) (u32) bits;
+}
+
+inline void base32_encode_id_group(const u8 type, s32 id, u8* output) {
+    const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567";
+    u64 bits = ((u64) type << 32) | (u32) id;
+
+    for (s32 index = 7; index >= 0; index--) {
+        output[index] = (u8) alphabet[bits & 31];
+        bits >>= 5;
+    }
+}
+
 inline void fill_id8(const u8 type, s32 id, u8* output) {
-    u8 input[] = {
-            type,
-            (u8) (id >> 24),
-            (u8) (id >> 16),
-            (u8) (id >> 8),
-            (u8) id
-    };
-
-    base32_encode(input, ARRAY_SIZE(input), output);
+    base32_encode_id_group(type, id, output);
 }
 
 inline void fill_id16(const u8 type1, s32 id1, const u8 type2, s32 id2, u8* output) {
-    u8 input[] = {
-            type1,
-            (u8) (id1 >> 24),
-            (u8) (id1 >> 16),
-            (u8) (id1 >> 8),
-            (u8) id1,
-            type2,
-            (u8) (id2 >> 24),
-            (u8) (id2 >> 16),
-            (u8) (id2 >> 8),
-            (u8) id2
-    };
-
-    base32_encode(input, ARRAY_SIZE(input), output);
+    base32_encode_id_group(type1, id1, output);
+    base32_encode_id_group(type2, id2, output + 8);
 }
 
 PRINTLIKE(1, 0) String tprintf(const char* format, va_list args);
@@ -225,6 +248,8 @@ PRINTLIKE(1, 2) String tprintf(const char* format, ...);
 inline char* string_to_temporary_null_terminated_string(String string) {
     void* talloc(u32);
 
+    if (string.length) TEMPORARY_STORAGE_CHECK_IF_TEMPORARY(string.start);
+
     char* folder_name = (char*) talloc(string.length + 1);
 
     memcpy(folder_name, string.start, string.length);
@@ -257,6 +282,14 @@ void remove_item_from_array_keep_order(Array<T>& list, T item) {
     }
 }
 
+#define MYERS_NUM_BLOCKS(pattern_length) (((pattern_length) + 63) / 64)
+
+// Edit distance between the pattern and the whole text, or the best matching part of the text.
+// Thread safe and has no length limits, patterns over 256 characters allocate
+u32 myers_edit_distance(const char* pattern, u32 pattern_length, const char* text, u32 text_length, bool anywhere_in_text);
+// Same, for matching one pattern against many texts. Equalities are 256 * MYERS_NUM_BLOCKS(pattern_length) long
+void myers_build_equalities(const char* pattern, u32 pattern_length, u64* equalities);
+u32 myers_edit_distance_with_equalities(const u64* equalities, u32 pattern_length, const char* text, u32 text_length, bool anywhere_in_text);
 s32 hackenstein(const char* a, const char* b, u32 a_length, u32 b_length);
 s32 string_atoi(String* string);
 s8* string_in_substring(const s8* big, const s8* small, size_t slen);
@@ -3,6 +3,7 @@
 #include "id_hash_map.h"
 #include "json.h"
 #include "lazy_array.h"
+#include "string_pool.h"
 
 using Custom_Field_Handle = Entity_Handle<Custom_Field>;
 
@@ -12,6 +13,20 @@ static Id_Hash_Map<Custom_Field_Id, s32, -1> id_to_custom_field = {};
 static Id_Hash_Map<User_Id, bool, false> id_to_is_custom_field_requested{};
 static Temporary_List<Custom_Field_Id> custom_field_request_queue{};
 
+#define CUSTOM_FIELD_KEYS(KEY) \
+    KEY(Custom_Field_Key_Id, "id") \
+    KEY(Custom_Field_Key_Title, "title") \
+    KEY(Custom_Field_Key_Type, "type")
+
+DEFINE_JSON_KEYS(Custom_Field_Key, json_to_custom_field_key, CUSTOM_FIELD_KEYS)
+
+#define CUSTOM_FIELD_TYPE_VALUES(KEY) \
+    KEY(Custom_Field_Type_Value_Text, "Text") \
+    KEY(Custom_Field_Type_Value_Numeric, "Numeric") \
+    KEY(Custom_Field_Type_Value_Drop_Down, "DropDown")
+
+DEFINE_JSON_KEYS(Custom_Field_Type_Value, json_to_custom_field_type_value, CUSTOM_FIELD_TYPE_VALUES)
+
 static void process_custom_field(char* json, jsmntok_t*& token) {
     jsmntok_t* object_token = token++;
 
@@ -27,26 +42,37 @@ static void process_custom_field(char* json, jsmntok_t*& token) {
 
         jsmntok_t* next_token = token;
 
-        if (json_string_equals(json, property_token, "id")) {
-            json_token_to_right_part_of_id16(json, next_token, custom_field->id);
-        } else if (json_string_equals(json, property_token, "title")) {
-            json_token_to_string(json, next_token, custom_field->title);
-        } else if (json_string_equals(json, property_token, "type")) {
-
-            if (json_string_equals(json, next_token, "Text")) {
-                custom_field->type = Custom_Field_Type_Text;
-            } else if (json_string_equals(json, next_token, "Numeric")) {
-                custom_field->type = Custom_Field_Type_Numeric;
-            } else if (json_string_equals(json, next_token, "DropDown")) {
-                custom_field->type = Custom_Field_Type_DropDown;
-            } else {
-                // TODO all other cases, preferably with a more efficient comparison
-                custom_field->type = Custom_Field_Type_None;
+        switch (json_to_custom_field_key(json, property_token)) {
+            case Custom_Field_Key_Id: {
+                json_token_to_right_part_of_id16(json, next_token, custom_field->id);
+                break;
+            }
+
+            case Custom_Field_Key_Title: {
+                String title;
+                json_token_to_string(json, next_token, title);
+
+                custom_field->title = intern_string(title);
+                break;
+            }
+
+            case Custom_Field_Key_Type: {
+                switch (json_to_custom_field_type_value(json, next_token)) {
+                    case Custom_Field_Type_Value_Text: custom_field->type = Custom_Field_Type_Text; break;
+                    case Custom_Field_Type_Value_Numeric: custom_field->type = Custom_Field_Type_Numeric; break;
+                    case Custom_Field_Type_Value_Drop_Down: custom_field->type = Custom_Field_Type_DropDown; break;
+
+                    // TODO all other cases
+                    default: custom_field->type = Custom_Field_Type_None; break;
+                }
+
+                break;
             }
 
-        } else {
-            eat_json(token);
-            token--;
+            default: {
+                json_skip(token);
+                token--;
+            }
         }
     }
 
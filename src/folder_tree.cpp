@@ -3,9 +3,11 @@
 #include "jsmn.h"
 #include "id_hash_map.h"
 #include "lazy_array.h"
+#include "search.h"
 #include "main.h"
 #include "platform.h"
 #include "ui.h"
+#include "string_pool.h"
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -79,6 +81,11 @@ static Id_Hash_Map<Folder_Id, s32, -1> folder_id_to_handle_map{};
 
 static char search_buffer[128];
 
+// Documents are folder handles
+static Trigram_Index folder_name_index;
+static Search_Results folder_search_results{};
+static const u32 max_folder_search_results = 512;
+
 Array<Folder_Tree_Node> all_nodes{};
 
 Array<Folder> suggested_folders{};
@@ -662,6 +669,7 @@ Folder_Tree make_folder_tree(const char *name, Folder_Id root_id) {
 
 void init_folder_tree() {
     id_hash_map_init(&folder_id_to_handle_map);
+    trigram_index_init(folder_name_index);
 
     all_nodes.data = (Folder_Tree_Node*) REALLOC(all_nodes.data, sizeof(Folder_Tree_Node) * 2);
 
@@ -709,16 +717,26 @@ static void try_add_parent_child_pair(Folder_Handle parent, Folder_Handle child)
 
 Folder_Color* string_to_folder_color(String string);
 
-static Folder_Handle process_folder_tree_child_object(Folder_Handle parent_handle, char* json, jsmntok_t*& token) {
+// Shared by folders, folder tree nodes and spaces
+#define FOLDER_KEYS(KEY) \
+    KEY(Folder_Key_Title, "title") \
+    KEY(Folder_Key_Id, "id") \
+    KEY(Folder_Key_Color, "color") \
+    KEY(Folder_Key_Child_Ids, "childIds") \
+    KEY(Folder_Key_Avatar_Url, "avatarUrl")
+
+DEFINE_JSON_KEYS(Folder_Key, json_to_folder_key, FOLDER_KEYS)
+
+// Doesn't touch any global state, so it can run on a worker thread
+static void parse_folder_tree_node_object(Folder_Tree_Node* folder_data, char* json, jsmntok_t*& token) {
     jsmntok_t* object_token = token++;
 
     assert(object_token->type == JSMN_OBJECT);
 
-    u32 num_children = 0;
-
-    Folder_Tree_Node folder_data;
-    folder_data.name.start = NULL;
-    folder_data.color = NULL;
+    folder_data->name.start = NULL;
+    folder_data->name.length = 0;
+    folder_data->color = NULL;
+    folder_data->num_children = 0;
 
     for (u32 propety_index = 0; propety_index < object_token->size; propety_index++, token++) {
         jsmntok_t* property_token = token++;
@@ -727,36 +745,55 @@ static Folder_Handle process_folder_tree_child_object(Folder_Handle parent_handl
 
         jsmntok_t* value_token = token;
 
-        // TODO string comparison there is inefficient, can be faster
-        if (json_string_equals(json, property_token, "title")) {
-            json_token_to_string(json, value_token, folder_data.name);
-        } else if (json_string_equals(json, property_token, "id")) {
-            json_token_to_right_part_of_id16(json, value_token, folder_data.id);
-        } else if (json_string_equals(json, property_token, "color")) {
-            String color;
+        switch (json_to_folder_key(json, property_token)) {
+            case Folder_Key_Title: {
+                json_token_to_string(json, value_token, folder_data->name);
+                break;
+            }
 
-            json_token_to_string(json, value_token, color);
+            case Folder_Key_Id: {
+                json_token_to_right_part_of_id16(json, value_token, folder_data->id);
+                break;
+            }
 
-            folder_data.color = string_to_folder_color(color);
-        } else if (json_string_equals(json, property_token, "childIds")) {
-            assert(value_token->type == JSMN_ARRAY);
+            case Folder_Key_Color: {
+                String color;
 
-            num_children = value_token->size;
+                json_token_to_string(json, value_token, color);
 
-            eat_json(token);
-            token--;
-        } else {
-            eat_json(token);
-            token--;
+                folder_data->color = string_to_folder_color(color);
+                break;
+            }
+
+            case Folder_Key_Child_Ids: {
+                assert(value_token->type == JSMN_ARRAY);
+
+                folder_data->num_children = value_token->size;
+
+                json_skip(token);
+                token--;
+                break;
+            }
+
+            default: {
+                json_skip(token);
+                token--;
+            }
         }
     }
 
-    Folder_Handle new_handle = get_or_push_folder_node(folder_data.id, hash_id(folder_data.id));
+    folder_data->id_hash = hash_id(folder_data->id);
+}
+
+static Folder_Handle add_parsed_folder_tree_node(Folder_Handle parent_handle, Folder_Tree_Node* folder_data) {
+    Folder_Handle new_handle = get_or_push_folder_node(folder_data->id, folder_data->id_hash);
     Folder_Tree_Node* new_node = get_folder_node_by_handle(new_handle);
 
-    new_node->name = folder_data.name;
-    new_node->color = folder_data.color;
-    new_node->num_children = num_children;
+    trigram_index_set(folder_name_index, (u32) (s32) new_handle, folder_data->name.start, folder_data->name.length);
+
+    new_node->name = intern_string(folder_data->name);
+    new_node->color = folder_data->color;
+    new_node->num_children = folder_data->num_children;
     new_node->loaded_at = tick;
 
     if (parent_handle != NULL_FOLDER_HANDLE) {
@@ -766,8 +803,27 @@ static Folder_Handle process_folder_tree_child_object(Folder_Handle parent_handl
     return new_handle;
 }
 
-void folder_tree_search(const char* query, Array<Folder_Tree_Node*>* result) {
+static Folder_Handle process_folder_tree_child_object(Folder_Handle parent_handle, char* json, jsmntok_t*& token) {
+    Folder_Tree_Node folder_data;
+
+    parse_folder_tree_node_object(&folder_data, json, token);
+
+    return add_parsed_folder_tree_node(parent_handle, &folder_data);
+}
+
+void folder_tree_search(const char* query, Array<Folder_Tree_Node*>* result, bool fuzzy) {
+    if (fuzzy) {
+        trigram_index_fuzzy_search(folder_name_index, query, (u32) strlen(query), max_folder_search_results, folder_search_results);
+    } else {
+        trigram_index_search(folder_name_index, query, (u32) strlen(query), max_folder_search_results, folder_search_results);
+    }
+
+    result->data = (Folder_Tree_Node**) REALLOC(result->data, sizeof(Folder_Tree_Node*) * MAX(1, folder_search_results.length));
+    result->length = folder_search_results.length;
 
+    for (u32 index = 0; index < folder_search_results.length; index++) {
+        result->data[index] = get_folder_node_by_handle(Folder_Handle((s32) folder_search_results.matches[index].document));
+    }
 }
 
 static void try_reserve_space_for_more_folder_nodes(u32 nodes_received) {
@@ -798,19 +854,33 @@ static void process_plain_folder_data_object(Folder* folder, char* json, jsmntok
 
         jsmntok_t* next_token = token;
 
-        if (json_string_equals(json, property_token, "title")) {
-            json_token_to_string(json, next_token, folder->name);
-        } else if (json_string_equals(json, property_token, "id")) {
-            json_token_to_right_part_of_id16(json, next_token, folder->id);
-        } else if (json_string_equals(json, property_token, "color")) {
-            String color;
+        switch (json_to_folder_key(json, property_token)) {
+            case Folder_Key_Title: {
+                String name;
+                json_token_to_string(json, next_token, name);
 
-            json_token_to_string(json, next_token, color);
+                folder->name = intern_string(name);
+                break;
+            }
 
-            folder->color = string_to_folder_color(color);
-        } else {
-            eat_json(token);
-            token--;
+            case Folder_Key_Id: {
+                json_token_to_right_part_of_id16(json, next_token, folder->id);
+                break;
+            }
+
+            case Folder_Key_Color: {
+                String color;
+
+                json_token_to_string(json, next_token, color);
+
+                folder->color = string_to_folder_color(color);
+                break;
+            }
+
+            default: {
+                json_skip(token);
+                token--;
+            }
         }
     }
 }
@@ -832,54 +902,94 @@ static void process_space_data_object(Space* space, char* json, jsmntok_t*& toke
 
         jsmntok_t* next_token = token;
 
-        if (json_string_equals(json, property_token, "title")) {
-            json_token_to_string(json, next_token, space->name);
-        } else if (json_string_equals(json, property_token, "id")) {
-            json_token_to_right_part_of_id16(json, next_token, space->folder_id);
-        } else if (json_string_equals(json, property_token, "avatarUrl")) {
-            json_token_to_string(json, next_token, space->avatar_url);
-        } else {
-            eat_json(token);
-            token--;
+        switch (json_to_folder_key(json, property_token)) {
+            case Folder_Key_Title: {
+                String name;
+                json_token_to_string(json, next_token, name);
+
+                space->name = intern_string(name);
+                break;
+            }
+
+            case Folder_Key_Id: {
+                json_token_to_right_part_of_id16(json, next_token, space->folder_id);
+                break;
+            }
+
+            case Folder_Key_Avatar_Url: {
+                String avatar_url;
+                json_token_to_string(json, next_token, avatar_url);
+
+                space->avatar_url = intern_string(avatar_url);
+                break;
+            }
+
+            default: {
+                json_skip(token);
+                token--;
+            }
         }
     }
 
     image_request(space->avatar_request_id, "%.*s", space->avatar_url.length, space->avatar_url.start);
 }
 
-void process_folder_tree_children_request(Folder_Id parent_id, char* json, jsmntok_t* tokens, u32 num_tokens) {
-    Folder_Handle parent_handle = get_handle_by_folder_id(parent_id, hash_id(parent_id));
+void* build_folder_tree_children_batch(char* json, jsmntok_t* tokens, u32 num_tokens, void* data) {
+    jsmntok_t* data_token = json_find_data_array(json, tokens, num_tokens);
 
-    if (parent_handle == NULL_FOLDER_HANDLE) {
-        assert(!"Parent node not found");
-        return;
+    if (!data_token) {
+        return NULL;
     }
 
-    // TODO ugly copypaste from process_json_data_segment, ugh!
-    for (jsmntok_t* token = tokens; token < tokens + num_tokens; token++) {
-        if (json_string_equals(json, token, "data")) {
-            jsmntok_t* next_token = ++token;
+    Folder_Tree_Batch* batch = (Folder_Tree_Batch*) MALLOC(sizeof(Folder_Tree_Batch));
+    batch->nodes.length = 0;
+    batch->nodes.data = (Folder_Tree_Node*) MALLOC(sizeof(Folder_Tree_Node) * MAX(1, data_token->size));
 
-            assert(next_token->type == JSMN_ARRAY);
+    jsmntok_t* token = data_token + 1;
 
-            token++;
+    for (u32 array_index = 0; array_index < data_token->size; array_index++) {
+        parse_folder_tree_node_object(&batch->nodes[batch->nodes.length++], json, token);
+    }
 
-            u32 new_size = all_nodes.length + next_token->size;
+    return batch;
+}
 
-            if (all_nodes.length < new_size) {
-                all_nodes.data = (Folder_Tree_Node*) REALLOC(all_nodes.data, sizeof(Folder_Tree_Node) * new_size);
-            }
+void free_folder_tree_batch(void* prepared_batch) {
+    Folder_Tree_Batch* batch = (Folder_Tree_Batch*) prepared_batch;
 
-            for (u32 array_index = 0; array_index < next_token->size; array_index++) {
-                process_folder_tree_child_object(parent_handle, json, token);
-            }
+    if (!batch) {
+        return;
+    }
+
+    FREE(batch->nodes.data);
+    FREE(batch);
+}
+
+void process_folder_tree_children_request(Folder_Id parent_id, void* prepared_batch) {
+    Folder_Tree_Batch* batch = (Folder_Tree_Batch*) prepared_batch;
+    Folder_Handle parent_handle = get_handle_by_folder_id(parent_id, hash_id(parent_id));
+
+    if (parent_handle == NULL_FOLDER_HANDLE) {
+        assert(!"Parent node not found");
+
+        free_folder_tree_batch(batch);
+        return;
+    }
 
-            Folder_Tree_Node* parent_node = get_folder_node_by_handle(parent_handle);
+    if (batch) {
+        try_reserve_space_for_more_folder_nodes(batch->nodes.length);
 
-            parent_node->children_loaded = true;
-            parent_node->finished_loading_children_at = tick;
-            parent_node->num_children = (u32) next_token->size;
+        for (u32 node_index = 0; node_index < batch->nodes.length; node_index++) {
+            add_parsed_folder_tree_node(parent_handle, &batch->nodes[node_index]);
         }
+
+        Folder_Tree_Node* parent_node = get_folder_node_by_handle(parent_handle);
+
+        parent_node->children_loaded = true;
+        parent_node->finished_loading_children_at = tick;
+        parent_node->num_children = batch->nodes.length;
+
+        free_folder_tree_batch(batch);
     }
 
     // TODO I think we can figure out to which tree it belongs somehow?
@@ -31,18 +31,27 @@ struct Folder_Tree_Node : Folder {
     bool children_loaded;
 };
 
+// Folder nodes parsed off the main thread, strings still point into the response
+struct Folder_Tree_Batch {
+    Array<Folder_Tree_Node> nodes;
+};
+
 struct Space;
 
 void draw_folder_tree(float column_width);
 void init_folder_tree();
-void process_folder_tree_children_request(Folder_Id parent_id, char* json, jsmntok_t* tokens, u32 num_tokens);
+void* build_folder_tree_children_batch(char* json, jsmntok_t* tokens, u32 num_tokens, void* data);
+void free_folder_tree_batch(void* prepared_batch);
+// Takes ownership of the batch
+void process_folder_tree_children_request(Folder_Id parent_id, void* prepared_batch);
 void process_suggested_folders_data(char* json, u32 data_size, jsmntok_t*&token);
 void process_starred_folders_data(char* json, u32 data_size, jsmntok_t*& token);
 void process_multiple_folders_data(char* json, u32 data_size, jsmntok_t*& token);
 void process_spaces_data(char* json, u32 data_size, jsmntok_t*& token);
 void process_spaces_folders_data(char* json, u32 data_size, jsmntok_t*& token);
 
-void folder_tree_search(const char* query, Array<Folder_Tree_Node*>* result);
+// Ranked by match quality, fuzzy also lets through names with a few typos
+void folder_tree_search(const char* query, Array<Folder_Tree_Node*>* result, bool fuzzy = false);
 
 Folder_Tree_Node* find_folder_tree_node_by_id(Folder_Id id, u32 id_hash = 0);
 Space* find_space_by_avatar_request_id(Request_Id request_id);
@@ -0,0 +1,265 @@
+#include <imgui.h>
+#define IMGUI_DEFINE_MATH_OPERATORS
+#include <imgui_internal.h>
+#include "glyph_cache.h"
+#include "lazy_array.h"
+#include "id_hash_map.h"
+
+static const u32 max_cached_glyph_runs = 8192;
+static const u32 max_cached_glyph_quads = 256 * 1024;
+
+struct Glyph_Quad {
+    ImVec2 top_left;
+    ImVec2 bottom_right;
+    ImVec2 uv_top_left;
+    ImVec2 uv_bottom_right;
+};
+
+struct Glyph_Run {
+    ImFont* font;
+    float font_size;
+    float max_width;
+
+    // Set when the run is keyed by the address of its text, which is then not copied
+    const char* text_address;
+    u32 text_offset;
+    u32 text_length;
+
+    u32 first_quad;
+    u32 num_quads;
+    float width;
+    bool is_cut;
+};
+
+// Runs with the same hash replace each other
+static Id_Hash_Map<u32, s32, -1> hash_to_glyph_run{};
+static Lazy_Array<Glyph_Run, 1024> glyph_runs{};
+static Lazy_Array<Glyph_Quad, 16384> glyph_quads{};
+static Lazy_Array<char, 16384> glyph_run_texts{};
+static ImTextureID glyph_cache_texture = NULL;
+
+void glyph_cache_clear() {
+    if (hash_to_glyph_run.capacity) {
+        id_hash_map_clear(&hash_to_glyph_run);
+    } else {
+        id_hash_map_init(&hash_to_glyph_run);
+    }
+
+    lazy_array_soft_reset(glyph_runs);
+    lazy_array_soft_reset(glyph_quads);
+    lazy_array_soft_reset(glyph_run_texts);
+}
+
+static u32 hash_glyph_run(ImFont* font, float font_size, float max_width, const char* start, u32 length, bool keyed_by_address) {
+    struct {
+        ImFont* font;
+        float font_size;
+        float max_width;
+        const char* text_address;
+        u32 text_length;
+        u32 padding; // Hashed, so it can't be left uninitialized
+    } parameters = { font, font_size, max_width, keyed_by_address ? start : NULL, length, 0 };
+
+    u32 hash = XXH32(&parameters, sizeof(parameters), hash_seed);
+
+    if (keyed_by_address) {
+        return hash;
+    }
+
+    return XXH32(start, length, hash);
+}
+
+static bool is_same_glyph_run(Glyph_Run* run, ImFont* font, float font_size, float max_width, const char* start, u32 length, bool keyed_by_address) {
+    if (run->font != font || run->font_size != font_size || run->max_width != max_width || run->text_length != length) {
+        return false;
+    }
+
+    if (keyed_by_address) {
+        return run->text_address == start;
+    }
+
+    return !run->text_address && memcmp(glyph_run_texts.data + run->text_offset, start, length) == 0;
+}
+
+static void add_glyph_quad(ImFont* font, const ImFontGlyph* glyph, float scale, float x) {
+    Glyph_Quad* quad = lazy_array_add_n_values(glyph_quads, 1);
+
+    quad->top_left = ImVec2(x + glyph->X0 * scale, glyph->Y0 * scale) + font->DisplayOffset;
+    quad->bottom_right = ImVec2(x + glyph->X1 * scale, glyph->Y1 * scale) + font->DisplayOffset;
+    quad->uv_top_left = ImVec2(glyph->U0, glyph->V0);
+    quad->uv_bottom_right = ImVec2(glyph->U1, glyph->V1);
+}
+
+// Same glyph placement as ImFont::RenderText, without wrapping. Stops at the first line break
+static void lay_out_glyph_run(Glyph_Run* run, const char* start, const char* end) {
+    ImFont* font = run->font;
+
+    const float scale = run->font_size / font->FontSize;
+
+    const ImFontGlyph* dot = font->FindGlyph((ImWchar) '.');
+    const float ellipsis_width = dot ? dot->AdvanceX * scale * 3.0f : 0.0f;
+
+    float text_width = 0.0f;
+
+    for (const char* s = start; s < end;) {
+        unsigned int c = (unsigned int) *s;
+
+        s += c < 0x80 ? 1 : ImTextCharFromUtf8(&c, s, end);
+
+        if (c == 0 || c == '\n') {
+            break;
+        }
+
+        text_width += font->GetCharAdvance((ImWchar) c) * scale;
+    }
+
+    bool needs_ellipsis = text_width > run->max_width;
+    float available_width = needs_ellipsis ? run->max_width - ellipsis_width : run->max_width;
+    float x = 0.0f;
+
+    run->first_quad = glyph_quads.length;
+
+    for (const char* s = start; s < end;) {
+        unsigned int c = (unsigned int) *s;
+
+        s += c < 0x80 ? 1 : ImTextCharFromUtf8(&c, s, end);
+
+        if (c == 0 || c == '\n') {
+            break;
+        }
+
+        const ImFontGlyph* glyph = font->FindGlyph((ImWchar) c);
+
+        if (!glyph) {
+            continue;
+        }
+
+        float advance = glyph->AdvanceX * scale;
+
+        if (needs_ellipsis && x + advance > available_width) {
+            break;
+        }
+
+        if (c != ' ' && c != '\t' && c != '\r') {
+            add_glyph_quad(font, glyph, scale, x);
+        }
+
+        x += advance;
+    }
+
+    if (needs_ellipsis && dot) {
+        for (u32 index = 0; index < 3; index++) {
+            add_glyph_quad(font, dot, scale, x);
+
+            x += dot->AdvanceX * scale;
+        }
+    }
+
+    run->num_quads = glyph_quads.length - run->first_quad;
+    run->width = x;
+    run->is_cut = needs_ellipsis;
+}
+
+static Glyph_Run* find_or_lay_out_glyph_run(ImFont* font, float font_size, float max_width, const char* start, const char* end, bool keyed_by_address) {
+    if (font->ContainerAtlas->TexID != glyph_cache_texture || !hash_to_glyph_run.capacity) {
+        glyph_cache_texture = font->ContainerAtlas->TexID;
+        glyph_cache_clear();
+    }
+
+    u32 length = (u32) (end - start);
+    u32 hash = hash_glyph_run(font, font_size, max_width, start, length, keyed_by_address);
+    s32 run_index = id_hash_map_get(&hash_to_glyph_run, hash, hash);
+
+    if (run_index != -1 && is_same_glyph_run(&glyph_runs[run_index], font, font_size, max_width, start, length, keyed_by_address)) {
+        return &glyph_runs[run_index];
+    }
+
+    if (glyph_runs.length >= max_cached_glyph_runs || glyph_quads.length + length + 3 > max_cached_glyph_quads) {
+        glyph_cache_clear();
+    }
+
+    run_index = (s32) glyph_runs.length;
+
+    Glyph_Run* run = lazy_array_add_n_values(glyph_runs, 1);
+    run->font = font;
+    run->font_size = font_size;
+    run->max_width = max_width;
+    run->text_address = keyed_by_address ? start : NULL;
+    run->text_offset = glyph_run_texts.length;
+    run->text_length = length;
+
+    if (!keyed_by_address) {
+        memcpy(lazy_array_add_n_values(glyph_run_texts, length), start, length);
+    }
+
+    lay_out_glyph_run(run, start, end);
+
+    id_hash_map_put(&hash_to_glyph_run, run_index, hash, hash);
+
+    return run;
+}
+
+static float draw_glyph_run(ImDrawList* draw_list, ImVec2 position, u32 color, const char* start, const char* end, float max_width, bool* was_cut, bool keyed_by_address) {
+    if (start == end || max_width <= 0.0f) {
+        if (was_cut) *was_cut = start != end;
+
+        return 0.0f;
+    }
+
+    ImFont* font = ImGui::GetFont();
+
+    IM_ASSERT(font->ContainerAtlas->TexID == draw_list->_TextureIdStack.back());
+
+    Glyph_Run* run = find_or_lay_out_glyph_run(font, ImGui::GetFontSize(), max_width, start, end, keyed_by_address);
+
+    if (was_cut) *was_cut = run->is_cut;
+
+    if ((color & IM_COL32_A_MASK) == 0 || !run->num_quads) {
+        return run->width;
+    }
+
+    // Pixel aligned like ImFont::RenderText
+    ImVec2 offset((float) (int) position.x, (float) (int) position.y);
+
+    draw_list->PrimReserve(run->num_quads * 6, run->num_quads * 4);
+
+    // Same as PrimRectUV for every quad, written directly
+    ImDrawVert* vertex = draw_list->_VtxWritePtr;
+    ImDrawIdx* index = draw_list->_IdxWritePtr;
+    ImDrawIdx first_vertex = (ImDrawIdx) draw_list->_VtxCurrentIdx;
+
+    Glyph_Quad* quads = glyph_quads.data + run->first_quad;
+
+    for (u32 quad_index = 0; quad_index < run->num_quads; quad_index++, vertex += 4, index += 6) {
+        Glyph_Quad* quad = &quads[quad_index];
+
+        float x1 = offset.x + quad->top_left.x, y1 = offset.y + quad->top_left.y;
+        float x2 = offset.x + quad->bottom_right.x, y2 = offset.y + quad->bottom_right.y;
+        float u1 = quad->uv_top_left.x, v1 = quad->uv_top_left.y;
+        float u2 = quad->uv_bottom_right.x, v2 = quad->uv_bottom_right.y;
+
+        ImDrawIdx quad_vertex = (ImDrawIdx) (first_vertex + quad_index * 4);
+
+        index[0] = quad_vertex; index[1] = (ImDrawIdx) (quad_vertex + 1); index[2] = (ImDrawIdx) (quad_vertex + 2);
+        index[3] = quad_vertex; index[4] = (ImDrawIdx) (quad_vertex + 2); index[5] = (ImDrawIdx) (quad_vertex + 3);
+
+        vertex[0].pos.x = x1; vertex[0].pos.y = y1; vertex[0].uv.x = u1; vertex[0].uv.y = v1; vertex[0].col = color;
+        vertex[1].pos.x = x2; vertex[1].pos.y = y1; vertex[1].uv.x = u2; vertex[1].uv.y = v1; vertex[1].col = color;
+        vertex[2].pos.x = x2; vertex[2].pos.y = y2; vertex[2].uv.x = u2; vertex[2].uv.y = v2; vertex[2].col = color;
+        vertex[3].pos.x = x1; vertex[3].pos.y = y2; vertex[3].uv.x = u1; vertex[3].uv.y = v2; vertex[3].col = color;
+    }
+
+    draw_list->_VtxWritePtr = vertex;
+    draw_list->_IdxWritePtr = index;
+    draw_list->_VtxCurrentIdx += run->num_quads * 4;
+
+    return run->width;
+}
+
+float draw_cached_text(ImDrawList* draw_list, ImVec2 position, u32 color, const char* start, const char* end, float max_width, bool* was_cut) {
+    return draw_glyph_run(draw_list, position, color, start, end, max_width, was_cut, false);
+}
+
+float draw_cached_string(ImDrawList* draw_list, ImVec2 position, u32 color, String string, float max_width, bool* was_cut) {
+    return draw_glyph_run(draw_list, position, color, string.start, string.start + string.length, max_width, was_cut, true);
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <imgui.h>
+#include "common.h"
+
+// Laid out single line texts for drawing the same strings every frame, like table cells.
+// A run is keyed by the text contents, font, font size and the maximum width, and keeps the glyph quads
+//  relative to the text position with the text already cut to fit the width with an ellipsis.
+// Drawing a cached run only copies the quads into the draw list at an offset.
+// Everything is dropped at once when the cache fills up or the font atlas changes.
+
+// Draws with the current font, returns the width of the drawn text
+float draw_cached_text(ImDrawList* draw_list, ImVec2 position, u32 color, const char* start, const char* end, float max_width, bool* was_cut = NULL);
+
+// Same, but the run is found by the address and length of the string instead of its contents, so the text is not hashed.
+// For strings which don't change while they live at the same address, like interned names or folder contents strings.
+// The cache has to be cleared once such strings are released, before their memory can hold other text
+float draw_cached_string(ImDrawList* draw_list, ImVec2 position, u32 color, String string, float max_width, bool* was_cut = NULL);
+
+void glyph_cache_clear();
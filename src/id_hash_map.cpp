@@ -0,0 +1,193 @@
+#include "id_hash_map.h"
+#include "platform.h"
+
+#if BENCHMARK
+// The previous map, prime table sizes with double hashing, only kept around for comparison
+static const struct {
+    u32 max_entries, size, rehash;
+} prime_hash_sizes[] = {
+        {2,            5,            3},
+        {4,            7,            5},
+        {8,            13,           11},
+        {16,           19,           17},
+        {32,           43,           41},
+        {64,           73,           71},
+        {128,          151,          149},
+        {256,          283,          281},
+        {512,          571,          569},
+        {1024,         1153,         1151},
+        {2048,         2269,         2267},
+        {4096,         4519,         4517},
+        {8192,         9013,         9011},
+        {16384,        18043,        18041},
+        {32768,        36109,        36107},
+        {65536,        72091,        72089},
+        {131072,       144409,       144407},
+        {262144,       288361,       288359},
+        {524288,       576883,       576881},
+        {1048576,      1153459,      1153457}
+};
+
+struct Prime_Hash_Entry {
+    u32 hash;
+    s32 data;
+    s32 key;
+    bool present;
+};
+
+struct Prime_Hash_Map {
+    Prime_Hash_Entry* table;
+    u32 size;
+    u32 rehash;
+    u32 max_entries;
+    u32 size_index;
+    u32 entries;
+};
+
+static void prime_hash_map_resize(Prime_Hash_Map* map, u32 size_index) {
+    map->size_index = size_index;
+    map->size = prime_hash_sizes[size_index].size;
+    map->rehash = prime_hash_sizes[size_index].rehash;
+    map->max_entries = prime_hash_sizes[size_index].max_entries;
+    map->table = (Prime_Hash_Entry*) calloc(map->size, sizeof(Prime_Hash_Entry));
+    map->entries = 0;
+}
+
+static void prime_hash_map_put(Prime_Hash_Map* map, s32 value, s32 key, u32 hash) {
+    if (map->entries >= map->max_entries) {
+        Prime_Hash_Map old_map = *map;
+
+        prime_hash_map_resize(map, map->size_index + 1);
+
+        for (u32 index = 0; index < old_map.size; index++) {
+            Prime_Hash_Entry* entry = old_map.table + index;
+
+            if (entry->present) {
+                prime_hash_map_put(map, entry->data, entry->key, entry->hash);
+            }
+        }
+
+        free(old_map.table);
+    }
+
+    u32 hash_address = hash % map->size;
+
+    while (true) {
+        Prime_Hash_Entry* entry = map->table + hash_address;
+
+        if (!entry->present) {
+            entry->hash = hash;
+            entry->key = key;
+            entry->data = value;
+            entry->present = true;
+            map->entries++;
+            return;
+        }
+
+        if (entry->hash == hash && entry->key == key) {
+            entry->data = value;
+            return;
+        }
+
+        hash_address = (hash_address + 1 + hash % map->rehash) % map->size;
+    }
+}
+
+static s32 prime_hash_map_get(Prime_Hash_Map* map, s32 key, u32 hash) {
+    u32 hash_address = hash % map->size;
+
+    while (true) {
+        Prime_Hash_Entry* entry = map->table + hash_address;
+
+        if (!entry->present) {
+            return -1;
+        }
+
+        if (entry->hash == hash && entry->key == key) {
+            return entry->data;
+        }
+
+        hash_address = (hash_address + 1 + hash % map->rehash) % map->size;
+    }
+}
+
+void id_hash_map_benchmark() {
+    const u32 num_ids = 100000;
+
+    s32* ids = (s32*) malloc(sizeof(s32) * num_ids * 2);
+    u32* hashes = (u32*) malloc(sizeof(u32) * num_ids * 2);
+
+    // Unique scattered ids, the second half is never inserted and is used for misses
+    for (u32 index = 0; index < num_ids * 2; index++) {
+        ids[index] = (s32) (index * 2654435761u);
+        hashes[index] = hash_id(ids[index]);
+    }
+
+    Prime_Hash_Map prime_map;
+    prime_hash_map_resize(&prime_map, 0);
+
+    u64 start = platform_get_app_time_precise();
+
+    for (u32 index = 0; index < num_ids; index++) {
+        prime_hash_map_put(&prime_map, (s32) index, ids[index], hashes[index]);
+    }
+
+    float prime_put_time = platform_get_delta_time_ms(start);
+
+    start = platform_get_app_time_precise();
+
+    s64 prime_checksum = 0;
+
+    for (u32 index = 0; index < num_ids * 2; index++) {
+        prime_checksum += prime_hash_map_get(&prime_map, ids[index], hashes[index]);
+    }
+
+    float prime_get_time = platform_get_delta_time_ms(start);
+
+    Id_Hash_Map<s32, s32, -1> map{};
+    id_hash_map_init(&map);
+
+    start = platform_get_app_time_precise();
+
+    for (u32 index = 0; index < num_ids; index++) {
+        id_hash_map_put(&map, (s32) index, ids[index], hashes[index]);
+    }
+
+    float put_time = platform_get_delta_time_ms(start);
+
+    start = platform_get_app_time_precise();
+
+    s64 checksum = 0;
+
+    for (u32 index = 0; index < num_ids * 2; index++) {
+        checksum += id_hash_map_get(&map, ids[index], hashes[index]);
+    }
+
+    float get_time = platform_get_delta_time_ms(start);
+
+    start = platform_get_app_time_precise();
+
+    for (u32 index = 0; index < num_ids; index += 2) {
+        id_hash_map_remove(&map, ids[index], hashes[index]);
+    }
+
+    float remove_time = platform_get_delta_time_ms(start);
+
+    bool same_output = checksum == prime_checksum;
+
+    for (u32 index = 0; index < num_ids; index++) {
+        s32 expected = index % 2 ? prime_hash_map_get(&prime_map, ids[index], hashes[index]) : -1;
+
+        same_output &= id_hash_map_get(&map, ids[index], hashes[index]) == expected;
+    }
+
+    printf("Id hash map benchmark on %u ids: put prime %.3fms, new %.3fms; get (half misses) prime %.3fms, new %.3fms; remove half %.3fms, %s\n",
+           num_ids, prime_put_time, put_time, prime_get_time, get_time, remove_time, same_output ? "same output" : "OUTPUT MISMATCH"
+    );
+
+    id_hash_map_destroy(&map);
+    free(prime_map.table);
+    free(ids);
+    free(hashes);
+}
+#endif
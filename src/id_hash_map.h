@@ -1,230 +1,260 @@
 #pragma once
 
 #include <cstdlib>
+#include <cstring>
 #include "common.h"
 
-static const struct {
-    u32 max_entries, size, rehash;
-} hash_sizes[] = {
-        {2,            5,            3},
-        {4,            7,            5},
-        {8,            13,           11},
-        {16,           19,           17},
-        {32,           43,           41},
-        {64,           73,           71},
-        {128,          151,          149},
-        {256,          283,          281},
-        {512,          571,          569},
-        {1024,         1153,         1151},
-        {2048,         2269,         2267},
-        {4096,         4519,         4517},
-        {8192,         9013,         9011},
-        {16384,        18043,        18041},
-        {32768,        36109,        36107},
-        {65536,        72091,        72089},
-        {131072,       144409,       144407},
-        {262144,       288361,       288359},
-        {524288,       576883,       576881},
-        {1048576,      1153459,      1153457},
-        {2097152,      2307163,      2307161},
-        {4194304,      4613893,      4613891},
-        {8388608,      9227641,      9227639},
-        {16777216,     18455029,     18455027},
-        {33554432,     36911011,     36911009},
-        {67108864,     73819861,     73819859},
-        {134217728,    147639589,    147639587},
-        {268435456,    295279081,    295279079},
-        {536870912,    590559793,    590559791},
-        {1073741824,   1181116273,   1181116271},
-        {2147483648ul, 2362232233ul, 2362232231ul}
-};
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
-#define hash_table_foreach(ht, entry)                \
-    for (entry = id_hash_table_next_entry(ht, (Id_Hash_Entry<Key, T, NULL_VALUE>*) NULL);        \
-         entry != NULL;                    \
-         entry = id_hash_table_next_entry(ht, entry))
+// Open addressing with linear probing over a power of two table, same layout idea as SwissTable:
+//  every slot has a control byte which is either empty or the top 7 bits of the hash, lookups
+//  compare 16 control bytes at a time and only touch slots whose byte matched.
+// Linear probing keeps the invariant that there are no empty slots between an entry and its home
+//  slot, so removal shifts the following entries back instead of leaving tombstones.
 
-template<typename Key, typename T, T NULL_VALUE = nullptr>
-struct Id_Hash_Entry {
+static const u8 ID_HASH_MAP_EMPTY = 0x80;
+static const u32 ID_HASH_MAP_GROUP_WIDTH = 16;
+static const u32 ID_HASH_MAP_MIN_CAPACITY = 16;
+
+template<typename Key, typename T>
+struct Id_Hash_Slot {
     u32 hash;
-    T data;
     Key key;
-    bool present;
+    T data;
 };
 
 template<typename Key, typename T, T NULL_VALUE = nullptr>
 struct Id_Hash_Map {
-    Id_Hash_Entry<Key, T, NULL_VALUE>* table = NULL;
-    u32 size; // TODO rename this
-    u32 rehash;
-    u32 max_entries;
-    u32 size_index;
-    u32 entries;
+    // capacity + GROUP_WIDTH - 1 bytes, the first GROUP_WIDTH - 1 are mirrored at the end
+    //  so a group can be loaded at any slot without wrapping around
+    u8* control = NULL;
+    Id_Hash_Slot<Key, T>* slots = NULL;
+    u32 capacity = 0;
+    u32 max_entries = 0;
+    u32 entries = 0;
 };
 
+inline u8 id_hash_map_h2(u32 hash) {
+    return (u8) (hash >> 25);
+}
+
+// Bit i is set when control byte i of the group equals h2, and when it is empty
+inline void id_hash_map_match_group(const u8* group, u8 h2, u32& matching, u32& empty) {
+#if defined(__SSE2__)
+    __m128i control = _mm_loadu_si128((const __m128i*) group);
+
+    matching = (u32) _mm_movemask_epi8(_mm_cmpeq_epi8(control, _mm_set1_epi8((char) h2)));
+    empty = (u32) _mm_movemask_epi8(control);
+#else
+    matching = 0;
+    empty = 0;
+
+    for (u32 index = 0; index < ID_HASH_MAP_GROUP_WIDTH; index++) {
+        matching |= (u32) (group[index] == h2) << index;
+        empty |= (u32) (group[index] == ID_HASH_MAP_EMPTY) << index;
+    }
+#endif
+}
+
+template<typename Key, typename T, T NULL_VALUE>
+void id_hash_map_set_control(Id_Hash_Map<Key, T, NULL_VALUE>* map, u32 index, u8 value) {
+    map->control[index] = value;
+
+    if (index < ID_HASH_MAP_GROUP_WIDTH - 1) {
+        map->control[map->capacity + index] = value;
+    }
+}
+
+template<typename Key, typename T, T NULL_VALUE>
+void id_hash_map_allocate(Id_Hash_Map<Key, T, NULL_VALUE>* map, u32 capacity) {
+    map->capacity = capacity;
+    map->max_entries = capacity - capacity / 8;
+    map->entries = 0;
+    map->control = (u8*) MALLOC(capacity + ID_HASH_MAP_GROUP_WIDTH - 1);
+    map->slots = (Id_Hash_Slot<Key, T>*) MALLOC(sizeof(Id_Hash_Slot<Key, T>) * capacity);
+
+    memset(map->control, ID_HASH_MAP_EMPTY, capacity + ID_HASH_MAP_GROUP_WIDTH - 1);
+}
+
 template<typename Key, typename T, T NULL_VALUE = nullptr>
 void id_hash_map_init(Id_Hash_Map<Key, T, NULL_VALUE>* map) {
-    map->size_index = 0;
-    map->size = hash_sizes[map->size_index].size;
-    map->rehash = hash_sizes[map->size_index].rehash;
-    map->max_entries = hash_sizes[map->size_index].max_entries;
-    map->table = (Id_Hash_Entry<Key, T, NULL_VALUE>*) CALLOC(map->size, sizeof(Id_Hash_Entry<Key, T, NULL_VALUE>));
-    map->entries = 0;
+    id_hash_map_allocate(map, ID_HASH_MAP_MIN_CAPACITY);
 }
 
 template<typename Key, typename T, T NULL_VALUE = nullptr>
 void id_hash_map_destroy(Id_Hash_Map<Key, T, NULL_VALUE>* map) {
-    FREE(map->table);
+    if (map->control) {
+        FREE(map->control);
+        FREE(map->slots);
+    }
+
+    *map = {};
 }
 
+// Keeps the memory around
 template<typename Key, typename T, T NULL_VALUE = nullptr>
 void id_hash_map_clear(Id_Hash_Map<Key, T, NULL_VALUE>* map) {
-//    if (!map->size) {
-//        return;
-//    }
-//
-//    for (u32 index = 0; index < map->total_buckets; index++) {
-//        if (map->buckets[index].contents) {
-//            FREE(map->buckets[index].contents);
-//        }
-//    }
-//
-//    memset(map->buckets, 0, sizeof(Hash_Bucket < T > ) * map->total_buckets);
-//    map->size = 0;
+    if (!map->capacity) {
+        return;
+    }
+
+    memset(map->control, ID_HASH_MAP_EMPTY, map->capacity + ID_HASH_MAP_GROUP_WIDTH - 1);
+    map->entries = 0;
 }
 
+// Slot index of the key or -1
 template<typename Key, typename T, T NULL_VALUE = nullptr>
-Id_Hash_Entry<Key, T, NULL_VALUE>* id_hash_table_next_entry(Id_Hash_Map<Key, T, NULL_VALUE>* map, Id_Hash_Entry<Key, T, NULL_VALUE>* entry) {
-    if (entry == NULL) {
-        entry = map->table;
-    } else {
-        entry++;
+s32 id_hash_map_find_slot(Id_Hash_Map<Key, T, NULL_VALUE>* map, Key key, u32 hash) {
+    if (!map->capacity) {
+        return -1;
     }
 
-    for (; entry != map->table + map->size; entry++) {
-        if (entry->present) {
-            return entry;
+    u32 mask = map->capacity - 1;
+    u8 h2 = id_hash_map_h2(hash);
+
+    for (u32 position = hash & mask;; position = (position + ID_HASH_MAP_GROUP_WIDTH) & mask) {
+        u32 matching, empty;
+
+        id_hash_map_match_group(map->control + position, h2, matching, empty);
+
+        for (; matching; matching &= matching - 1) {
+            u32 index = (position + __builtin_ctz(matching)) & mask;
+            Id_Hash_Slot<Key, T>* slot = map->slots + index;
+
+            if (slot->hash == hash && slot->key == key) {
+                return (s32) index;
+            }
         }
-    }
 
-    return NULL;
+        // There is always at least one empty slot since the load factor is capped
+        if (empty) {
+            return -1;
+        }
+    }
 }
 
+// Doesn't check for duplicates or the load factor
 template<typename Key, typename T, T NULL_VALUE = nullptr>
-void id_hash_map_rehash(Id_Hash_Map<Key, T, NULL_VALUE>* map, u32 new_size_index) {
-    Id_Hash_Map<Key, T, NULL_VALUE> old_ht;
-    Id_Hash_Entry<Key, T, NULL_VALUE>* table;
+void id_hash_map_insert_new(Id_Hash_Map<Key, T, NULL_VALUE>* map, T value, Key key, u32 hash) {
+    u32 mask = map->capacity - 1;
 
-    if (new_size_index >= ARRAY_SIZE(hash_sizes))
-        return;
+    for (u32 position = hash & mask;; position = (position + ID_HASH_MAP_GROUP_WIDTH) & mask) {
+        u32 matching, empty;
 
-    table = (Id_Hash_Entry<Key, T, NULL_VALUE>*) CALLOC(hash_sizes[new_size_index].size, sizeof(Id_Hash_Entry<Key, T, NULL_VALUE>));
-    if (table == NULL)
-        return;
+        id_hash_map_match_group(map->control + position, 0, matching, empty);
 
-    old_ht = *map;
+        if (empty) {
+            u32 index = (position + __builtin_ctz(empty)) & mask;
+            Id_Hash_Slot<Key, T>* slot = map->slots + index;
 
-    map->table = table;
-    map->size_index = new_size_index;
-    map->size = hash_sizes[map->size_index].size;
-    map->rehash = hash_sizes[map->size_index].rehash;
-    map->max_entries = hash_sizes[map->size_index].max_entries;
-    map->entries = 0;
+            slot->hash = hash;
+            slot->key = key;
+            slot->data = value;
 
-    Id_Hash_Entry<Key, T, NULL_VALUE>* entry;
+            id_hash_map_set_control(map, index, id_hash_map_h2(hash));
+            map->entries++;
 
-    hash_table_foreach(&old_ht, entry) {
-        id_hash_map_put(map, entry->data, entry->key, entry->hash);
+            return;
+        }
     }
-
-    FREE(old_ht.table);
 }
 
 template<typename Key, typename T, T NULL_VALUE = nullptr>
-bool id_hash_map_put(Id_Hash_Map<Key, T, NULL_VALUE>* map, T value, Key key, u32 hash) {
-    Id_Hash_Entry<Key, T, NULL_VALUE>* available_entry = NULL;
+void id_hash_map_rehash(Id_Hash_Map<Key, T, NULL_VALUE>* map, u32 new_capacity) {
+    Id_Hash_Map<Key, T, NULL_VALUE> old_map = *map;
 
-    if (map->entries >= map->max_entries) {
-        id_hash_map_rehash(map, map->size_index + 1);
-    }
+    id_hash_map_allocate(map, new_capacity);
 
-    u32 start_hash_address = hash % map->size;
-    u32 hash_address = start_hash_address;
+    for (u32 index = 0; index < old_map.capacity; index++) {
+        if (old_map.control[index] != ID_HASH_MAP_EMPTY) {
+            Id_Hash_Slot<Key, T>* slot = old_map.slots + index;
 
-    do {
-        Id_Hash_Entry<Key, T, NULL_VALUE>* entry = map->table + hash_address;
-        u32 double_hash;
+            id_hash_map_insert_new(map, slot->data, slot->key, slot->hash);
+        }
+    }
 
-        if (!entry->present) {
-            /* Stash the first available entry we find */
-            if (available_entry == NULL)
-                available_entry = entry;
+    if (old_map.control) {
+        FREE(old_map.control);
+        FREE(old_map.slots);
+    }
+}
 
-            break;
-        }
+// Grows the table so that at least num_entries fit without rehashing
+template<typename Key, typename T, T NULL_VALUE = nullptr>
+void id_hash_map_reserve(Id_Hash_Map<Key, T, NULL_VALUE>* map, u32 num_entries) {
+    u32 capacity = MAX(map->capacity, ID_HASH_MAP_MIN_CAPACITY);
 
-        /* Implement replacement when another insert happens
-         * with a matching key.  This is a relatively common
-         * feature of hash tables, with the alternative
-         * generally being "insert the new value as well, and
-         * return it first when the key is searched for".
-         *
-         * Note that the hash table doesn't have a delete
-         * callback.  If freeing of old data pointers is
-         * required to avoid memory leaks, perform a search
-         * before inserting.
-         */
-        if (entry->hash == hash && key == entry->key) {
-            entry->key = key;
-            entry->present = true;
-            entry->data = value;
-            return true;
-        }
+    while (capacity - capacity / 8 < num_entries) {
+        capacity *= 2;
+    }
 
-        double_hash = 1 + hash % map->rehash;
+    if (capacity != map->capacity) {
+        id_hash_map_rehash(map, capacity);
+    }
+}
 
-        hash_address = (hash_address + double_hash) % map->size;
-    } while (hash_address != start_hash_address);
+// Replaces the value if the key is already present
+template<typename Key, typename T, T NULL_VALUE = nullptr>
+bool id_hash_map_put(Id_Hash_Map<Key, T, NULL_VALUE>* map, T value, Key key, u32 hash) {
+    s32 existing_index = id_hash_map_find_slot(map, key, hash);
 
-    if (available_entry) {
-        available_entry->hash = hash;
-        available_entry->key = key;
-        available_entry->data = value;
-        available_entry->present = true;
-        map->entries++;
+    if (existing_index != -1) {
+        map->slots[existing_index].data = value;
         return true;
     }
 
-    /* We could hit here if a required resize failed. An unchecked-malloc
-     * application could ignore this result.
-     */
-    return false;
+    if (map->entries >= map->max_entries) {
+        id_hash_map_rehash(map, MAX(map->capacity * 2, ID_HASH_MAP_MIN_CAPACITY));
+    }
+
+    id_hash_map_insert_new(map, value, key, hash);
+
+    return true;
 }
 
 template<typename Key, typename T, T NULL_VALUE = nullptr>
 T id_hash_map_get(Id_Hash_Map<Key, T, NULL_VALUE>* map, Key key, u32 hash) {
-    if (!map->size) {
+    s32 index = id_hash_map_find_slot(map, key, hash);
+
+    if (index == -1) {
         return NULL_VALUE;
     }
 
-    u32 start_hash_address = hash % map->size;
-    u32 hash_address = start_hash_address;
+    return map->slots[index].data;
+}
 
-    do {
-        u32 double_hash;
+// Returns false if the key wasn't there
+template<typename Key, typename T, T NULL_VALUE = nullptr>
+bool id_hash_map_remove(Id_Hash_Map<Key, T, NULL_VALUE>* map, Key key, u32 hash) {
+    s32 found_index = id_hash_map_find_slot(map, key, hash);
 
-        Id_Hash_Entry<Key, T, NULL_VALUE>* entry = map->table + hash_address;
+    if (found_index == -1) {
+        return false;
+    }
 
-        if (!entry->present) {
-            return NULL_VALUE;
-        } else if (entry->hash == hash && key == entry->key) {
-            return entry->data;
-        }
+    u32 mask = map->capacity - 1;
+    u32 hole = (u32) found_index;
 
-        double_hash = 1 + hash % map->rehash;
+    // Pull back every following entry which is allowed to live in the hole, stops on the first empty slot
+    for (u32 next = (hole + 1) & mask; map->control[next] != ID_HASH_MAP_EMPTY; next = (next + 1) & mask) {
+        u32 home = map->slots[next].hash & mask;
 
-        hash_address = (hash_address + double_hash) % map->size;
-    } while (hash_address != start_hash_address);
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            map->slots[hole] = map->slots[next];
+            id_hash_map_set_control(map, hole, map->control[next]);
+            hole = next;
+        }
+    }
 
-    return NULL_VALUE;
+    id_hash_map_set_control(map, hole, ID_HASH_MAP_EMPTY);
+    map->entries--;
+
+    return true;
 }
+
+#if BENCHMARK
+// Compares against the previous prime sized double hashing map and prints the timings
+void id_hash_map_benchmark();
+#endif
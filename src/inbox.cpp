@@ -8,6 +8,7 @@
 #include "workflows.h"
 #include "ui.h"
 #include "platform.h"
+#include "arena.h"
 
 enum Inbox_Notification_Type {
     Inbox_Notification_Type_Assign,
@@ -42,6 +43,46 @@ struct Inbox_Notification {
 static u32 unread_notifications = 0;
 static Lazy_Array<Inbox_Notification, 8> notifications{};
 
+// Strings of all notifications, copied anew on every update so the strings of replaced notifications are released
+static Arena notification_strings{};
+
+#define INBOX_NOTIFICATION_KEYS(KEY) \
+    KEY(Inbox_Notification_Key_Id, "id") \
+    KEY(Inbox_Notification_Key_Author_User_Id, "authorUserId") \
+    KEY(Inbox_Notification_Key_Unread, "unread") \
+    KEY(Inbox_Notification_Key_Task_Id, "taskId") \
+    KEY(Inbox_Notification_Key_Task_Title, "taskTitle") \
+    KEY(Inbox_Notification_Key_Type, "type") \
+    KEY(Inbox_Notification_Key_Comment_Id, "commentId") \
+    KEY(Inbox_Notification_Key_Comment_Text, "commentText") \
+    KEY(Inbox_Notification_Key_Old_Custom_Status_Id, "oldCustomStatusId") \
+    KEY(Inbox_Notification_Key_New_Custom_Status_Id, "newCustomStatusId")
+
+DEFINE_JSON_KEYS(Inbox_Notification_Key, json_to_inbox_notification_key, INBOX_NOTIFICATION_KEYS)
+
+#define INBOX_NOTIFICATION_TYPE_VALUES(KEY) \
+    KEY(Inbox_Notification_Type_Value_Assign, "Assign") \
+    KEY(Inbox_Notification_Type_Value_Mention, "Mention") \
+    KEY(Inbox_Notification_Type_Value_Status, "Status")
+
+DEFINE_JSON_KEYS(Inbox_Notification_Type_Value, json_to_inbox_notification_type_value, INBOX_NOTIFICATION_TYPE_VALUES)
+
+static String copy_notification_string(String& string) {
+    if (!string.length) {
+        return {};
+    }
+
+    return arena_copy_string(notification_strings, string);
+}
+
+static void copy_notification_strings(Inbox_Notification* notification) {
+    notification->task_title = copy_notification_string(notification->task_title);
+
+    if (notification->type != Inbox_Notification_Type_Status) {
+        notification->comment.text = copy_notification_string(notification->comment.text);
+    }
+}
+
 static void process_inbox_notification(Inbox_Notification* notification, char* json, jsmntok_t*& token) {
     jsmntok_t* object_token = token++;
 
@@ -54,39 +95,68 @@ static void process_inbox_notification(Inbox_Notification* notification, char* j
 
         jsmntok_t* next_token = token;
 
-        if (json_string_equals(json, property_token, "id")) {
-            json_token_to_right_part_of_id16(json, next_token, notification->id);
-        } else if (json_string_equals(json, property_token, "authorUserId")) {
-            json_token_to_id8(json, next_token, notification->author);
-        } else if (json_string_equals(json, property_token, "unread")) {
-            notification->unread = *(json + next_token->start) == 't';
-        } else if (json_string_equals(json, property_token, "taskId")) {
-            json_token_to_right_part_of_id16(json, next_token, notification->task);
-        } else if (json_string_equals(json, property_token, "taskTitle")) {
-            json_token_to_string(json, next_token, notification->task_title);
-        } else if (json_string_equals(json, property_token, "type")) {
-
-            if (json_string_equals(json, next_token, "Assign")) {
-                notification->type = Inbox_Notification_Type_Assign;
-            } else if (json_string_equals(json, next_token, "Mention")) {
-                notification->type = Inbox_Notification_Type_Mention;
-            } else if (json_string_equals(json, next_token, "Status")) {
-                notification->type = Inbox_Notification_Type_Status;
+        switch (json_to_inbox_notification_key(json, property_token)) {
+            case Inbox_Notification_Key_Id: {
+                json_token_to_right_part_of_id16(json, next_token, notification->id);
+                break;
             }
 
-        } else if (json_string_equals(json, property_token, "commentId")) {
-            json_token_to_right_part_of_id16(json, next_token, notification->comment.id);
-        } else if (json_string_equals(json, property_token, "commentText")) {
-            json_token_to_string(json, next_token, notification->comment.text);
+            case Inbox_Notification_Key_Author_User_Id: {
+                json_token_to_id8(json, next_token, notification->author);
+                break;
+            }
 
-        } else if (json_string_equals(json, property_token, "oldCustomStatusId")) {
-            json_token_to_right_part_of_id16(json, next_token, notification->status.old_status);
-        } else if (json_string_equals(json, property_token, "newCustomStatusId")) {
-            json_token_to_right_part_of_id16(json, next_token, notification->status.new_status);
+            case Inbox_Notification_Key_Unread: {
+                notification->unread = *(json + next_token->start) == 't';
+                break;
+            }
 
-        } else {
-            eat_json(token);
-            token--;
+            case Inbox_Notification_Key_Task_Id: {
+                json_token_to_right_part_of_id16(json, next_token, notification->task);
+                break;
+            }
+
+            case Inbox_Notification_Key_Task_Title: {
+                json_token_to_string(json, next_token, notification->task_title);
+                break;
+            }
+
+            case Inbox_Notification_Key_Type: {
+                switch (json_to_inbox_notification_type_value(json, next_token)) {
+                    case Inbox_Notification_Type_Value_Assign: notification->type = Inbox_Notification_Type_Assign; break;
+                    case Inbox_Notification_Type_Value_Mention: notification->type = Inbox_Notification_Type_Mention; break;
+                    case Inbox_Notification_Type_Value_Status: notification->type = Inbox_Notification_Type_Status; break;
+
+                    default: break;
+                }
+
+                break;
+            }
+
+            case Inbox_Notification_Key_Comment_Id: {
+                json_token_to_right_part_of_id16(json, next_token, notification->comment.id);
+                break;
+            }
+
+            case Inbox_Notification_Key_Comment_Text: {
+                json_token_to_string(json, next_token, notification->comment.text);
+                break;
+            }
+
+            case Inbox_Notification_Key_Old_Custom_Status_Id: {
+                json_token_to_right_part_of_id16(json, next_token, notification->status.old_status);
+                break;
+            }
+
+            case Inbox_Notification_Key_New_Custom_Status_Id: {
+                json_token_to_right_part_of_id16(json, next_token, notification->status.new_status);
+                break;
+            }
+
+            default: {
+                json_skip(token);
+                token--;
+            }
         }
     }
 }
@@ -277,9 +347,21 @@ void draw_inbox() {
 }
 
 void process_inbox_data(char* json, u32 data_size, jsmntok_t*& token) {
+    Arena previous_strings = notification_strings;
+
+    notification_strings = {};
+
+    // Notifications missing from the response are kept
+    for (Inbox_Notification* it = notifications.data; it != notifications.data + notifications.length; it++) {
+        copy_notification_strings(it);
+    }
+
+    arena_free(previous_strings);
+
     for (u32 array_index = 0; array_index < data_size; array_index++) {
         Inbox_Notification new_notification{};
         process_inbox_notification(&new_notification, json, token);
+        copy_notification_strings(&new_notification);
 
         Inbox_Notification* old_notification = find_notification_by_id(new_notification.id);
 
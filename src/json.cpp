@@ -1,88 +1,233 @@
 #include "common.h"
 #include "json.h"
+#include "json_structural.h"
 #include "platform.h"
 #include <cstring>
 #include <cstdio>
 #include <cstdlib>
 #include <cassert>
+#include <mutex>
+
+#if BENCHMARK
+#include "benchmark.h"
+#endif
+
+Json_Tokenizer json_tokenizer = Json_Tokenizer_Jsmn;
+
+void json_select_tokenizer(const char* name) {
+    if (!name) {
+        return;
+    }
+
+    if (strcmp(name, "jsmn") == 0) {
+        json_tokenizer = Json_Tokenizer_Jsmn;
+    } else if (strcmp(name, "structural") == 0) {
+        json_tokenizer = Json_Tokenizer_Structural;
+    } else {
+        printf("Unknown JSON tokenizer %s, expected jsmn or structural\n", name);
+        return;
+    }
+
+    printf("Using %s JSON tokenizer\n", name);
+}
 
 void json_token_to_string(char* json, jsmntok_t* token, String &string) {
     string.start = json + token->start;
     string.length = token->end - token->start;
 }
 
-void eat_json(jsmntok_t*& token) {
-    jsmntok_t* current_token = token++;
+struct Token_Pool_Entry {
+    u32 endpoint;
+    float tokens_per_byte;
+    jsmntok_t* tokens;
+    u32 token_capacity;
+};
 
-    switch (current_token->type) {
-        case JSMN_STRING:
-        case JSMN_PRIMITIVE: {
-            break;
+// Shared between the network thread and the main thread, so the buffers are not traced
+static const u32 token_pool_size = 32;
+static Token_Pool_Entry token_pool[token_pool_size];
+static u32 num_token_pool_entries = 0;
+static u32 next_evicted_token_pool_entry = 0;
+static std::mutex token_pool_mutex;
+
+u32 json_endpoint_hash(const char* url, u32 url_length) {
+    u32 hash = json_hash("");
+
+    const char* segment_start = url;
+    const char* url_end = url + url_length;
+
+    // Ids (and comma separated lists of them) are skipped, so every folder shares the same entry
+    while (segment_start < url_end) {
+        const char* segment_end = segment_start;
+        bool looks_like_id = true;
+
+        while (segment_end < url_end && *segment_end != '/' && *segment_end != '?') {
+            char c = *segment_end;
+
+            looks_like_id &= (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == ',';
+
+            segment_end++;
         }
 
-        case JSMN_ARRAY: {
-            for (u32 i = 0; i < current_token->size; i++) eat_json(token);
-            break;
+        if (!looks_like_id || segment_end - segment_start < 8) {
+            for (const char* c = segment_start; c < segment_end; c++) {
+                hash = (hash ^ (u8) *c) * 16777619u;
+            }
         }
 
-        case JSMN_OBJECT: {
-            for (u32 i = 0; i < current_token->size; i++) {
-                eat_json(token);
-                eat_json(token);
+        if (segment_end < url_end && *segment_end == '?') {
+            // Different fields make a different density, so the query is a part of the endpoint
+            for (const char* c = segment_end; c < url_end; c++) {
+                hash = (hash ^ (u8) *c) * 16777619u;
             }
 
             break;
         }
 
-        case JSMN_UNDEFINED: break;
+        hash = (hash ^ (u8) '/') * 16777619u;
+        segment_start = segment_end + 1;
     }
+
+    return hash;
 }
 
-static jsmntok_t* parse_json_iteratively(const char* json, u32 json_length, s32 &num_tokens) {
-    jsmn_parser parser;
-    jsmn_init(&parser);
+static Token_Pool_Entry* find_or_add_token_pool_entry(u32 endpoint) {
+    for (u32 index = 0; index < num_token_pool_entries; index++) {
+        if (token_pool[index].endpoint == endpoint) {
+            return &token_pool[index];
+        }
+    }
 
-    jsmntok_t* tokens;
+    Token_Pool_Entry* entry;
 
-    u32 token_watermark = json_length / 16;
+    if (num_token_pool_entries < token_pool_size) {
+        entry = &token_pool[num_token_pool_entries++];
+    } else {
+        entry = &token_pool[next_evicted_token_pool_entry];
+        next_evicted_token_pool_entry = (next_evicted_token_pool_entry + 1) % token_pool_size;
 
-    tokens = (jsmntok_t*) MALLOC(sizeof(jsmntok_t) * token_watermark);
+        free(entry->tokens);
+    }
 
-    if (tokens == NULL) {
-        return NULL;
+    entry->endpoint = endpoint;
+    entry->tokens_per_byte = 0;
+    entry->tokens = NULL;
+    entry->token_capacity = 0;
+
+    return entry;
+}
+
+jsmntok_t* json_token_pool_acquire(u32 endpoint, u32 json_length, u32& token_capacity) {
+    std::lock_guard<std::mutex> lock(token_pool_mutex);
+
+    Token_Pool_Entry* entry = find_or_add_token_pool_entry(endpoint);
+
+    u32 predicted_tokens = MAX(1024, json_length / 16);
+
+    if (entry->tokens_per_byte > 0) {
+        // A bit of slack, so a slightly bigger response doesn't have to grow the buffer
+        predicted_tokens = (u32) (entry->tokens_per_byte * json_length * 1.125f) + 64;
     }
 
-    try_read_tokens: {
-        s32 return_code = jsmn_parse(&parser, json, json_length, tokens, token_watermark);
+    jsmntok_t* tokens = entry->tokens;
+    token_capacity = entry->token_capacity;
 
-        if (return_code < 0) {
-            if (return_code == JSMN_ERROR_NOMEM) {
-                token_watermark = token_watermark * 2;
-                tokens = (jsmntok_t*) REALLOC(
-                        tokens,
-                        sizeof(jsmntok_t) * token_watermark
-                );
+    entry->tokens = NULL;
+    entry->token_capacity = 0;
 
-                if (tokens == NULL) {
-                    return NULL;
-                }
+    if (token_capacity < predicted_tokens) {
+        // No need to copy anything over
+        free(tokens);
 
-                goto try_read_tokens;
-            }
-        } else {
-            num_tokens = return_code;
-            return tokens;
-        }
+        tokens = (jsmntok_t*) malloc(sizeof(jsmntok_t) * predicted_tokens);
+        token_capacity = predicted_tokens;
     }
 
-    return NULL;
+    return tokens;
+}
+
+void json_token_pool_release(u32 endpoint, jsmntok_t* tokens, u32 token_capacity, u32 num_tokens, u32 json_length) {
+    std::lock_guard<std::mutex> lock(token_pool_mutex);
+
+    Token_Pool_Entry* entry = find_or_add_token_pool_entry(endpoint);
+
+    if (num_tokens && json_length) {
+        entry->tokens_per_byte = (float) num_tokens / json_length;
+    }
+
+    // Two requests to the same endpoint could have been in flight, keep the bigger buffer
+    if (entry->token_capacity >= token_capacity) {
+        free(tokens);
+    } else {
+        free(entry->tokens);
+
+        entry->tokens = tokens;
+        entry->token_capacity = token_capacity;
+    }
+}
+
+// Grows the buffer in place, num_tokens stays at 0 if the json is invalid
+static jsmntok_t* parse_json_iteratively(const char* json, u32 json_length, s32 &num_tokens, jsmntok_t* tokens, u32& token_capacity) {
+    jsmn_parser parser;
+    jsmn_init(&parser);
+
+    s32 return_code;
+
+    while ((return_code = jsmn_parse(&parser, json, json_length, tokens, token_capacity)) == JSMN_ERROR_NOMEM) {
+        token_capacity = token_capacity * 2;
+        tokens = (jsmntok_t*) realloc(tokens, sizeof(jsmntok_t) * token_capacity);
+    }
+
+    num_tokens = MAX(0, return_code);
+
+    return tokens;
+}
+
+#if BENCHMARK
+static void benchmark_tokenizers(const char* json, u32 json_length, jsmntok_t* expected_tokens, s32 expected_num_tokens) {
+    // Fresh buffers for both, so neither gets a head start from reusing memory
+    u64 jsmn_start = platform_get_app_time_precise();
+
+    s32 jsmn_num_tokens = 0;
+    u32 jsmn_capacity = MAX(1024, json_length / 16);
+    jsmntok_t* jsmn_tokens = (jsmntok_t*) malloc(sizeof(jsmntok_t) * jsmn_capacity);
+
+    jsmn_tokens = parse_json_iteratively(json, json_length, jsmn_num_tokens, jsmn_tokens, jsmn_capacity);
+
+    float jsmn_time = platform_get_delta_time_ms(jsmn_start);
+
+    u64 structural_start = platform_get_app_time_precise();
+
+    jsmntok_t* structural_tokens = NULL;
+    u32 structural_capacity = 0;
+    s32 structural_num_tokens = json_structural_parse(json, json_length, structural_tokens, structural_capacity);
+
+    float structural_time = platform_get_delta_time_ms(structural_start);
+
+    bool same_output = structural_num_tokens == expected_num_tokens &&
+                       memcmp(structural_tokens, expected_tokens, sizeof(jsmntok_t) * MAX(0, expected_num_tokens)) == 0;
+
+    printf("Tokenizer benchmark on %u bytes, %i tokens: jsmn %.3fms, structural %.3fms, %s\n",
+           json_length, expected_num_tokens, jsmn_time, structural_time, same_output ? "same output" : "OUTPUT MISMATCH"
+    );
+
+    free(jsmn_tokens);
+    free(structural_tokens);
 }
+#endif
 
-jsmntok_t* parse_json_into_tokens(char* content_json, u32 json_length, u32& result_parsed_tokens) {
+jsmntok_t* parse_json_into_tokens(char* content_json, u32 json_length, u32& result_parsed_tokens, u32& result_token_capacity, u32 endpoint) {
     u64 start_time = platform_get_app_time_precise();
 
     s32 num_tokens = 0;
-    jsmntok_t* json_tokens = parse_json_iteratively(content_json, json_length, num_tokens);
+    u32 token_capacity = 0;
+    jsmntok_t* json_tokens = json_token_pool_acquire(endpoint, json_length, token_capacity);
+
+    if (json_tokenizer == Json_Tokenizer_Structural) {
+        num_tokens = json_structural_parse(content_json, json_length, json_tokens, token_capacity);
+    } else {
+        json_tokens = parse_json_iteratively(content_json, json_length, num_tokens, json_tokens, token_capacity);
+    }
 
     assert(num_tokens > 0);
 
@@ -90,11 +235,131 @@ jsmntok_t* parse_json_into_tokens(char* content_json, u32 json_length, u32& resu
 
     printf("Parsed %i tokens in %.3fms\n", parsed_tokens, platform_get_delta_time_ms(start_time));
 
+#if BENCHMARK
+    if (benchmark_json_tokenizers) {
+        benchmark_tokenizers(content_json, json_length, json_tokens, num_tokens);
+    }
+#endif
+
     result_parsed_tokens = (u32) parsed_tokens;
+    result_token_capacity = token_capacity;
 
     return json_tokens;
 }
 
+void json_stream_init(Json_Stream& stream, u32 endpoint) {
+    jsmn_init(&stream.parser);
+
+    stream.endpoint = endpoint;
+    stream.expected_length = 0;
+    stream.tokens = NULL;
+    stream.token_capacity = 0;
+    stream.time_spent = 0;
+    stream.failed = false;
+}
+
+static s32 json_stream_parse(Json_Stream& stream, const char* json, u32 json_length) {
+    u64 start_time = platform_get_app_time_precise();
+
+    if (!stream.tokens) {
+        stream.tokens = json_token_pool_acquire(stream.endpoint, MAX(json_length, stream.expected_length), stream.token_capacity);
+    }
+
+    s32 return_code;
+
+    // Tokens reference each other by index, so the parser state survives the buffer being moved
+    while ((return_code = jsmn_parse(&stream.parser, json, json_length, stream.tokens, stream.token_capacity)) == JSMN_ERROR_NOMEM) {
+        stream.token_capacity = stream.token_capacity * 2;
+        stream.tokens = (jsmntok_t*) realloc(stream.tokens, sizeof(jsmntok_t) * stream.token_capacity);
+    }
+
+    stream.time_spent += platform_get_app_time_precise() - start_time;
+
+    return return_code;
+}
+
+static inline bool is_json_delimiter(char c) {
+    switch (c) {
+        case ',': case ':': case '{': case '}': case '[': case ']':
+        case ' ': case '\t': case '\r': case '\n':
+            return true;
+
+        default: return false;
+    }
+}
+
+void json_stream_feed(Json_Stream& stream, const char* json, u32 json_length) {
+    // The structural tokenizer is fast enough to do everything once the download is finished
+    if (stream.failed || json_tokenizer == Json_Tokenizer_Structural) {
+        return;
+    }
+
+    // jsmn closes a primitive as soon as the input ends, so a chunk ending with "12" would
+    //  produce a token for 12 even if the next chunk starts with "34". Strings are fine,
+    //  jsmn rewinds to their start and picks them up again on the next call.
+    u32 safe_length = json_length;
+
+    while (safe_length > stream.parser.pos && !is_json_delimiter(json[safe_length - 1])) {
+        safe_length--;
+    }
+
+    if (safe_length <= stream.parser.pos) {
+        return;
+    }
+
+    s32 return_code = json_stream_parse(stream, json, safe_length);
+
+    if (return_code < 0 && return_code != JSMN_ERROR_PART) {
+        stream.failed = true;
+    }
+}
+
+bool json_stream_finish(Json_Stream& stream, const char* json, u32 json_length, u32& result_num_tokens) {
+    if (stream.failed) {
+        return false;
+    }
+
+    s32 return_code;
+
+    if (json_tokenizer == Json_Tokenizer_Structural) {
+        u64 start_time = platform_get_app_time_precise();
+
+        if (!stream.tokens) {
+            stream.tokens = json_token_pool_acquire(stream.endpoint, json_length, stream.token_capacity);
+        }
+
+        return_code = json_structural_parse(json, json_length, stream.tokens, stream.token_capacity);
+
+        stream.time_spent += platform_get_app_time_precise() - start_time;
+    } else {
+        return_code = json_stream_parse(stream, json, json_length);
+    }
+
+    if (return_code <= 0) {
+        stream.failed = true;
+        return false;
+    }
+
+    result_num_tokens = (u32) return_code;
+
+#if BENCHMARK
+    if (benchmark_json_tokenizers) {
+        benchmark_tokenizers(json, json_length, stream.tokens, return_code);
+    }
+#endif
+
+    return true;
+}
+
+void json_stream_release(Json_Stream& stream, u32 num_tokens, u32 json_length) {
+    if (stream.tokens) {
+        json_token_pool_release(stream.endpoint, stream.tokens, stream.token_capacity, num_tokens, json_length);
+    }
+
+    stream.tokens = NULL;
+    stream.token_capacity = 0;
+}
+
 void process_json_data_segment(char* json, jsmntok_t* tokens, u32 num_tokens, Data_Process_Callback callback) {
     jsmntok_t* end_token = tokens + num_tokens;
 
@@ -109,4 +374,26 @@ void process_json_data_segment(char* json, jsmntok_t* tokens, u32 num_tokens, Da
             callback(json, (u32) next_token->size, start_token);
         }
     }
+}
+
+// Finds the "data" array of the top level response object, returns NULL if there is none
+jsmntok_t* json_find_data_array(char* json, jsmntok_t* tokens, u32 num_tokens) {
+    if (!num_tokens || tokens->type != JSMN_OBJECT) {
+        return NULL;
+    }
+
+    jsmntok_t* token = tokens;
+    jsmntok_t* object_token = token++;
+
+    for (u32 propety_index = 0; propety_index < object_token->size; propety_index++) {
+        jsmntok_t* property_token = token++;
+
+        if (json_string_equals(json, property_token, "data") && token->type == JSMN_ARRAY) {
+            return token;
+        }
+
+        json_skip(token);
+    }
+
+    return NULL;
 }
\ No newline at end of file
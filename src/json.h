@@ -1,6 +1,7 @@
 #include "jsmn.h"
 #include "common.h"
 #include "temporary_storage.h"
+#include "base32_ids.h"
 #include <cstring>
 #include <cstdio>
 #include <jsmn.h>
@@ -9,10 +10,53 @@
 
 typedef void (*Data_Process_Callback)(char* json, u32 data_size, jsmntok_t*& token);
 
+enum Json_Tokenizer {
+    Json_Tokenizer_Jsmn,
+    Json_Tokenizer_Structural
+};
+
+// Selected once on startup, before any request is made
+extern Json_Tokenizer json_tokenizer;
+
+void json_select_tokenizer(const char* name);
+
+// Token buffers are kept alive between responses of the same endpoint together with the last
+//  token density, so polling the same endpoint again doesn't do any large allocations.
+// Endpoints are hashed from the request url with the ids left out.
+u32 json_endpoint_hash(const char* url, u32 url_length);
+jsmntok_t* json_token_pool_acquire(u32 endpoint, u32 json_length, u32& token_capacity);
+void json_token_pool_release(u32 endpoint, jsmntok_t* tokens, u32 token_capacity, u32 num_tokens, u32 json_length);
+
+// Used by platforms which don't know the endpoint of a response
+const u32 JSON_UNKNOWN_ENDPOINT = 0;
+
+// Tokenizes a response chunk by chunk while it is still downloading.
+// Tokens come from the token pool and are given back with json_stream_release.
+struct Json_Stream {
+    jsmn_parser parser;
+    u32 endpoint;
+    u32 expected_length; // Content-Length if known, used to predict the token count
+    jsmntok_t* tokens;
+    u32 token_capacity;
+    u64 time_spent;
+    bool failed;
+};
+
+void json_stream_init(Json_Stream& stream, u32 endpoint);
+void json_stream_feed(Json_Stream& stream, const char* json, u32 json_length);
+bool json_stream_finish(Json_Stream& stream, const char* json, u32 json_length, u32& result_num_tokens);
+void json_stream_release(Json_Stream& stream, u32 num_tokens, u32 json_length);
+
 void json_token_to_string(char* json, jsmntok_t* token, String &string);
-void eat_json(jsmntok_t*& token);
-jsmntok_t* parse_json_into_tokens(char* content_json, u32 json_length, u32& result_parsed_tokens);
+// Tokens have to be given back with json_token_pool_release
+jsmntok_t* parse_json_into_tokens(char* content_json, u32 json_length, u32& result_parsed_tokens, u32& result_token_capacity, u32 endpoint);
 void process_json_data_segment(char* json, jsmntok_t* tokens, u32 num_tokens, Data_Process_Callback callback);
+jsmntok_t* json_find_data_array(char* json, jsmntok_t* tokens, u32 num_tokens);
+
+// Moves past the token and everything nested in it in one step, the tokenizer records the subtree size
+inline void json_skip(jsmntok_t*& token) {
+    token += token->skip;
+}
 
 inline bool json_string_equals(char* json, jsmntok_t* tok, const char *s) {
     u32 token_length = (u32) (tok->end - tok->start);
@@ -20,21 +64,54 @@ inline bool json_string_equals(char* json, jsmntok_t* tok, const char *s) {
     return (u32) strlen(s) == token_length && strncmp(json + tok->start, s, token_length) == 0;
 }
 
-inline void json_token_to_right_part_of_id16(char* json, jsmntok_t* token, s32& id) {
-    u8* token_start = (u8*) json + token->start;
-    u8 result[UNBASE32_LEN(16)];
+// FNV-1a, evaluated at compile time for the keys and at runtime for the property tokens
+constexpr u32 json_hash(const char* string, u32 hash = 2166136261u) {
+    return *string ? json_hash(string + 1, (hash ^ (u8) *string) * 16777619u) : hash;
+}
 
-    // TODO wasteful to decode all bytes but only use some
-    base32_decode(token_start, 16, result);
+inline u32 json_token_hash(char* json, jsmntok_t* token) {
+    u32 hash = 2166136261u;
 
-    id = uchars_to_s32(result + 6);
+    for (char* c = json + token->start; c < json + token->end; c++) {
+        hash = (hash ^ (u8) *c) * 16777619u;
+    }
+
+    return hash;
+}
+
+inline bool json_token_equals(char* json, jsmntok_t* token, const char* string, u32 length) {
+    return (u32) (token->end - token->start) == length && memcmp(json + token->start, string, length) == 0;
+}
+
+#define JSON_KEY_ENUM_VALUE(name, string) name,
+#define JSON_KEY_SWITCH_CASE(name, string) \
+    case json_hash(string): return json_token_equals(json, token, string, sizeof(string) - 1) ? name : decltype(name)(0);
+
+// Declares an enum with an _Unknown value plus the listed keys, and a function which maps a property
+//  token onto it with one hash and one comparison. Keys with colliding hashes fail to compile.
+// KEYS is an X-macro: #define MY_KEYS(KEY) KEY(My_Key_Id, "id") KEY(My_Key_Title, "title")
+#define DEFINE_JSON_KEYS(enum_name, function_name, KEYS) \
+    enum enum_name { enum_name##_Unknown = 0, KEYS(JSON_KEY_ENUM_VALUE) }; \
+    static inline enum_name function_name(char* json, jsmntok_t* token) { \
+        switch (json_token_hash(json, token)) { \
+            KEYS(JSON_KEY_SWITCH_CASE) \
+            default: return enum_name##_Unknown; \
+        } \
+    }
+
+inline void json_token_to_right_part_of_id16(char* json, jsmntok_t* token, s32& id) {
+    id = base32_decode_id_group((u8*) json + token->start + 8);
 }
 
 inline void json_token_to_id8(char* json, jsmntok_t* token, s32& id) {
-    u8* token_start = (u8*) json + token->start;
-    u8 result[UNBASE32_LEN(8)];
+    id = base32_decode_id_group((u8*) json + token->start);
+}
 
-    base32_decode(token_start, 8, result);
+// Same as above for every element of an ID array, tokens point to the first element
+inline void json_tokens_to_right_part_of_id16_array(char* json, jsmntok_t* tokens, u32 num_tokens, s32* ids) {
+    base32_decode_id_tokens(json, tokens, num_tokens, 8, ids);
+}
 
-    id = uchars_to_s32((u8*) result + 1);
+inline void json_tokens_to_id8_array(char* json, jsmntok_t* tokens, u32 num_tokens, s32* ids) {
+    base32_decode_id_tokens(json, tokens, num_tokens, 0, ids);
 }
\ No newline at end of file
@@ -0,0 +1,387 @@
+#include "json_structural.h"
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Bit i of every mask corresponds to byte i of the current 64 byte block.
+// Control characters count as whitespace, they are only valid inside strings anyway.
+struct Block_Masks {
+    u64 backslash;
+    u64 quote;
+    u64 whitespace;
+    u64 operators;
+};
+
+// Carried between blocks
+struct Scanner_State {
+    u64 previous_escaped;
+    u64 previous_in_string;
+    u64 previous_scalar;
+};
+
+#if defined(__AVX2__)
+
+static inline u64 block_mask_equal(__m256i low, __m256i high, char c) {
+    __m256i needle = _mm256_set1_epi8(c);
+
+    u64 low_mask = (u32) _mm256_movemask_epi8(_mm256_cmpeq_epi8(low, needle));
+    u64 high_mask = (u32) _mm256_movemask_epi8(_mm256_cmpeq_epi8(high, needle));
+
+    return low_mask | (high_mask << 32);
+}
+
+static inline u64 block_mask_whitespace(__m256i low, __m256i high) {
+    __m256i space = _mm256_set1_epi8(' ');
+
+    u64 low_mask = (u32) _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_min_epu8(low, space), low));
+    u64 high_mask = (u32) _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_min_epu8(high, space), high));
+
+    return low_mask | (high_mask << 32);
+}
+
+static inline void compute_block_masks(const u8* block, Block_Masks& masks) {
+    __m256i low = _mm256_loadu_si256((const __m256i*) block);
+    __m256i high = _mm256_loadu_si256((const __m256i*) (block + 32));
+
+    // Setting 0x20 maps [ and ] onto { and }
+    __m256i lower_case_bit = _mm256_set1_epi8(0x20);
+    __m256i low_brackets = _mm256_or_si256(low, lower_case_bit);
+    __m256i high_brackets = _mm256_or_si256(high, lower_case_bit);
+
+    masks.backslash = block_mask_equal(low, high, '\\');
+    masks.quote = block_mask_equal(low, high, '"');
+    masks.whitespace = block_mask_whitespace(low, high);
+    masks.operators = block_mask_equal(low_brackets, high_brackets, '{') | block_mask_equal(low_brackets, high_brackets, '}') |
+                      block_mask_equal(low, high, ':') | block_mask_equal(low, high, ',');
+}
+
+#elif defined(__SSE2__)
+
+static inline u64 block_mask_equal(__m128i* chunks, char c) {
+    __m128i needle = _mm_set1_epi8(c);
+
+    u64 mask_0 = (u32) _mm_movemask_epi8(_mm_cmpeq_epi8(chunks[0], needle));
+    u64 mask_1 = (u32) _mm_movemask_epi8(_mm_cmpeq_epi8(chunks[1], needle));
+    u64 mask_2 = (u32) _mm_movemask_epi8(_mm_cmpeq_epi8(chunks[2], needle));
+    u64 mask_3 = (u32) _mm_movemask_epi8(_mm_cmpeq_epi8(chunks[3], needle));
+
+    return mask_0 | (mask_1 << 16) | (mask_2 << 32) | (mask_3 << 48);
+}
+
+static inline u64 block_mask_whitespace(__m128i* chunks) {
+    __m128i space = _mm_set1_epi8(' ');
+    u64 mask = 0;
+
+    for (u32 index = 0; index < 4; index++) {
+        u64 chunk_mask = (u32) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(chunks[index], space), chunks[index]));
+
+        mask |= chunk_mask << (index * 16);
+    }
+
+    return mask;
+}
+
+static inline void compute_block_masks(const u8* block, Block_Masks& masks) {
+    __m128i chunks[4];
+    __m128i brackets[4];
+
+    // Setting 0x20 maps [ and ] onto { and }
+    __m128i lower_case_bit = _mm_set1_epi8(0x20);
+
+    for (u32 index = 0; index < 4; index++) {
+        chunks[index] = _mm_loadu_si128((const __m128i*) (block + index * 16));
+        brackets[index] = _mm_or_si128(chunks[index], lower_case_bit);
+    }
+
+    masks.backslash = block_mask_equal(chunks, '\\');
+    masks.quote = block_mask_equal(chunks, '"');
+    masks.whitespace = block_mask_whitespace(chunks);
+    masks.operators = block_mask_equal(brackets, '{') | block_mask_equal(brackets, '}') |
+                      block_mask_equal(chunks, ':') | block_mask_equal(chunks, ',');
+}
+
+#else
+
+// Wasm and other targets without SSE2, still avoids the per character parser state machine
+static inline void compute_block_masks(const u8* block, Block_Masks& masks) {
+    masks.backslash = 0;
+    masks.quote = 0;
+    masks.whitespace = 0;
+    masks.operators = 0;
+
+    for (u32 index = 0; index < 64; index++) {
+        u64 bit = 1ull << index;
+
+        switch (block[index]) {
+            case '\\': masks.backslash |= bit; break;
+            case '"': masks.quote |= bit; break;
+            case '{': case '}': case '[': case ']': case ':': case ',': masks.operators |= bit; break;
+
+            default: {
+                if (block[index] <= ' ') {
+                    masks.whitespace |= bit;
+                }
+
+                break;
+            }
+        }
+    }
+}
+
+#endif
+
+// Every bit becomes the xor of itself and all the bits below it, so the bits between
+// an opening and a closing quote end up set
+static inline u64 prefix_xor(u64 bits) {
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+
+    return bits;
+}
+
+// Characters preceded by an odd number of backslashes, same approach as simdjson
+static inline u64 find_escaped_characters(u64 backslash, u64& previous_escaped) {
+    const u64 even_bits = 0x5555555555555555ull;
+
+    backslash &= ~previous_escaped;
+
+    u64 follows_escape = backslash << 1 | previous_escaped;
+    u64 odd_sequence_starts = backslash & ~even_bits & ~follows_escape;
+    u64 sequences_starting_on_even_bits = odd_sequence_starts + backslash;
+
+    previous_escaped = sequences_starting_on_even_bits < odd_sequence_starts;
+
+    u64 invert_mask = sequences_starting_on_even_bits << 1;
+
+    return (even_bits ^ invert_mask) & follows_escape;
+}
+
+// Returns positions of unescaped quotes, operators outside of strings and primitive starts
+static inline u64 find_structural_bits(const u8* block, Scanner_State& state) {
+    Block_Masks masks;
+
+    compute_block_masks(block, masks);
+
+    u64 escaped = find_escaped_characters(masks.backslash, state.previous_escaped);
+    u64 quotes = masks.quote & ~escaped;
+    u64 in_string = prefix_xor(quotes) ^ state.previous_in_string;
+
+    state.previous_in_string = (u64) ((s64) in_string >> 63);
+
+    u64 scalar = ~(masks.operators | masks.whitespace | quotes);
+    u64 follows_scalar = (scalar << 1) | state.previous_scalar;
+
+    state.previous_scalar = scalar >> 63;
+
+    u64 primitive_starts = scalar & ~follows_scalar;
+
+    return ((masks.operators | primitive_starts) & ~in_string) | quotes;
+}
+
+static inline void flatten_bits(u32* indices, u32& num_indices, u32 block_start, u64 bits) {
+    while (bits) {
+        indices[num_indices++] = block_start + (u32) __builtin_ctzll(bits);
+        bits &= bits - 1;
+    }
+}
+
+static u32* find_structural_indices(const u8* json, u32 json_length, u32& num_indices, bool& unclosed_string) {
+    Scanner_State state{};
+
+    u32 indices_capacity = json_length / 8 + 64;
+    u32* indices = (u32*) malloc(sizeof(u32) * indices_capacity);
+
+    num_indices = 0;
+
+    u32 block_start = 0;
+
+    for (; block_start + 64 <= json_length; block_start += 64) {
+        if (num_indices + 64 > indices_capacity) {
+            indices_capacity *= 2;
+            indices = (u32*) realloc(indices, sizeof(u32) * indices_capacity);
+        }
+
+        flatten_bits(indices, num_indices, block_start, find_structural_bits(json + block_start, state));
+    }
+
+    if (block_start < json_length) {
+        u8 last_block[64];
+
+        memset(last_block, ' ', 64);
+        memcpy(last_block, json + block_start, json_length - block_start);
+
+        if (num_indices + 64 > indices_capacity) {
+            indices_capacity += 64;
+            indices = (u32*) realloc(indices, sizeof(u32) * indices_capacity);
+        }
+
+        flatten_bits(indices, num_indices, block_start, find_structural_bits(last_block, state));
+    }
+
+    unclosed_string = state.previous_in_string != 0;
+
+    return indices;
+}
+
+static inline u32 find_primitive_end(const char* json, u32 json_length, u32 position) {
+    for (; position < json_length; position++) {
+        switch (json[position]) {
+            case '\t': case '\r': case '\n': case ' ':
+            case ',': case ']': case '}': case ':':
+                return position;
+
+            default: break;
+        }
+    }
+
+    return position;
+}
+
+static inline jsmntok_t* alloc_token(jsmntok_t* tokens, u32& num_tokens, jsmntype_t type, s32 start, s32 end, s32 parent) {
+    jsmntok_t* token = &tokens[num_tokens++];
+    token->type = type;
+    token->start = start;
+    token->end = end;
+    token->size = 0;
+    token->skip = 1;
+    token->parent = parent;
+
+    return token;
+}
+
+// Mirrors the jsmn_parse state machine, but only visits the positions found by the scanner
+s32 json_structural_parse(const char* json, u32 json_length, jsmntok_t*& tokens, u32& token_capacity) {
+    u32 num_indices = 0;
+    bool unclosed_string = false;
+    u32* indices = find_structural_indices((const u8*) json, json_length, num_indices, unclosed_string);
+
+    if (unclosed_string) {
+        free(indices);
+        return JSMN_ERROR_PART;
+    }
+
+    // A string takes two positions, everything else takes one
+    if (token_capacity < num_indices || !tokens) {
+        token_capacity = MAX(1, num_indices);
+        tokens = (jsmntok_t*) realloc(tokens, sizeof(jsmntok_t) * token_capacity);
+    }
+
+    u32 num_tokens = 0;
+    u32 num_open_containers = 0;
+    s32 super_token = -1;
+
+    for (u32 index = 0; index < num_indices; index++) {
+        u32 position = indices[index];
+        char c = json[position];
+
+        switch (c) {
+            case '{': case '[': {
+                if (super_token != -1) {
+                    tokens[super_token].size++;
+                }
+
+                alloc_token(tokens, num_tokens, c == '{' ? JSMN_OBJECT : JSMN_ARRAY, position, -1, super_token);
+
+                super_token = num_tokens - 1;
+                num_open_containers++;
+
+                break;
+            }
+
+            case '}': case ']': {
+                jsmntype_t type = c == '}' ? JSMN_OBJECT : JSMN_ARRAY;
+
+                if (num_tokens < 1) {
+                    free(indices);
+                    return JSMN_ERROR_INVAL;
+                }
+
+                jsmntok_t* token = &tokens[num_tokens - 1];
+
+                while (true) {
+                    if (token->start != -1 && token->end == -1) {
+                        if (token->type != type) {
+                            free(indices);
+                            return JSMN_ERROR_INVAL;
+                        }
+
+                        token->end = position + 1;
+                        token->skip = (s32) (num_tokens - (token - tokens));
+                        super_token = token->parent;
+                        num_open_containers--;
+
+                        break;
+                    }
+
+                    if (token->parent == -1) {
+                        if (token->type != type || super_token == -1) {
+                            free(indices);
+                            return JSMN_ERROR_INVAL;
+                        }
+
+                        break;
+                    }
+
+                    token = &tokens[token->parent];
+                }
+
+                break;
+            }
+
+            case '"': {
+                // Unescaped quotes always come in pairs here, the scanner has checked for an unclosed string
+                u32 closing_position = indices[++index];
+
+                alloc_token(tokens, num_tokens, JSMN_STRING, position + 1, closing_position, super_token);
+
+                if (super_token != -1) {
+                    tokens[super_token].size++;
+                }
+
+                break;
+            }
+
+            case ':': {
+                super_token = num_tokens - 1;
+                break;
+            }
+
+            case ',': {
+                if (super_token != -1 && tokens[super_token].type != JSMN_ARRAY && tokens[super_token].type != JSMN_OBJECT) {
+                    super_token = tokens[super_token].parent;
+                }
+
+                break;
+            }
+
+            default: {
+                u32 end = find_primitive_end(json, json_length, position);
+
+                alloc_token(tokens, num_tokens, JSMN_PRIMITIVE, position, end, super_token);
+
+                if (super_token != -1) {
+                    tokens[super_token].size++;
+                }
+
+                break;
+            }
+        }
+    }
+
+    free(indices);
+
+    if (num_open_containers) {
+        return JSMN_ERROR_PART;
+    }
+
+    return (s32) num_tokens;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include "common.h"
+#include <jsmn.h>
+
+// Alternative to jsmn_parse which first finds all quotes, escapes and structural characters
+// 64 bytes at a time, then builds the tokens by walking only those positions.
+// Produces exactly the same tokens jsmn does (with JSMN_PARENT_LINKS) for valid JSON, but doesn't
+// validate escapes or primitives. Never returns JSMN_ERROR_NOMEM since the structural
+// positions give an upper bound on the token count, tokens are (re)allocated with plain realloc.
+s32 json_structural_parse(const char* json, u32 json_length, jsmntok_t*& tokens, u32& token_capacity);
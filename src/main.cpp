@@ -26,6 +26,11 @@
 #include "header.h"
 #include "ui.h"
 #include "inbox.h"
+#include "string_pool.h"
+
+#if BENCHMARK
+#include "benchmark.h"
+#endif
 
 const Request_Id NO_REQUEST = -1;
 const Request_Id FOLDER_TREE_CHILDREN_REQUEST = -2; // TODO BIG HAQ
@@ -67,17 +72,8 @@ Task_Id selected_folder_task_id = 0;
 
 Task current_task{};
 
-static char* task_json_content = NULL;
-static char* account_json_content = NULL;
-static char* folder_tasks_json_content = NULL;
-static char* workflows_json_content = NULL;
-static char* folder_header_json_content = NULL;
-static char* suggested_folders_json_content = NULL; // TODO looks like a lot of waste
-static char* suggested_users_json_content = NULL; // TODO also there
-static char* starred_folders_json_content = NULL;
-static char* spaces_json_content = NULL;
-static char* spaces_folders_json_content = NULL;
-static char* inbox_json_content = NULL;
+// Responses are freed right after processing, these would have been kept alive otherwise
+static u64 released_response_bytes = 0;
 
 ImFont* font_regular;
 ImFont* font_28px;
@@ -123,6 +119,19 @@ PRINTLIKE(3, 4) void api_request(Http_Method method, Request_Id& request_id, con
     platform_api_request(request_id, url, method);
 }
 
+PRINTLIKE(4, 5) void api_request_with_builder(Request_Id& request_id, Response_Builder builder, void* data, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+
+    String url = tprintf(format, args);
+
+    va_end(args);
+
+    request_id = request_id_counter++;
+
+    platform_api_request(request_id, url, Http_Get, data, builder);
+}
+
 PRINTLIKE(2, 3) void image_request(Request_Id& request_id, const char* format, ...) {
     va_list args;
     va_start(args, format);
@@ -142,13 +151,7 @@ struct Json_With_Tokens {
     u32 num_tokens;
 };
 
-static void process_json_content(char*& json_reference, Data_Process_Callback callback, Json_With_Tokens json_with_tokens) {
-    if (json_reference) {
-        FREE(json_reference);
-    }
-
-    json_reference = json_with_tokens.json;
-
+static void process_json_content(Data_Process_Callback callback, Json_With_Tokens json_with_tokens) {
     process_json_data_segment(json_with_tokens.json, json_with_tokens.tokens, json_with_tokens.num_tokens, callback);
 }
 
@@ -159,7 +162,7 @@ void request_folder_children_for_folder_tree(Folder_Id folder_id) {
 
     String url = tprintf("folders/%.16s/folders?descendants=false&fields=['color']", output_folder_and_account_id);
 
-    platform_api_request(FOLDER_TREE_CHILDREN_REQUEST, url, Http_Get, (void*) (intptr_t) folder_id);
+    platform_api_request(FOLDER_TREE_CHILDREN_REQUEST, url, Http_Get, (void*) (intptr_t) folder_id, build_folder_tree_children_batch);
 }
 
 static String build_folder_request_url(Array<Folder_Id> folders) {
@@ -223,7 +226,7 @@ void request_multiple_users(Array<User_Id> users) {
         }
     }
 
-    platform_api_request(LOAD_USERS_REQUEST, url, Http_Get, NULL);
+    platform_api_request(LOAD_USERS_REQUEST, url, Http_Get, NULL, build_users_batch);
 }
 
 static void request_multiple_custom_fields(Array<Custom_Field_Id> custom_fields) {
@@ -283,69 +286,85 @@ extern "C"
 EXPORT
 void api_request_success(Request_Id request_id, char* content, u32 content_length, void* data) {
 //    printf("Got request %lu with content at %p\n", request_id, (void*) content_json);
+    u32 num_tokens = 0;
+    u32 token_capacity = 0;
+    jsmntok_t* tokens = parse_json_into_tokens(content, content_length, num_tokens, token_capacity, JSON_UNKNOWN_ENDPOINT);
+
+    api_request_success_with_tokens(request_id, content, content_length, tokens, num_tokens, data, NULL);
+
+    json_token_pool_release(JSON_UNKNOWN_ENDPOINT, tokens, token_capacity, num_tokens, content_length);
+}
+
+void api_request_success_with_tokens(Request_Id request_id, char* content, u32 content_length, jsmntok_t* tokens, u32 num_tokens, void* data, void* prepared) {
     Json_With_Tokens json_with_tokens;
     json_with_tokens.json = content;
-    json_with_tokens.tokens = parse_json_into_tokens(content, content_length, json_with_tokens.num_tokens);
+    json_with_tokens.tokens = tokens;
+    json_with_tokens.num_tokens = num_tokens;
 
     if (request_id == FOLDER_TREE_CHILDREN_REQUEST) {
-        // TODO @Leak content is leaked
-        process_folder_tree_children_request((Folder_Id) (intptr_t) data, content, json_with_tokens.tokens, json_with_tokens.num_tokens);
+        if (!prepared) {
+            prepared = build_folder_tree_children_batch(content, tokens, num_tokens, data);
+        }
+
+        process_folder_tree_children_request((Folder_Id) (intptr_t) data, prepared);
     } else if (request_id == NOTIFICATION_MARK_AS_READ_REQUEST) {
-        // TODO @Leak content is leaked
-        process_json_data_segment(content, json_with_tokens.tokens, json_with_tokens.num_tokens, process_inbox_data);
+        process_json_content(process_inbox_data, json_with_tokens);
     } else if (request_id == LOAD_USERS_REQUEST) {
-        // TODO @Leak content is leaked
-        process_json_data_segment(content, json_with_tokens.tokens, json_with_tokens.num_tokens, process_users_data);
+        if (!prepared) {
+            prepared = build_users_batch(content, tokens, num_tokens, data);
+        }
+
+        publish_users_batch(prepared);
     } else if (request_id == LOAD_CUSTOM_FIELDS_REQUEST) {
-        // TODO @Leak content is leaked
-        process_json_data_segment(content, json_with_tokens.tokens, json_with_tokens.num_tokens, process_custom_fields_data);
+        process_json_content(process_custom_fields_data, json_with_tokens);
     } else if (request_id == me_request) {
         me_request = NO_REQUEST;
-        process_json_data_segment(content, json_with_tokens.tokens, json_with_tokens.num_tokens, process_users_data);
+        process_json_content(process_users_data, json_with_tokens);
         finished_loading_me_at = tick;
     } else if (request_id == starred_folders_request) {
         starred_folders_request = NO_REQUEST;
 
-        process_json_content(starred_folders_json_content, process_starred_folders_data, json_with_tokens);
+        process_json_content(process_starred_folders_data, json_with_tokens);
     } else if (request_id == spaces_request) {
         spaces_request = NO_REQUEST;
 
-        process_json_content(spaces_json_content, process_spaces_data, json_with_tokens);
+        process_json_content(process_spaces_data, json_with_tokens);
     } else if (request_id == spaces_folders_request) {
         spaces_folders_request = NO_REQUEST;
 
-        process_json_content(spaces_folders_json_content, process_spaces_folders_data, json_with_tokens);
+        process_json_content(process_spaces_folders_data, json_with_tokens);
     } else if (request_id == folders_request) {
         folders_request = NO_REQUEST;
 
-        // TODO @Leak content is leaked
-        process_json_data_segment(content, json_with_tokens.tokens, json_with_tokens.num_tokens, process_multiple_folders_data);
+        process_json_content(process_multiple_folders_data, json_with_tokens);
     } else if (request_id == folder_contents_request) {
         folder_contents_request = NO_REQUEST;
 
-        process_json_content(folder_tasks_json_content, process_folder_contents_data, json_with_tokens);
+        if (!prepared) {
+            prepared = build_folder_contents(content, tokens, num_tokens, data);
+        }
+
+        publish_folder_contents(prepared);
         finished_loading_folder_contents_at = tick;
     } else if (request_id == folder_header_request) {
         folder_header_request = NO_REQUEST;
 
-        process_json_content(folder_header_json_content, process_folder_header_data, json_with_tokens);
+        process_json_content(process_folder_header_data, json_with_tokens);
         finished_loading_folder_header_at = tick;
     } else if (request_id == task_request) {
         task_request = NO_REQUEST;
 
-        process_json_content(task_json_content, process_task_data, json_with_tokens);
+        process_json_content(process_task_data, json_with_tokens);
         finished_loading_task_at = tick;
     } else if (request_id == task_comments_request) {
         task_comments_request = NO_REQUEST;
 
-        process_json_data_segment(json_with_tokens.json, json_with_tokens.tokens, json_with_tokens.num_tokens, process_task_comments_data);
+        process_json_content(process_task_comments_data, json_with_tokens);
         finished_loading_task_comments_at = tick;
-
-        FREE(json_with_tokens.json);
     } else if (request_id == account_request) {
         account_request = NO_REQUEST;
 
-        process_json_content(account_json_content, process_account_data, json_with_tokens);
+        process_json_content(process_account_data, json_with_tokens);
 
         printf("Received account, account.id %d\n", account.id);
 
@@ -356,26 +375,33 @@ void api_request_success(Request_Id request_id, char* content, u32 content_lengt
         finished_loading_account_at = tick;
     } else if (request_id == workflows_request) {
         workflows_request = NO_REQUEST;
-        process_json_content(workflows_json_content, process_workflows_data, json_with_tokens);
+        process_json_content(process_workflows_data, json_with_tokens);
 
         custom_statuses_were_loaded = true;
         finished_loading_statuses_at = tick;
     } else if (request_id == suggested_folders_request) {
         suggested_folders_request = NO_REQUEST;
-        process_json_content(suggested_folders_json_content, process_suggested_folders_data, json_with_tokens);
+        process_json_content(process_suggested_folders_data, json_with_tokens);
     } else if (request_id == suggested_contacts_request) {
         suggested_contacts_request = NO_REQUEST;
-        process_json_content(suggested_users_json_content, process_suggested_users_data, json_with_tokens);
+        process_json_content(process_suggested_users_data, json_with_tokens);
     } else if (request_id == inbox_request) {
         inbox_request = NO_REQUEST;
-        process_json_content(inbox_json_content, process_inbox_data, json_with_tokens);
+        process_json_content(process_inbox_data, json_with_tokens);
     } else if (request_id == modify_task_request) {
         modify_task_request = NO_REQUEST;
 
-        process_json_content(task_json_content, process_task_data, json_with_tokens);
+        process_json_content(process_task_data, json_with_tokens);
+        process_json_content(process_task_list_modification_data, json_with_tokens);
+    } else if (prepared) {
+        // Only folder contents can be superseded by a newer request while being built
+        free_folder_contents(prepared);
     }
 
-    FREE(json_with_tokens.tokens);
+    // Entity strings are interned or copied while processing, nothing points into the response anymore
+    FREE(content);
+
+    released_response_bytes += content_length;
 }
 
 bool try_accept_loaded_image(Request_Id request_id, Memory_Image image) {
@@ -440,8 +466,9 @@ void select_and_request_folder_by_id(Folder_Id id) {
 
     platform_local_storage_set("last_selected_folder", tprintf("%i", id));
 
-    api_request(Http_Get, folder_contents_request, "folders/%.*s/tasks%s", id_length, output_account_and_folder_id,
-                "?fields=['customFields','superTaskIds','parentIds','responsibleIds']&subTasks=true");
+    api_request_with_builder(folder_contents_request, build_folder_contents, (void*) (intptr_t) id,
+                             "folders/%.*s/tasks%s", id_length, output_account_and_folder_id,
+                             "?fields=['customFields','superTaskIds','parentIds','responsibleIds']&subTasks=true");
 
     if (id >= 0) {
         api_request(Http_Get, folder_header_request, "folders/%.*s%s", id_length, output_account_and_folder_id, "?fields=['customColumnIds']");
@@ -559,6 +586,29 @@ static void draw_average_frame_time() {
     ImVec2 top_left = ImGui::GetIO().DisplaySize - ImVec2(200.0f, 20.0f) * platform_get_pixel_ratio();
 
     ImGui::GetForegroundDrawList()->AddText(top_left, IM_COL32_BLACK, text_start, text_end);
+
+    Temporary_Storage_Stats temporary_storage = get_temporary_storage_stats();
+
+    tprintf("Temp: %.2f/%.0fMB, %i overflows", &text_start, &text_end,
+            temporary_storage.peak_bytes_used / (1024.0f * 1024.0f),
+            temporary_storage.bytes_reserved / (1024.0f * 1024.0f),
+            temporary_storage.num_overflows);
+
+    top_left.y -= ImGui::GetFontSize();
+
+    u32 color = temporary_storage.num_overflows ? IM_COL32(200, 0, 0, 255) : IM_COL32_BLACK;
+
+    ImGui::GetForegroundDrawList()->AddText(top_left, color, text_start, text_end);
+
+    String_Pool_Stats string_pool = get_string_pool_stats();
+
+    tprintf("Strings: %.0fKB kept, %.2fMB of responses freed", &text_start, &text_end,
+            string_pool.bytes_reserved / 1024.0f,
+            released_response_bytes / (1024.0f * 1024.0f));
+
+    top_left.y -= ImGui::GetFontSize();
+
+    ImGui::GetForegroundDrawList()->AddText(top_left, IM_COL32_BLACK, text_start, text_end);
 }
 
 #if DEBUG_MEMORY
@@ -571,6 +621,12 @@ static void draw_memory_debug_contents() {
     ImGui::Text("%f %f", io.DisplaySize.x, io.DisplaySize.y);
     ImGui::Text("%f %f", io.DisplayFramebufferScale.x, io.DisplayFramebufferScale.y);
 
+    String_Pool_Stats string_pool = get_string_pool_stats();
+
+    ImGui::Text("Interned %u strings, %u bytes, %llu bytes deduplicated, %llu response bytes freed",
+                string_pool.num_strings, string_pool.bytes_stored,
+                (unsigned long long) string_pool.bytes_deduplicated, (unsigned long long) released_response_bytes);
+
     if (ImGui::ListBoxHeader("Memory allocations", ImVec2(-1, -1))) {
         draw_memory_records();
 
@@ -861,8 +917,6 @@ static void imgui_free_wrapper(void* ptr, void* user_data) {
 }
 
 static bool init() {
-    platform_early_init();
-
     init_user_storage();
     init_custom_field_storage();
     init_folder_tree();
@@ -899,7 +953,15 @@ static bool init() {
 }
 
 EXPORT
-int main() {
+int main(int argc, char** argv) {
+    platform_early_init();
+
+#if BENCHMARK
+    if (!run_benchmarks(argc, argv)) {
+        return 0;
+    }
+#endif
+
     if (!init()) {
         return -1;
     }
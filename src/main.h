@@ -2,6 +2,7 @@
 
 #include "common.h"
 #include "rich_text.h"
+#include <jsmn.h>
 
 extern "C"
 void loop();
@@ -9,6 +10,14 @@ void loop();
 extern "C"
 void api_request_success(Request_Id request_id, char* content, u32 content_length, void* data);
 
+// Turns a tokenized response into a ready to publish structure, gets called off the main thread
+// when the platform supports it, so it must not touch any global state
+typedef void* (*Response_Builder)(char* json, jsmntok_t* tokens, u32 num_tokens, void* data);
+
+// Used when the platform layer has already tokenized the content, tokens are still owned by the caller
+// prepared is the result of the request builder if the platform has already run it, NULL otherwise
+void api_request_success_with_tokens(Request_Id request_id, char* content, u32 content_length, jsmntok_t* tokens, u32 num_tokens, void* data, void* prepared);
+
 extern "C"
 void image_load_success(Request_Id request_id, u8* pixel_data, u32 width, u32 height);
 
@@ -20,7 +20,7 @@ float platform_get_delta_time_ms(u64 delta_to);
 
 void platform_open_url(String& permalink);
 
-void platform_api_request(Request_Id request_id, String url, Http_Method method, void* data = NULL);
+void platform_api_request(Request_Id request_id, String url, Http_Method method, void* data = NULL, Response_Builder builder = NULL);
 void platform_load_remote_image(Request_Id request_id, String full_url);
 void platform_local_storage_set(const char* key, String value); // TODO bad definition...
 
@@ -29,6 +29,15 @@ char* platform_local_storage_get(const char* key); // You own the memory!
 
 void platform_load_png_async(Array<u8> in, Image_Load_Callback callback);
 
+typedef void (*Parallel_Job)(void* data, u32 job_index);
+
+// Only called from the main thread. Runs job for every index in [0, num_jobs) on the worker threads
+//  and the calling thread, returns when all jobs are done. Jobs must not allocate or log memory
+void platform_run_parallel(u32 num_jobs, Parallel_Job job, void* data);
+
+// Worker threads plus the main thread, 1 when platform_run_parallel is sequential
+u32 platform_get_num_parallel_threads();
+
 u64 platform_make_texture(u32 width, u32 height, u8* pixels);
 
 // Can return a temporary string
@@ -305,7 +305,7 @@ void platform_load_remote_image(Request_Id request_id, String full_url) {
     EM_ASM({ load_image(Pointer_stringify($0, $1), $2) }, full_url.start, full_url.length, request_id);
 }
 
-void platform_api_request(Request_Id request_id, String url, Http_Method method, void* data) {
+void platform_api_request(Request_Id request_id, String url, Http_Method method, void* data, Response_Builder builder) {
     const s8* method_as_string;
     switch (method) {
         case Http_Put: {
@@ -347,6 +347,17 @@ void platform_load_png_async(Array<u8> in, Image_Load_Callback callback) {
     EM_ASM({ decode_png($0, $1, $2); }, in.data, in.length, callback);
 }
 
+// TODO no worker threads yet, jobs simply run one after another
+void platform_run_parallel(u32 num_jobs, Parallel_Job job, void* data) {
+    for (u32 job_index = 0; job_index < num_jobs; job_index++) {
+        job(data, job_index);
+    }
+}
+
+u32 platform_get_num_parallel_threads() {
+    return 1;
+}
+
 u64 platform_make_texture(u32 width, u32 height, u8 *pixels) {
     return opengl_make_texture(width, height, pixels);
 }
@@ -517,6 +517,17 @@ void platform_open_url(String& permalink){
     printf("Open url: %s\n", success ? "ok" : "error");
 }
 
+// TODO no worker threads yet, jobs simply run one after another
+void platform_run_parallel(u32 num_jobs, Parallel_Job job, void* data) {
+    for (u32 job_index = 0; job_index < num_jobs; job_index++) {
+        job(data, job_index);
+    }
+}
+
+u32 platform_get_num_parallel_threads() {
+    return 1;
+}
+
 u64 platform_make_texture(u32 width, u32 height, u8* pixels) {
     MTLTextureDescriptor *texture_descriptor = [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:MTLPixelFormatRGBA8Unorm
                                                                                                   width:width
@@ -531,7 +542,7 @@ u64 platform_make_texture(u32 width, u32 height, u8* pixels) {
     return (uintptr_t) (__bridge void *) texture;
 }
 
-void platform_api_request(Request_Id request_id, String path, Http_Method method, void* extra_data){
+void platform_api_request(Request_Id request_id, String path, Http_Method method, void* extra_data, Response_Builder builder){
     printf("Requested api get for %i/%.*s\n", request_id, path.length, path.start);
 
     String full_url = tprintf("%s%.*s", "https://www.wrike.com/api/v4/", path.length, path.start);
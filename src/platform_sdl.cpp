@@ -7,6 +7,12 @@
 #include "common.h"
 #include "platform.h"
 #include "main.h"
+#include "json.h"
+#include "temporary_storage.h"
+
+#if BENCHMARK
+#include "benchmark.h"
+#endif
 
 #include "opengl.cpp"
 
@@ -22,8 +28,20 @@ struct Running_Request {
     char* debug_url = NULL;
     char* data_read = NULL;
     u32 data_length = 0;
+    u32 data_capacity = 0;
     u64 started_at = 0;
     void* data = NULL;
+    Http_Method method = Http_Get;
+    CURL* curl_easy = NULL;
+
+    // API responses are tokenized on the network thread while they are downloading
+    Json_Stream json_stream;
+    jsmntok_t* tokens = NULL;
+    u32 num_tokens = 0;
+
+    // Runs on the response builder thread, the main thread receives the prepared result
+    Response_Builder builder = NULL;
+    void* prepared = NULL;
 };
 
 static Gl_Data gl_data{};
@@ -34,6 +52,59 @@ static SDL_GLContext gl_context;
 static Running_Request** running_requests = NULL;
 static u32 num_running_requests = 0;
 
+// All transfers are driven by a single network thread through a curl multi handle.
+// The main thread only appends to the pending queue and wakes the network thread up.
+static const u32 max_concurrent_transfers = 8;
+
+static CURLM* curl_multi = NULL;
+static SDL_mutex* pending_requests_mutex = NULL;
+static Running_Request** pending_requests = NULL;
+static u32 num_pending_requests = 0;
+static u32 pending_requests_capacity = 0;
+
+// Easy handles, the DNS cache, TLS sessions and open connections are reused across transfers.
+// Only the network thread touches those, so the share handle doesn't need lock callbacks.
+static CURLSH* curl_share = NULL;
+static CURL* easy_handle_pool[max_concurrent_transfers];
+static u32 num_pooled_easy_handles = 0;
+static curl_slist* api_header_chunk = NULL;
+
+// Successfully tokenized responses with a builder are handed over from the network thread,
+// so the main thread only has to publish the result
+static SDL_mutex* requests_to_build_mutex = NULL;
+static SDL_cond* requests_to_build_condition = NULL;
+static Running_Request** requests_to_build = NULL;
+static u32 num_requests_to_build = 0;
+static u32 requests_to_build_capacity = 0;
+
+// A single platform_run_parallel call at a time, workers and the main thread grab job indices until they run out
+struct Parallel_Work {
+    Parallel_Job job;
+    void* data;
+    u32 num_jobs;
+    SDL_atomic_t next_job;
+};
+
+static const u32 max_parallel_workers = 15;
+
+static Parallel_Work parallel_work;
+static SDL_sem* parallel_work_available = NULL;
+static SDL_sem* parallel_worker_finished = NULL;
+static u32 num_parallel_workers = 0;
+
+#if BENCHMARK
+struct Network_Benchmark_Stats {
+    u32 num_transfers;
+    double total_name_lookup;
+    double total_connect;
+    double total_app_connect;
+    double total_start_transfer;
+};
+
+static Network_Benchmark_Stats benchmark_new_connections{};
+static Network_Benchmark_Stats benchmark_reused_connections{};
+#endif
+
 static Uint64 application_time = 0;
 static bool mouse_pressed[3] = { false, false, false };
 
@@ -240,14 +311,18 @@ static void process_completed_requests() {
 
         if (status) {
             // Memory logging is not thread-safe
-            LOG_MEMORY(request->data_read, request->data_length);
+            LOG_MEMORY(request->data_read, request->data_capacity);
 
             if (status == 200) {
                 u64 start_process_request = SDL_GetPerformanceCounter();
 
                 switch (request->request_type) {
                     case Request_Type_API: {
-                        api_request_success(request->request_id, request->data_read, request->data_length, request->data);
+                        if (request->tokens) {
+                            api_request_success_with_tokens(request->request_id, request->data_read, request->data_length, request->tokens, request->num_tokens, request->data, request->prepared);
+                        } else {
+                            api_request_success(request->request_id, request->data_read, request->data_length, request->data);
+                        }
 
                         break;
                     }
@@ -269,6 +344,10 @@ static void process_completed_requests() {
             }
 
             // data_read is managed by receiver in case of 200
+            if (request->tokens) {
+                json_stream_release(request->json_stream, request->num_tokens, request->data_length);
+            }
+
             FREE(request->debug_url);
             FREE(request);
 
@@ -380,56 +459,263 @@ static size_t handle_curl_write(char *ptr, size_t size, size_t nmemb, void *user
     assert(request);
 
     u32 received_data_length = size * nmemb;
+    u32 required_capacity = request->data_length + received_data_length;
+
+    if (required_capacity > request->data_capacity) {
+        curl_off_t content_length = -1;
+        curl_easy_getinfo(request->curl_easy, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &content_length);
+
+        u32 new_capacity = MAX(required_capacity, request->data_capacity * 2);
+
+        if (content_length > 0) {
+            new_capacity = MAX(new_capacity, (u32) content_length);
+
+            request->json_stream.expected_length = (u32) content_length;
+        }
+
+        // Memory logging is not thread safe, so we don't use the macro here and rather LOG_MEMORY later
+        request->data_read = (char*) realloc(request->data_read, new_capacity);
+        request->data_capacity = new_capacity;
+    }
 
-    // Memory logging is not thread safe, so we don't use the macro here and rather LOG_MEMORY later
-    // TODO very inefficient
-    request->data_read = (char*) realloc(request->data_read, request->data_length + received_data_length);
     memcpy(request->data_read + request->data_length, ptr, received_data_length);
     request->data_length += received_data_length;
 
+    if (request->request_type == Request_Type_API) {
+        json_stream_feed(request->json_stream, request->data_read, request->data_length);
+    }
+
     return received_data_length;
 }
 
-int curl_thread_request(void* data) {
-    CURL* curl = data;
-    CURLcode result = curl_easy_perform(curl);
+#if BENCHMARK
+static void print_network_benchmark(Running_Request* request, CURL* curl) {
+    double total, name, conn, app, pre, start;
+    long num_new_connections = 0;
+    curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME, &total);
+    curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME, &name);
+    curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME, &conn);
+    curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME, &app);
+    curl_easy_getinfo(curl, CURLINFO_PRETRANSFER_TIME, &pre);
+    curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME, &start);
+    curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &num_new_connections);
+
+    bool connection_reused = num_new_connections == 0;
+
+    Network_Benchmark_Stats& stats = connection_reused ? benchmark_reused_connections : benchmark_new_connections;
+    stats.num_transfers++;
+    stats.total_name_lookup += name;
+    stats.total_connect += conn;
+    stats.total_app_connect += app;
+    stats.total_start_transfer += start;
+
+    printf("CURL TIME #%i (%s connection): name %.1fms, conn %.1fms, app %.1fms, pre %.1fms, start %.1fms, total %.1fms\n",
+           request->request_id,
+           connection_reused ? "reused" : "new",
+           name * 1000.0, conn * 1000.0, app * 1000.0, pre * 1000.0, start * 1000.0, total * 1000.0
+    );
+
+    for (u32 index = 0; index < 2; index++) {
+        Network_Benchmark_Stats& average = index == 0 ? benchmark_new_connections : benchmark_reused_connections;
+
+        if (!average.num_transfers) continue;
+
+        printf("CURL TIME average over %u %s connections: name %.1fms, conn %.1fms, app %.1fms, start %.1fms\n",
+               average.num_transfers,
+               index == 0 ? "new" : "reused",
+               average.total_name_lookup * 1000.0 / average.num_transfers,
+               average.total_connect * 1000.0 / average.num_transfers,
+               average.total_app_connect * 1000.0 / average.num_transfers,
+               average.total_start_transfer * 1000.0 / average.num_transfers
+        );
+    }
+}
+#endif
 
-    if (result != CURLE_OK) {
-        printf("curl_easy_perform() failed: %s\n", curl_easy_strerror(result));
+static CURL* acquire_easy_handle() {
+    if (num_pooled_easy_handles) {
+        return easy_handle_pool[--num_pooled_easy_handles];
+    }
+
+    return curl_easy_init();
+}
+
+static void release_easy_handle(CURL* curl) {
+    if (num_pooled_easy_handles < max_concurrent_transfers) {
+        // Keeps the handle itself alive, connections are held by the share and multi handles
+        curl_easy_reset(curl);
+        easy_handle_pool[num_pooled_easy_handles++] = curl;
     } else {
-        u32 http_status_code = 0;
+        curl_easy_cleanup(curl);
+    }
+}
+
+static CURL* make_easy_handle_for_request(Running_Request* request) {
+    CURL* curl_easy = acquire_easy_handle();
+    curl_easy_setopt(curl_easy, CURLOPT_URL, request->debug_url);
+    curl_easy_setopt(curl_easy, CURLOPT_PRIVATE, request);
+    curl_easy_setopt(curl_easy, CURLOPT_WRITEDATA, request);
+    curl_easy_setopt(curl_easy, CURLOPT_WRITEFUNCTION, &handle_curl_write);
+    curl_easy_setopt(curl_easy, CURLOPT_BUFFERSIZE, CURL_MAX_READ_SIZE);
+    curl_easy_setopt(curl_easy, CURLOPT_SHARE, curl_share);
+
+    request->curl_easy = curl_easy;
+
+    if (request->request_type == Request_Type_API) {
+        curl_easy_setopt(curl_easy, CURLOPT_HTTPHEADER, api_header_chunk);
+    }
+
+    if (request->method == Http_Put) {
+        curl_easy_setopt(curl_easy, CURLOPT_CUSTOMREQUEST, "PUT");
+    }
+
+    return curl_easy;
+}
 
-        Running_Request* request = NULL;
+// Only called from the network thread
+static void queue_response_build(Running_Request* request) {
+    SDL_LockMutex(requests_to_build_mutex);
 
+    if (num_requests_to_build == requests_to_build_capacity) {
+        requests_to_build_capacity = MAX(16, requests_to_build_capacity * 2);
+
+        // Not traced, that would have to happen on the main thread
+        requests_to_build = (Running_Request**) realloc(requests_to_build, requests_to_build_capacity * sizeof(Running_Request*));
+    }
+
+    requests_to_build[num_requests_to_build++] = request;
+
+    SDL_CondSignal(requests_to_build_condition);
+    SDL_UnlockMutex(requests_to_build_mutex);
+}
+
+static int response_builder_thread(void* unused) {
+    while (true) {
+        SDL_LockMutex(requests_to_build_mutex);
+
+        while (!num_requests_to_build) {
+            SDL_CondWait(requests_to_build_condition, requests_to_build_mutex);
+        }
+
+        Running_Request* request = requests_to_build[0];
+
+        num_requests_to_build--;
+
+        memmove(requests_to_build, requests_to_build + 1, num_requests_to_build * sizeof(Running_Request*));
+
+        SDL_UnlockMutex(requests_to_build_mutex);
+
+        u64 start = SDL_GetPerformanceCounter();
+
+        // Temporary allocations of the previous build are not used anymore
+        clear_temporary_storage();
+
+        request->prepared = request->builder(request->data_read, request->tokens, request->num_tokens, request->data);
+
+        printf("Built #%i off the main thread in %.3fms\n", request->request_id, (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency());
+
+        // Same as in finish_transfer, the status is published last
+        request->status_code_or_zero = 200;
+    }
+
+    return 0;
+}
+
+static void finish_transfer(CURL* curl, CURLcode result) {
+    Running_Request* request = NULL;
+    u32 http_status_code = 0;
+
+    curl_easy_getinfo(curl, CURLINFO_PRIVATE, &request);
+
+    assert(request);
+
+    if (result != CURLE_OK) {
+        printf("Request #%i to %s failed: %s\n", request->request_id, request->debug_url, curl_easy_strerror(result));
+    } else {
         curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_status_code);
-        curl_easy_getinfo(curl, CURLINFO_PRIVATE, &request);
 
-        assert(request);
         assert(http_status_code);
 
         float time = (float) (((double) SDL_GetPerformanceCounter() - request->started_at) / SDL_GetPerformanceFrequency());
 
         printf("GET %s #%i completed with %i, time: %fs\n", request->debug_url, request->request_id, http_status_code, time);
 
-        double total, name, conn, app, pre, start;
-        curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME, &total);
-        curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME, &name);
-        curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME, &conn);
-        curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME, &app);
-        curl_easy_getinfo(curl, CURLINFO_PRETRANSFER_TIME, &pre);
-        curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME, &start);
+#if BENCHMARK
+        if (benchmark_network) {
+            print_network_benchmark(request, curl);
+        }
+#endif
+
+        if (request->request_type == Request_Type_API) {
+            if (json_stream_finish(request->json_stream, request->data_read, request->data_length, request->num_tokens)) {
+                request->tokens = request->json_stream.tokens;
+
+                printf("Tokenized %i tokens of #%i while downloading in %.3fms\n",
+                       request->num_tokens,
+                       request->request_id,
+                       request->json_stream.time_spent * 1000.0 / SDL_GetPerformanceFrequency()
+                );
+            } else {
+                // Let the main thread parse it again and report the error
+                json_stream_release(request->json_stream, 0, 0);
+            }
+        }
+    }
 
-//        printf("CURL TIME: total %f\n", total);
-//        printf("CURL TIME: name %f\n", name);
-//        printf("CURL TIME: conn %f\n", conn);
-//        printf("CURL TIME: app %f\n", app);
-//        printf("CURL TIME: pre %f\n", pre);
-//        printf("CURL TIME: start %f\n", start);
+    curl_multi_remove_handle(curl_multi, curl);
+    release_easy_handle(curl);
+    request->curl_easy = NULL;
 
-        request->status_code_or_zero = http_status_code;
+    if (http_status_code == 200 && request->tokens && request->builder) {
+        queue_response_build(request);
+        return;
     }
 
-    curl_easy_cleanup(curl);
+    // Has to be the last write, the main thread picks the request up as soon as it sees the status
+    request->status_code_or_zero = http_status_code;
+}
+
+static u32 start_pending_transfers(u32 num_active_transfers) {
+    SDL_LockMutex(pending_requests_mutex);
+
+    u32 num_transfers_to_start = MIN(num_pending_requests, max_concurrent_transfers - num_active_transfers);
+
+    for (u32 index = 0; index < num_transfers_to_start; index++) {
+        curl_multi_add_handle(curl_multi, make_easy_handle_for_request(pending_requests[index]));
+    }
+
+    num_pending_requests -= num_transfers_to_start;
+
+    memmove(pending_requests, pending_requests + num_transfers_to_start, num_pending_requests * sizeof(Running_Request*));
+
+    SDL_UnlockMutex(pending_requests_mutex);
+
+    return num_transfers_to_start;
+}
+
+static int network_thread(void* unused) {
+    u32 num_active_transfers = 0;
+
+    while (true) {
+        num_active_transfers += start_pending_transfers(num_active_transfers);
+
+        int num_running_transfers = 0;
+        curl_multi_perform(curl_multi, &num_running_transfers);
+
+        CURLMsg* message;
+        int num_messages_left = 0;
+
+        while ((message = curl_multi_info_read(curl_multi, &num_messages_left))) {
+            if (message->msg == CURLMSG_DONE) {
+                finish_transfer(message->easy_handle, message->data.result);
+
+                num_active_transfers--;
+            }
+        }
+
+        // Sleeps until there is socket activity or curl_multi_wakeup is called from the main thread
+        curl_multi_poll(curl_multi, NULL, 0, 1000, NULL);
+    }
 
     return 0;
 }
@@ -441,8 +727,112 @@ static void push_request(Running_Request* request) {
     running_requests[new_request_index] = request;
 }
 
+static void run_parallel_jobs(Parallel_Work* work) {
+    while (true) {
+        u32 job_index = (u32) SDL_AtomicAdd(&work->next_job, 1);
+
+        if (job_index >= work->num_jobs) {
+            return;
+        }
+
+        work->job(work->data, job_index);
+    }
+}
+
+static int parallel_worker_thread(void* unused) {
+    while (true) {
+        SDL_SemWait(parallel_work_available);
+
+        clear_temporary_storage();
+
+        run_parallel_jobs(&parallel_work);
+
+        SDL_SemPost(parallel_worker_finished);
+    }
+
+    return 0;
+}
+
+static void start_parallel_workers() {
+    parallel_work_available = SDL_CreateSemaphore(0);
+    parallel_worker_finished = SDL_CreateSemaphore(0);
+
+    // The main thread works too
+    num_parallel_workers = (u32) MIN(MAX(SDL_GetCPUCount() - 1, 0), (s32) max_parallel_workers);
+
+    for (u32 worker = 0; worker < num_parallel_workers; worker++) {
+        SDL_CreateThread(parallel_worker_thread, "ParallelWorkerThread", NULL);
+    }
+}
+
+void platform_run_parallel(u32 num_jobs, Parallel_Job job, void* data) {
+    if (!num_jobs) {
+        return;
+    }
+
+    u32 num_helping_workers = MIN(num_parallel_workers, num_jobs - 1);
+
+    parallel_work.job = job;
+    parallel_work.data = data;
+    parallel_work.num_jobs = num_jobs;
+    SDL_AtomicSet(&parallel_work.next_job, 0);
+
+    for (u32 worker = 0; worker < num_helping_workers; worker++) {
+        SDL_SemPost(parallel_work_available);
+    }
+
+    run_parallel_jobs(&parallel_work);
+
+    // Also makes sure no worker is still looking at parallel_work when it is reused
+    for (u32 worker = 0; worker < num_helping_workers; worker++) {
+        SDL_SemWait(parallel_worker_finished);
+    }
+}
+
+u32 platform_get_num_parallel_threads() {
+    return num_parallel_workers + 1;
+}
+
+// Only called from the main thread
+static void queue_transfer(Running_Request* request) {
+    push_request(request);
+
+    SDL_LockMutex(pending_requests_mutex);
+
+    if (num_pending_requests == pending_requests_capacity) {
+        pending_requests_capacity = MAX(16, pending_requests_capacity * 2);
+        pending_requests = (Running_Request**) REALLOC(pending_requests, pending_requests_capacity * sizeof(Running_Request*));
+    }
+
+    pending_requests[num_pending_requests++] = request;
+
+    SDL_UnlockMutex(pending_requests_mutex);
+
+    curl_multi_wakeup(curl_multi);
+}
+
 void platform_early_init() {
     curl_global_init(CURL_GLOBAL_DEFAULT);
+
+    curl_share = curl_share_init();
+    curl_share_setopt(curl_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(curl_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    curl_share_setopt(curl_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+
+    curl_multi = curl_multi_init();
+    curl_multi_setopt(curl_multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, (long) max_concurrent_transfers);
+
+    // jsmn or structural
+    json_select_tokenizer(getenv("WRIKE_JSON_TOKENIZER"));
+
+    start_parallel_workers();
+
+    pending_requests_mutex = SDL_CreateMutex();
+    requests_to_build_mutex = SDL_CreateMutex();
+    requests_to_build_condition = SDL_CreateCond();
+
+    SDL_CreateThread(network_thread, "NetworkThread", NULL);
+    SDL_CreateThread(response_builder_thread, "ResponseBuilderThread", NULL);
 }
 
 void platform_load_remote_image(Request_Id request_id, String full_url) {
@@ -458,27 +848,19 @@ void platform_load_remote_image(Request_Id request_id, String full_url) {
     memcpy(new_request->debug_url, full_url.start, full_url.length);
     new_request->debug_url[full_url.length] = 0;
 
-    CURL* curl_easy = curl_easy_init();
-    curl_easy_setopt(curl_easy, CURLOPT_URL, new_request->debug_url);
-    curl_easy_setopt(curl_easy, CURLOPT_PRIVATE, new_request);
-    curl_easy_setopt(curl_easy, CURLOPT_WRITEDATA, new_request);
-    curl_easy_setopt(curl_easy, CURLOPT_WRITEFUNCTION, &handle_curl_write);
-    curl_easy_setopt(curl_easy, CURLOPT_BUFFERSIZE, CURL_MAX_READ_SIZE);
-
-    push_request(new_request);
-
-    SDL_CreateThread(curl_thread_request, "CURLThread", curl_easy);
+    queue_transfer(new_request);
 }
 
-void platform_api_request(Request_Id request_id, String url, Http_Method method, void* data) {
+void platform_api_request(Request_Id request_id, String url, Http_Method method, void* data, Response_Builder builder) {
     printf("Requested api get for %i/%.*s\n", request_id, url.length, url.start);
 
     String full_url = tprintf("%s%.*s", "https://www.wrike.com/api/v4/", url.length, url.start);
 
-    // TODO cleanup those
-    curl_slist* header_chunk = NULL;
-    header_chunk = curl_slist_append(header_chunk, "Accept: application/json");
-    header_chunk = curl_slist_append(header_chunk, get_auth_header());
+    if (!api_header_chunk) {
+        // Published to the network thread through the pending requests mutex
+        api_header_chunk = curl_slist_append(api_header_chunk, "Accept: application/json");
+        api_header_chunk = curl_slist_append(api_header_chunk, get_auth_header());
+    }
 
     // TODO optimize
     Running_Request* new_request = (Running_Request*) CALLOC(1, sizeof(Running_Request));
@@ -488,25 +870,15 @@ void platform_api_request(Request_Id request_id, String url, Http_Method method,
     new_request->debug_url = (char*) MALLOC(full_url.length + 1);
     new_request->started_at = SDL_GetPerformanceCounter();
     new_request->data = data;
+    new_request->method = method;
+    new_request->builder = builder;
+
+    json_stream_init(new_request->json_stream, json_endpoint_hash(url.start, url.length));
 
     memcpy(new_request->debug_url, full_url.start, full_url.length);
     new_request->debug_url[full_url.length] = 0;
 
-    CURL* curl_easy = curl_easy_init();
-    curl_easy_setopt(curl_easy, CURLOPT_URL, new_request->debug_url);
-    curl_easy_setopt(curl_easy, CURLOPT_HTTPHEADER, header_chunk);
-    curl_easy_setopt(curl_easy, CURLOPT_PRIVATE, new_request);
-    curl_easy_setopt(curl_easy, CURLOPT_WRITEDATA, new_request);
-    curl_easy_setopt(curl_easy, CURLOPT_WRITEFUNCTION, &handle_curl_write);
-    curl_easy_setopt(curl_easy, CURLOPT_BUFFERSIZE, CURL_MAX_READ_SIZE);
-
-    if (method == Http_Put) {
-        curl_easy_setopt(curl_easy, CURLOPT_CUSTOMREQUEST, "PUT");
-    }
-
-    push_request(new_request);
-
-    SDL_CreateThread(curl_thread_request, "CURLThread", curl_easy);
+    queue_transfer(new_request);
 }
 
 // TODO super duper temporary coderino
@@ -0,0 +1,651 @@
+#include "search.h"
+#include "platform.h"
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+
+// Longer queries are cut, longer texts are always reindexed
+static const u32 max_stack_query_length = 256;
+
+// Small pools are not worth copying
+static const u32 min_dead_text_bytes_to_compact = 4096;
+
+static inline u32 pack_trigram(const char* text) {
+    return (u32) (u8) text[0] | ((u32) (u8) text[1] << 8) | ((u32) (u8) text[2] << 16);
+}
+
+static inline u64 make_character_mask(const char* text, u32 text_length) {
+    u64 mask = 0;
+
+    for (u32 index = 0; index < text_length; index++) {
+        mask |= 1ull << ((u8) text[index] % 64);
+    }
+
+    return mask;
+}
+
+void search_fold_case(const char* text, u32 length, char* output) {
+    for (u32 index = 0; index < length; index++) {
+        u8 c = (u8) text[index];
+
+        if (c >= 'A' && c <= 'Z') {
+            output[index] = (char) (c + ('a' - 'A'));
+            continue;
+        }
+
+        output[index] = (char) c;
+
+        // Upper case Cyrillic is D0 80..AF, lower case is D0 B0..BF and D1 80..9F
+        if (c == 0xD0 && index + 1 < length) {
+            u8 next = (u8) text[index + 1];
+
+            if (next >= 0x90 && next <= 0x9F) {
+                output[index + 1] = (char) (next + 0x20);
+            } else if (next >= 0xA0 && next <= 0xAF) {
+                output[index] = (char) 0xD1;
+                output[index + 1] = (char) (next - 0x20);
+            } else if (next >= 0x80 && next <= 0x8F) {
+                output[index] = (char) 0xD1;
+                output[index + 1] = (char) (next + 0x10);
+            } else {
+                output[index + 1] = (char) next;
+            }
+
+            index++;
+        }
+    }
+}
+
+void trigram_index_init(Trigram_Index& index) {
+    index = {};
+
+    id_hash_map_init(&index.trigram_to_postings);
+}
+
+void trigram_index_destroy(Trigram_Index& index) {
+    for (u32 list_index = 0; list_index < index.postings.length; list_index++) {
+        if (index.postings[list_index].data) {
+            lazy_array_clear(index.postings[list_index]);
+        }
+    }
+
+    if (index.postings.data) lazy_array_clear(index.postings);
+    if (index.texts.data) lazy_array_clear(index.texts);
+    if (index.text_pool.data) lazy_array_clear(index.text_pool);
+
+    id_hash_map_destroy(&index.trigram_to_postings);
+}
+
+static Lazy_Array<u32, 4>* find_postings(Trigram_Index& index, u32 trigram) {
+    s32 list_index = id_hash_map_get(&index.trigram_to_postings, trigram, hash_id((s32) trigram));
+
+    if (list_index == -1) {
+        return NULL;
+    }
+
+    return &index.postings[list_index];
+}
+
+static void remove_document_postings(Trigram_Index& index, u32 document, const char* text, u32 text_length) {
+    for (u32 position = 0; position + 3 <= text_length; position++) {
+        Lazy_Array<u32, 4>* postings = find_postings(index, pack_trigram(text + position));
+
+        if (!postings) {
+            continue;
+        }
+
+        // Order doesn't matter, so swap with the last one. Repeated trigrams just won't find anything the second time
+        for (u32 posting_index = 0; posting_index < postings->length; posting_index++) {
+            if ((*postings)[posting_index] == document) {
+                (*postings)[posting_index] = (*postings)[postings->length - 1];
+                postings->length--;
+                break;
+            }
+        }
+    }
+}
+
+static void add_document_postings(Trigram_Index& index, u32 document, const char* text, u32 text_length) {
+    for (u32 position = 0; position + 3 <= text_length; position++) {
+        u32 trigram = pack_trigram(text + position);
+        u32 trigram_hash = hash_id((s32) trigram);
+        s32 list_index = id_hash_map_get(&index.trigram_to_postings, trigram, trigram_hash);
+
+        if (list_index == -1) {
+            list_index = (s32) index.postings.length;
+
+            *lazy_array_add_n_values(index.postings, 1) = {};
+
+            id_hash_map_put(&index.trigram_to_postings, list_index, trigram, trigram_hash);
+        }
+
+        Lazy_Array<u32, 4>& postings = index.postings[list_index];
+
+        // All trigrams of a document are added together, so a repeated one would be the last posting
+        if (postings.length && postings[postings.length - 1] == document) {
+            continue;
+        }
+
+        *lazy_array_add_n_values(postings, 1) = document;
+    }
+}
+
+// Live texts are copied into a new pool in document order, so the copy only costs as much as the dead bytes did
+static void compact_text_pool(Trigram_Index& index) {
+    Lazy_Array<char, 4096> compacted{};
+
+    lazy_array_reserve_n_values(compacted, index.text_pool.length - index.dead_text_bytes);
+
+    for (u32 document = 0; document < index.texts.length; document++) {
+        Indexed_Text* indexed_text = &index.texts[document];
+
+        if (!indexed_text->length) {
+            continue;
+        }
+
+        char* text = lazy_array_add_n_values(compacted, indexed_text->length);
+
+        memcpy(text, index.text_pool.data + indexed_text->offset, indexed_text->length);
+
+        indexed_text->offset = (u32) (text - compacted.data);
+    }
+
+    if (index.text_pool.data) {
+        lazy_array_clear(index.text_pool);
+    }
+
+    index.text_pool = compacted;
+    index.dead_text_bytes = 0;
+}
+
+void trigram_index_set(Trigram_Index& index, u32 document, const char* text, u32 text_length) {
+    if (document >= index.texts.length) {
+        u32 num_new_texts = document + 1 - index.texts.length;
+        Indexed_Text* new_texts = lazy_array_add_n_values(index.texts, num_new_texts);
+
+        memset(new_texts, 0, sizeof(Indexed_Text) * num_new_texts);
+    }
+
+    Indexed_Text* indexed_text = &index.texts[document];
+    char* old_text = index.text_pool.data + indexed_text->offset;
+
+    // Nodes are usually refreshed with the same name
+    if (indexed_text->length == text_length && text_length && text_length <= max_stack_query_length) {
+        char folded[max_stack_query_length];
+
+        search_fold_case(text, text_length, folded);
+
+        if (memcmp(folded, old_text, text_length) == 0) {
+            return;
+        }
+    }
+
+    remove_document_postings(index, document, old_text, indexed_text->length);
+
+    index.dead_text_bytes += indexed_text->length;
+    indexed_text->length = 0;
+
+    if (index.dead_text_bytes >= min_dead_text_bytes_to_compact && index.dead_text_bytes * 2 >= index.text_pool.length) {
+        compact_text_pool(index);
+    }
+
+    indexed_text->offset = index.text_pool.length;
+    indexed_text->length = text_length;
+    indexed_text->character_mask = 0;
+
+    if (!text_length) {
+        return;
+    }
+
+    char* folded = lazy_array_add_n_values(index.text_pool, text_length);
+
+    search_fold_case(text, text_length, folded);
+    add_document_postings(index, document, folded, text_length);
+
+    indexed_text->character_mask = make_character_mask(folded, text_length);
+}
+
+static inline bool is_word_start(const char* text, u32 position) {
+    if (position == 0) {
+        return true;
+    }
+
+    u8 previous = (u8) text[position - 1];
+
+    // UTF-8 lead and continuation bytes are letters as far as we are concerned
+    return previous < 0x80 && !isalnum(previous);
+}
+
+static inline u32 make_score(u32 tier, u32 text_length) {
+    return 1 + ((tier << 16) | (0xFFFF - MIN(text_length, 0xFFFF)));
+}
+
+// 0 if the text doesn't contain the query or can't score above minimum_score
+static u32 score_match(const char* text, u32 text_length, const char* query, u32 query_length, u32 minimum_score) {
+    if (query_length > text_length) {
+        return 0;
+    }
+
+    if (memcmp(text, query, query_length) == 0) {
+        return make_score(query_length == text_length ? 3 : 2, text_length);
+    }
+
+    // Once the results are full of prefix matches there is no need to look inside the text
+    if (make_score(1, text_length) < minimum_score) {
+        return 0;
+    }
+
+    u32 tier = 0;
+    bool found = false;
+
+    for (u32 position = 1; position + query_length <= text_length; position++) {
+        const char* candidate = (const char*) memchr(text + position, query[0], text_length - query_length + 1 - position);
+
+        if (!candidate) {
+            break;
+        }
+
+        position = (u32) (candidate - text);
+
+        if (memcmp(candidate, query, query_length) != 0) {
+            continue;
+        }
+
+        found = true;
+
+        if (is_word_start(text, position)) {
+            tier = 1;
+            break;
+        }
+    }
+
+    if (!found) {
+        return 0;
+    }
+
+    return make_score(tier, text_length);
+}
+
+static inline bool is_better_match(Search_Match& a, Search_Match& b) {
+    return a.score > b.score || (a.score == b.score && a.document < b.document);
+}
+
+// Min heap with the worst match on top, so it can be replaced when something better comes in
+static void push_match(Search_Results& results, Search_Match match) {
+    Search_Match* heap = results.matches;
+
+    if (results.length == results.capacity) {
+        if (!is_better_match(match, heap[0])) {
+            return;
+        }
+
+        u32 parent = 0;
+
+        while (true) {
+            u32 worst = parent;
+            Search_Match* worst_match = &match;
+            u32 left = parent * 2 + 1;
+            u32 right = left + 1;
+
+            if (left < results.length && is_better_match(*worst_match, heap[left])) {
+                worst = left;
+                worst_match = &heap[left];
+            }
+
+            if (right < results.length && is_better_match(*worst_match, heap[right])) {
+                worst = right;
+                worst_match = &heap[right];
+            }
+
+            if (worst == parent) {
+                break;
+            }
+
+            heap[parent] = heap[worst];
+            parent = worst;
+        }
+
+        heap[parent] = match;
+
+        return;
+    }
+
+    u32 child = results.length++;
+
+    while (child > 0) {
+        u32 parent = (child - 1) / 2;
+
+        if (!is_better_match(heap[parent], match)) {
+            break;
+        }
+
+        heap[child] = heap[parent];
+        child = parent;
+    }
+
+    heap[child] = match;
+}
+
+static int compare_search_matches(const void* a, const void* b) {
+    Search_Match* match_a = (Search_Match*) a;
+    Search_Match* match_b = (Search_Match*) b;
+
+    if (is_better_match(*match_a, *match_b)) return -1;
+    if (is_better_match(*match_b, *match_a)) return 1;
+
+    return 0;
+}
+
+static void try_match_document(Trigram_Index& index, u32 document, const char* query, u32 query_length, Search_Results& results) {
+    Indexed_Text& text = index.texts[document];
+    u32 minimum_score = results.length == results.capacity ? results.matches[0].score : 0;
+    u32 score = score_match(index.text_pool.data + text.offset, text.length, query, query_length, minimum_score);
+
+    if (score) {
+        push_match(results, { score, document });
+    }
+}
+
+static void prepare_results(Search_Results& results, u32 max_results) {
+    results.length = 0;
+
+    if (results.capacity < max_results) {
+        results.matches = (Search_Match*) REALLOC(results.matches, sizeof(Search_Match) * max_results);
+    }
+
+    results.capacity = max_results;
+}
+
+void trigram_index_search(Trigram_Index& index, const char* query, u32 query_length, u32 max_results, Search_Results& results) {
+    prepare_results(results, max_results);
+
+    if (!query_length || !max_results) {
+        return;
+    }
+
+    query_length = MIN(query_length, max_stack_query_length);
+
+    char folded_query[max_stack_query_length];
+
+    search_fold_case(query, query_length, folded_query);
+
+    if (query_length < 3) {
+        // Nothing to look up, but texts are short and live in one block, so this is still fast
+        for (u32 document = 0; document < index.texts.length; document++) {
+            try_match_document(index, document, folded_query, query_length, results);
+        }
+    } else {
+        Lazy_Array<u32, 4>* shortest_postings = NULL;
+
+        for (u32 position = 0; position + 3 <= query_length; position++) {
+            Lazy_Array<u32, 4>* postings = find_postings(index, pack_trigram(folded_query + position));
+
+            if (!postings || !postings->length) {
+                return;
+            }
+
+            if (!shortest_postings || postings->length < shortest_postings->length) {
+                shortest_postings = postings;
+            }
+        }
+
+        for (u32 posting_index = 0; posting_index < shortest_postings->length; posting_index++) {
+            try_match_document(index, (*shortest_postings)[posting_index], folded_query, query_length, results);
+        }
+    }
+
+    qsort(results.matches, results.length, sizeof(Search_Match), compare_search_matches);
+}
+
+static u32 max_typos_for_query(u32 query_length) {
+    if (query_length < 4) return 0;
+    if (query_length < 8) return 1;
+    if (query_length < 12) return 2;
+
+    return 3;
+}
+
+struct Fuzzy_Query {
+    const char* query;
+    u32 query_length;
+    u32 max_typos;
+    u64 character_mask;
+    u64 equalities[256 * MYERS_NUM_BLOCKS(max_stack_query_length)];
+};
+
+static void try_fuzzy_match_document(Trigram_Index& index, u32 document, Fuzzy_Query& fuzzy_query, Search_Results& results) {
+    Indexed_Text& text = index.texts[document];
+    const char* text_start = index.text_pool.data + text.offset;
+
+    if (!text.length) {
+        return;
+    }
+
+    // Every query character missing from the text takes a typo to produce, colliding bits only let more through
+    if ((u32) __builtin_popcountll(fuzzy_query.character_mask & ~text.character_mask) > fuzzy_query.max_typos) {
+        return;
+    }
+
+    u32 typos = myers_edit_distance_with_equalities(fuzzy_query.equalities, fuzzy_query.query_length, text_start, text.length, true);
+
+    if (typos > fuzzy_query.max_typos) {
+        return;
+    }
+
+    // Fewer typos always win, exact matches are ranked as usual
+    u32 score = typos ? make_score(0, text.length) : score_match(text_start, text.length, fuzzy_query.query, fuzzy_query.query_length, 0);
+
+    push_match(results, { ((fuzzy_query.max_typos - typos) << 20) + score, document });
+}
+
+void trigram_index_fuzzy_search(Trigram_Index& index, const char* query, u32 query_length, u32 max_results, Search_Results& results) {
+    query_length = MIN(query_length, max_stack_query_length);
+
+    u32 max_typos = max_typos_for_query(query_length);
+
+    if (!max_typos) {
+        trigram_index_search(index, query, query_length, max_results, results);
+        return;
+    }
+
+    prepare_results(results, max_results);
+
+    if (!max_results) {
+        return;
+    }
+
+    char folded_query[max_stack_query_length];
+
+    search_fold_case(query, query_length, folded_query);
+
+    Fuzzy_Query fuzzy_query;
+    fuzzy_query.query = folded_query;
+    fuzzy_query.query_length = query_length;
+    fuzzy_query.max_typos = max_typos;
+    fuzzy_query.character_mask = make_character_mask(folded_query, query_length);
+
+    myers_build_equalities(folded_query, query_length, fuzzy_query.equalities);
+
+    // Every typo breaks at most 3 of the query trigrams, so a match shares at least this many with the text
+    s32 min_shared_trigrams = (s32) (query_length - 2) - (s32) (max_typos * 3);
+
+    if (min_shared_trigrams <= 0) {
+        for (u32 document = 0; document < index.texts.length; document++) {
+            try_fuzzy_match_document(index, document, fuzzy_query, results);
+        }
+    } else {
+        u16* shared_trigrams = (u16*) CALLOC(MAX(1, index.texts.length), sizeof(u16));
+
+        for (u32 position = 0; position + 3 <= query_length; position++) {
+            Lazy_Array<u32, 4>* postings = find_postings(index, pack_trigram(folded_query + position));
+
+            if (!postings) {
+                continue;
+            }
+
+            for (u32 posting_index = 0; posting_index < postings->length; posting_index++) {
+                u32 document = (*postings)[posting_index];
+
+                // Verified once, exactly when it reaches the bound
+                if (++shared_trigrams[document] == min_shared_trigrams) {
+                    try_fuzzy_match_document(index, document, fuzzy_query, results);
+                }
+            }
+        }
+
+        FREE(shared_trigrams);
+    }
+
+    qsort(results.matches, results.length, sizeof(Search_Match), compare_search_matches);
+}
+
+static bool text_contains(const char* text, u32 text_length, const char* query, u32 query_length) {
+    for (u32 position = 0; position + query_length <= text_length; position++) {
+        const char* candidate = (const char*) memchr(text + position, query[0], text_length - query_length + 1 - position);
+
+        if (!candidate) {
+            return false;
+        }
+
+        if (memcmp(candidate, query, query_length) == 0) {
+            return true;
+        }
+
+        position = (u32) (candidate - text);
+    }
+
+    return false;
+}
+
+static inline void try_match_all_document(Trigram_Index& index, u32 document, const char* query, u32 query_length, u64 query_mask, u64* documents) {
+    Indexed_Text& text = index.texts[document];
+
+    if ((text.character_mask & query_mask) != query_mask) {
+        return;
+    }
+
+    if (text_contains(index.text_pool.data + text.offset, text.length, query, query_length)) {
+        documents[document / 64] |= 1ull << (document % 64);
+    }
+}
+
+void trigram_index_match_all(Trigram_Index& index, const char* query, u32 query_length, u64* documents) {
+    if (!query_length) {
+        return;
+    }
+
+    query_length = MIN(query_length, max_stack_query_length);
+
+    char folded_query[max_stack_query_length];
+
+    search_fold_case(query, query_length, folded_query);
+
+    u64 query_mask = make_character_mask(folded_query, query_length);
+
+    if (query_length < 3) {
+        for (u32 document = 0; document < index.texts.length; document++) {
+            try_match_all_document(index, document, folded_query, query_length, query_mask, documents);
+        }
+
+        return;
+    }
+
+    Lazy_Array<u32, 4>* shortest_postings = NULL;
+
+    for (u32 position = 0; position + 3 <= query_length; position++) {
+        Lazy_Array<u32, 4>* postings = find_postings(index, pack_trigram(folded_query + position));
+
+        if (!postings || !postings->length) {
+            return;
+        }
+
+        if (!shortest_postings || postings->length < shortest_postings->length) {
+            shortest_postings = postings;
+        }
+    }
+
+    for (u32 posting_index = 0; posting_index < shortest_postings->length; posting_index++) {
+        try_match_all_document(index, (*shortest_postings)[posting_index], folded_query, query_length, query_mask, documents);
+    }
+}
+
+void search_results_free(Search_Results& results) {
+    if (results.matches) {
+        FREE(results.matches);
+    }
+
+    results = {};
+}
+
+#if BENCHMARK
+void search_benchmark() {
+    static const char* words[] = {
+            "Marketing", "Product", "Design", "Engineering", "Sales", "Q3", "Roadmap", "Backlog",
+            "Research", "Support", "Launch", "Website", "Mobile", "Campaign", "Archive", "Отдел", "Проекты"
+    };
+
+    const u32 num_names = 50000;
+    const u32 max_results = 256;
+
+    Trigram_Index index;
+    trigram_index_init(index);
+
+    char* names = (char*) malloc(num_names * 64);
+    u32* name_lengths = (u32*) malloc(sizeof(u32) * num_names);
+
+    srand(3637);
+
+    for (u32 name_index = 0; name_index < num_names; name_index++) {
+        char* name = names + name_index * 64;
+
+        name_lengths[name_index] = (u32) snprintf(name, 64, "%s %s %u",
+                                                  words[rand() % ARRAY_SIZE(words)],
+                                                  words[rand() % ARRAY_SIZE(words)],
+                                                  (u32) rand() % 10000);
+    }
+
+    u64 start = platform_get_app_time_precise();
+
+    for (u32 name_index = 0; name_index < num_names; name_index++) {
+        trigram_index_set(index, name_index, names + name_index * 64, name_lengths[name_index]);
+    }
+
+    printf("Indexed %u names in %.3fms\n", num_names, platform_get_delta_time_ms(start));
+
+    static const char* queries[] = { "m", "ro", "mark", "design 12", "отдел", "ПРОЕКТЫ 5", "nothing" };
+
+    Search_Results results{};
+
+    for (u32 query_index = 0; query_index < ARRAY_SIZE(queries); query_index++) {
+        const char* query = queries[query_index];
+
+        start = platform_get_app_time_precise();
+
+        trigram_index_search(index, query, (u32) strlen(query), max_results, results);
+
+        printf("Search for '%s': %u results in %.3fms, best '%.*s'\n", query, results.length, platform_get_delta_time_ms(start),
+               results.length ? (int) name_lengths[results.matches[0].document] : 0,
+               results.length ? names + results.matches[0].document * 64 : "");
+    }
+
+    static const char* fuzzy_queries[] = { "markting", "dsign", "enginering q3", "roadmpa backlgo" };
+
+    for (u32 query_index = 0; query_index < ARRAY_SIZE(fuzzy_queries); query_index++) {
+        const char* query = fuzzy_queries[query_index];
+
+        start = platform_get_app_time_precise();
+
+        trigram_index_fuzzy_search(index, query, (u32) strlen(query), max_results, results);
+
+        printf("Fuzzy search for '%s': %u results in %.3fms, best '%.*s'\n", query, results.length, platform_get_delta_time_ms(start),
+               results.length ? (int) name_lengths[results.matches[0].document] : 0,
+               results.length ? names + results.matches[0].document * 64 : "");
+    }
+
+    search_results_free(results);
+    trigram_index_destroy(index);
+
+    free(names);
+    free(name_lengths);
+}
+#endif
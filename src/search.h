@@ -0,0 +1,57 @@
+#pragma once
+
+#include "common.h"
+#include "lazy_array.h"
+#include "id_hash_map.h"
+
+// Case folded trigram index over short texts (folder names, task titles, user names).
+// Documents are dense u32 ids chosen by the caller, usually an index into the array of the things being indexed.
+// Every trigram maps to an unordered list of documents containing it, a query walks the shortest list of its
+//  trigrams and verifies every candidate against the folded text kept in the index.
+struct Indexed_Text {
+    u32 offset;
+    u32 length;
+    u64 character_mask; // Bit (c % 64) is set for every folded byte c
+};
+
+struct Trigram_Index {
+    Id_Hash_Map<u32, s32, -1> trigram_to_postings{};
+    Lazy_Array<Lazy_Array<u32, 4>, 256> postings{};
+    Lazy_Array<Indexed_Text, 256> texts{};
+    // Replaced texts stay in the pool as dead bytes until they make up half of it, then live texts are compacted
+    Lazy_Array<char, 4096> text_pool{};
+    u32 dead_text_bytes = 0;
+};
+
+struct Search_Match {
+    u32 score;
+    u32 document;
+};
+
+// Best matches first, ties are broken by the document id
+struct Search_Results {
+    Search_Match* matches = NULL;
+    u32 length = 0;
+    u32 capacity = 0;
+};
+
+void trigram_index_init(Trigram_Index& index);
+void trigram_index_destroy(Trigram_Index& index);
+// Replaces the text of the document, an empty text removes it from the results
+void trigram_index_set(Trigram_Index& index, u32 document, const char* text, u32 text_length);
+// Keeps up to max_results best matches: whole text > prefix > word start > anywhere, shorter texts first
+void trigram_index_search(Trigram_Index& index, const char* query, u32 query_length, u32 max_results, Search_Results& results);
+// Tolerates typos, up to 3 for long queries. Candidates share enough trigrams with the query (q-gram lemma)
+//  and are then verified with a bit parallel edit distance against the best matching part of the text
+void trigram_index_fuzzy_search(Trigram_Index& index, const char* query, u32 query_length, u32 max_results, Search_Results& results);
+// Sets bit (document % 64) of documents[document / 64] for every document containing the query, without scoring
+void trigram_index_match_all(Trigram_Index& index, const char* query, u32 query_length, u64* documents);
+void search_results_free(Search_Results& results);
+
+// Lowercases ASCII and Cyrillic without changing the byte length, output has to fit length bytes
+void search_fold_case(const char* text, u32 length, char* output);
+
+#if BENCHMARK
+// Indexes and queries synthetic folder names, prints the timings
+void search_benchmark();
+#endif
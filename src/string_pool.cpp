@@ -0,0 +1,56 @@
+#include "string_pool.h"
+#include "arena.h"
+#include "lazy_array.h"
+#include "id_hash_map.h"
+
+static Arena string_pool_arena{};
+
+// Strings with the same hash are chained, the map points to the one interned last
+struct Interned_String {
+    String string;
+    s32 next_with_same_hash; // -1 ends the chain
+};
+
+static Id_Hash_Map<u32, s32, -1> hash_to_interned_string{};
+static Lazy_Array<Interned_String, 1024> interned_strings{};
+
+static String_Pool_Stats string_pool_stats{};
+
+String intern_string(String string) {
+    if (!string.length) {
+        return {};
+    }
+
+    if (!hash_to_interned_string.capacity) {
+        id_hash_map_init(&hash_to_interned_string);
+    }
+
+    u32 hash = hash_string(string);
+    s32 first_with_same_hash = id_hash_map_get(&hash_to_interned_string, hash, hash);
+
+    for (s32 string_index = first_with_same_hash; string_index != -1; string_index = interned_strings[string_index].next_with_same_hash) {
+        if (are_strings_equal(interned_strings[string_index].string, string)) {
+            string_pool_stats.bytes_deduplicated += string.length;
+
+            return interned_strings[string_index].string;
+        }
+    }
+
+    s32 string_index = (s32) interned_strings.length;
+
+    Interned_String* interned = lazy_array_add_n_values(interned_strings, 1);
+    interned->string = arena_copy_string(string_pool_arena, string);
+    interned->next_with_same_hash = first_with_same_hash;
+
+    id_hash_map_put(&hash_to_interned_string, string_index, hash, hash);
+
+    string_pool_stats.num_strings++;
+    string_pool_stats.bytes_stored += string.length;
+    string_pool_stats.bytes_reserved = string_pool_arena.bytes_reserved;
+
+    return interned->string;
+}
+
+String_Pool_Stats get_string_pool_stats() {
+    return string_pool_stats;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "common.h"
+
+// Copies of entity strings (names, titles, avatar urls) which outlive the responses they were parsed from.
+// Entities are reloaded with the same strings all the time, so equal strings share one copy and nothing is ever released.
+// The pool grows with every distinct string seen during the session, renamed entities keep their old name around.
+//  That is bounded by the names of the account's folders, users, workflows and fields plus the renames, which is
+//  small next to a single folder response. The DEBUG_MEMORY window shows the totals.
+// Main thread only, workers keep pointing into the response until the parsed entities are published
+
+struct String_Pool_Stats {
+    u32 num_strings;
+    u32 bytes_stored;
+    u32 bytes_reserved;
+    u64 bytes_deduplicated;
+};
+
+String intern_string(String string);
+String_Pool_Stats get_string_pool_stats();
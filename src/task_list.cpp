@@ -12,6 +12,11 @@
 #include "task_view.h"
 #include "ui.h"
 #include "custom_fields.h"
+#include "bitmap_index.h"
+#include "search.h"
+#include "glyph_cache.h"
+#include "arena.h"
+#include "string_pool.h"
 
 #define IMGUI_DEFINE_MATH_OPERATORS
 #include <imgui_internal.h>
@@ -31,18 +36,23 @@ struct Folder_Task {
 
     Status_Group status_group;
 
+    // Strings and arrays live in the arena of the folder contents
     String title;
-    Relative_Pointer<Custom_Field_Value> custom_field_values;
+    Custom_Field_Value* custom_field_values;
     u32 num_custom_field_values;
 
-    Relative_Pointer<Folder_Id> parent_folder_ids;
+    Folder_Id* parent_folder_ids;
     u32 num_parent_folder_ids;
 
-    Relative_Pointer<Task_Id> parent_task_ids;
+    Task_Id* parent_task_ids;
     u32 num_parent_task_ids;
 
-    Relative_Pointer<User_Id> assignees;
+    User_Id* assignees;
     u32 num_assignees;
+
+    // Joined full names, built once every assignee is loaded
+    String assignee_names;
+    u32 assignees_loaded_at;
 };
 
 struct Folder_Header {
@@ -55,398 +65,1850 @@ struct Sorted_Folder_Task {
     Task_Id id;
     u32 id_hash;
 
-    Folder_Task* source_task;
-    Custom_Status* cached_status;
-    User_Handle cached_first_assignee;
-    Sorted_Folder_Task** sub_tasks; // TODO Array<Sorted_Folder_Task*>
-    u32 num_sub_tasks;
+    Folder_Task* source_task;
+    Custom_Status* cached_status;
+    User_Handle cached_first_assignee;
+    u64 sort_key;
+    Sorted_Folder_Task** sub_tasks; // TODO Array<Sorted_Folder_Task*>
+    u32 num_sub_tasks;
+
+    bool is_expanded;
+};
+
+struct Flattened_Folder_Task {
+    Sorted_Folder_Task* sorted_task;
+    u32 nesting_level;
+    u32 num_visible_sub_tasks;
+
+    bool needs_sub_task_sort;
+};
+
+// Rows of the flattened tree are split into chunks, so expanding or collapsing a task only moves rows
+//  inside the chunk it is in and inserts or removes whole chunks, instead of rebuilding every row
+static const u32 max_flattened_chunk_rows = 1024;
+static const u32 flattened_chunk_rows_after_rebuild = 768;
+
+struct Flattened_Task_Chunk {
+    Flattened_Folder_Task* rows; // Always max_flattened_chunk_rows allocated
+    u32 length;
+};
+
+struct Flattened_Task_Tree {
+    Flattened_Task_Chunk* chunks;
+    u32* chunk_first_row;
+    u32 num_chunks;
+    u32 chunks_capacity;
+    u32 length;
+};
+
+// Values of a single custom field for every task of the folder, indexed the same way as folder_tasks.
+// Raw values are parsed once when the column is first needed, drawing and sorting only read the columns
+struct Custom_Field_Column {
+    Custom_Field_Id field_id;
+    Custom_Field_Type type; // Values were parsed as this type, None until the field info arrives
+
+    u64* presence; // Bit per task
+    String* values; // As received, for drawing
+    double* numbers; // Numeric, currency, percentage and duration fields
+    u32* text_ids; // Every other type, index into texts
+
+    Array<String> texts; // Distinct values
+    u32* text_ranks; // Position of every distinct value when sorted ignoring case
+};
+
+struct Table_Paint_Context {
+    ImDrawList* draw_list;
+    Custom_Field** column_to_custom_field;
+    Custom_Field_Column** column_to_values;
+    u32 total_columns;
+    float row_height;
+    float scale;
+    float text_padding_y;
+};
+
+typedef int (Comparator)(const void*, const void*);
+
+static const u32 custom_columns_start_index = 3;
+
+// Everything parsed out of a single folder contents response.
+// Built off the main thread by build_folder_contents, then published with a pointer swap,
+//  so the task list keeps showing the previous folder until the new one is fully ready.
+// The contents, tasks and strings copied out of the response are allocated in the arena, which is released at once.
+// Hash maps, filter indexes and custom field columns manage their own memory
+struct Folder_Contents {
+    Arena arena;
+
+    Folder_Id folder_id;
+
+    Array<Folder_Task> folder_tasks;
+    Sorted_Folder_Task* sorted_folder_tasks;
+    Lazy_Array<Sorted_Folder_Task*, 32> top_level_tasks;
+
+    Id_Hash_Map<Task_Id, Sorted_Folder_Task*> id_to_sorted_folder_task;
+
+    Sorted_Folder_Task** sub_tasks;
+
+    Lazy_Array<Custom_Field_Column*, 8> custom_field_columns;
+
+    // Tasks with every status group, status and assignee, for filtering
+    Value_Bitmap_Index status_group_index;
+    Value_Bitmap_Index status_index;
+    Value_Bitmap_Index assignee_index;
+
+    // Parents of task i are parent_task_indices[parent_task_offsets[i]..parent_task_offsets[i + 1]]
+    u32* parent_task_offsets;
+    u32* parent_task_indices;
+
+    u64* visible_tasks; // Bit per task, tasks matching the filter and their parents
+    u64* filter_scratch; // Two bitmaps
+
+    Trigram_Index title_index; // Documents are task indices
+};
+
+struct Custom_Field_Range {
+    Custom_Field_Id field_id;
+    Custom_Field_Type type; // Keys are only comparable while the column is parsed as the same type
+    u64 min_key;
+    u64 max_key;
+};
+
+// Tasks have to match every predicate with values, any of the values of a predicate
+struct Task_Filter {
+    u32 status_groups = 1 << Status_Group_Active; // Bit per Status_Group
+    Lazy_Array<Custom_Status_Id, 4> status_ids;
+    Lazy_Array<User_Id, 4> assignees;
+    Lazy_Array<Custom_Field_Range, 4> custom_field_ranges;
+};
+
+static Folder_Header current_folder{};
+
+static Folder_Contents empty_folder_contents{};
+static Folder_Contents* folder_contents = &empty_folder_contents;
+
+static Flattened_Task_Tree flattened_sorted_folder_task_tree{};
+
+// Full rebuilds and expanded subtrees are flattened here first, then copied into the tree
+static Array<Flattened_Folder_Task> flattened_rows_scratch{};
+static Flattened_Folder_Task flattened_chunk_tail[max_flattened_chunk_rows];
+
+typedef char Sort_Direction;
+static const Sort_Direction Sort_Direction_Normal = 1;
+static const Sort_Direction Sort_Direction_Reverse = -1;
+
+static Task_List_Sort_Field sort_field = Task_List_Sort_Field_None;
+static Custom_Field_Id sort_custom_field_id{};
+static Custom_Field_Column* sort_custom_field_column;
+static Sort_Direction sort_direction = Sort_Direction_Normal;
+static bool has_been_sorted_after_loading = false;
+static Task_Filter task_filter{};
+static char task_search_buffer[128];
+static bool queued_filter_update = false;
+static Flattened_Folder_Task* queued_expand_toggle = NULL;
+
+// Every sort first computes a u64 key per task for the current column, then radix sorts (key, task id) pairs.
+// Status, assignee and custom field keys are exact. Title keys are case folded 8 byte prefixes, runs of tasks
+//  sharing a prefix are re-keyed with the following 8 bytes, short runs are compared as whole strings.
+struct Task_Sort_Entry {
+    u64 key;
+    u32 id_key;
+    u32 index;
+};
+
+struct User_Name_Rank_Entry {
+    String name;
+    u32 user_index;
+};
+
+static const u64 missing_value_sort_key = UINT64_MAX;
+static const u32 max_text_sort_key_offset = 32;
+static const u32 min_radix_sorted_entries = 64;
+
+// Lists at least this long are sorted and flattened on all cores
+static const u32 min_parallel_task_list_length = 16384;
+static const u32 max_parallel_sort_chunks = 16;
+static const u32 max_parallel_flatten_chunks = 64;
+
+// Only turned off by the benchmark to compare against a single thread
+static bool parallel_task_list_enabled = true;
+
+static Task_Sort_Entry* task_sort_entries = NULL;
+static Task_Sort_Entry* task_sort_scratch = NULL;
+static Sorted_Folder_Task** task_sort_tasks_scratch = NULL;
+static u32 task_sort_capacity = 0;
+
+// Position of every user when all users are sorted by full name, indexed by the user handle
+static u32* user_name_ranks = NULL;
+static u32 user_name_ranks_capacity = 0;
+static u32 num_ranked_users = 0; // Users loaded later have no rank yet
+
+static inline u8 fold_ascii_case(char c) {
+    return (u8) (c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c);
+}
+
+// Flips the sign bit so signed values compare correctly as unsigned
+static inline u32 signed_to_sort_key(s32 value) {
+    return ((u32) value) ^ 0x80000000u;
+}
+
+static inline int compare_strings_ignoring_ascii_case(String* a, String* b) {
+    u32 length = MIN(a->length, b->length);
+
+    for (u32 index = 0; index < length; index++) {
+        int difference = (int) fold_ascii_case(a->start[index]) - (int) fold_ascii_case(b->start[index]);
+
+        if (difference) {
+            return difference;
+        }
+    }
+
+    return (int) a->length - (int) b->length;
+}
+
+// 8 case folded bytes starting at offset, most significant first so comparing keys compares the strings
+static inline u64 string_sort_key(String* string, u32 offset) {
+    u64 key = 0;
+
+    for (u32 index = offset; index < offset + 8; index++) {
+        key <<= 8;
+
+        if (index < string->length) {
+            key |= fold_ascii_case(string->start[index]);
+        }
+    }
+
+    return key;
+}
+
+static inline String* find_custom_field_value(Folder_Task* task, Custom_Field_Id field_id) {
+    for (u32 index = 0; index < task->num_custom_field_values; index++) {
+        if (task->custom_field_values[index].field_id == field_id) {
+            return &task->custom_field_values[index].value;
+        }
+    }
+
+    return NULL;
+}
+
+static inline bool is_custom_field_type_numeric(Custom_Field_Type type) {
+    return type == Custom_Field_Type_Numeric || type == Custom_Field_Type_Currency || type == Custom_Field_Type_Percentage || type == Custom_Field_Type_Duration;
+}
+
+static inline bool is_custom_field_value_present(Custom_Field_Column* column, u32 task_index) {
+    return (column->presence[task_index / 64] >> (task_index % 64)) & 1;
+}
+
+static double parse_custom_field_number(String* value) {
+    char buffer[64];
+    u32 length = MIN(value->length, sizeof(buffer) - 1);
+
+    memcpy(buffer, value->start, length);
+    buffer[length] = 0;
+
+    return strtod(buffer, NULL);
+}
+
+// Positive numbers get the sign bit set, negative ones are inverted so that larger magnitudes go first
+static inline u64 double_to_sort_key(double value) {
+    u64 bits;
+
+    memcpy(&bits, &value, sizeof(bits));
+
+    return bits & 0x8000000000000000ull ? ~bits : bits | 0x8000000000000000ull;
+}
+
+// Distinct texts are found through a throwaway open addressing table of text ids + 1
+static u32 intern_custom_field_text(Custom_Field_Column* column, u32* table, u32 table_mask, String* text) {
+    u32 hash = hash_string(*text);
+
+    for (u32 slot = hash & table_mask;; slot = (slot + 1) & table_mask) {
+        if (!table[slot]) {
+            u32 text_id = column->texts.length++;
+
+            column->texts[text_id] = *text;
+            table[slot] = text_id + 1;
+
+            return text_id;
+        }
+
+        String* existing = &column->texts[table[slot] - 1];
+
+        if (existing->length == text->length && memcmp(existing->start, text->start, text->length) == 0) {
+            return table[slot] - 1;
+        }
+    }
+}
+
+static void rank_custom_field_texts(Custom_Field_Column* column) {
+    u32 num_texts = column->texts.length;
+
+    column->text_ranks = (u32*) MALLOC(sizeof(u32) * MAX(num_texts, 1));
+
+    temporary_storage_mark();
+
+    u32* sorted_ids = (u32*) talloc(sizeof(u32) * num_texts);
+
+    for (u32 text_id = 0; text_id < num_texts; text_id++) {
+        sorted_ids[text_id] = text_id;
+    }
+
+    // Compared through a static since qsort has no context argument
+    static Custom_Field_Column* column_being_ranked;
+
+    column_being_ranked = column;
+
+    qsort(sorted_ids, num_texts, sizeof(u32), [](const void* ap, const void* bp) {
+        u32 a = *(u32*) ap;
+        u32 b = *(u32*) bp;
+
+        int result = compare_strings_ignoring_ascii_case(&column_being_ranked->texts[a], &column_being_ranked->texts[b]);
+
+        if (!result) {
+            return (int) a - (int) b;
+        }
+
+        return result;
+    });
+
+    for (u32 rank = 0; rank < num_texts; rank++) {
+        column->text_ranks[sorted_ids[rank]] = rank;
+    }
+
+    temporary_storage_reset();
+}
+
+static void build_custom_field_column(Custom_Field_Column* column, Custom_Field_Id field_id, Custom_Field_Type type) {
+    u32 num_tasks = folder_contents->folder_tasks.length;
+    u32 num_presence_words = (num_tasks + 63) / 64;
+    bool is_numeric = is_custom_field_type_numeric(type);
+
+    *column = {};
+    column->field_id = field_id;
+    column->type = type;
+    column->presence = (u64*) CALLOC(MAX(num_presence_words, 1), sizeof(u64));
+    column->values = (String*) MALLOC(sizeof(String) * MAX(num_tasks, 1));
+
+    u32* table = NULL;
+    u32 table_mask = 0;
+
+    if (is_numeric) {
+        column->numbers = (double*) MALLOC(sizeof(double) * MAX(num_tasks, 1));
+    } else {
+        column->text_ids = (u32*) MALLOC(sizeof(u32) * MAX(num_tasks, 1));
+        column->texts.data = (String*) MALLOC(sizeof(String) * MAX(num_tasks, 1));
+
+        u32 table_size = 16;
+
+        while (table_size < num_tasks * 2) {
+            table_size *= 2;
+        }
+
+        table = (u32*) CALLOC(table_size, sizeof(u32));
+        table_mask = table_size - 1;
+    }
+
+    for (u32 task_index = 0; task_index < num_tasks; task_index++) {
+        String* value = find_custom_field_value(&folder_contents->folder_tasks[task_index], field_id);
+
+        if (!value) {
+            continue;
+        }
+
+        column->presence[task_index / 64] |= 1ull << (task_index % 64);
+        column->values[task_index] = *value;
+
+        if (is_numeric) {
+            column->numbers[task_index] = parse_custom_field_number(value);
+        } else {
+            column->text_ids[task_index] = intern_custom_field_text(column, table, table_mask, value);
+        }
+    }
+
+    if (!is_numeric) {
+        FREE(table);
+
+        rank_custom_field_texts(column);
+    }
+}
+
+static void free_custom_field_column(Custom_Field_Column* column) {
+    FREE(column->presence);
+    FREE(column->values);
+
+    if (column->numbers) FREE(column->numbers);
+    if (column->text_ids) FREE(column->text_ids);
+    if (column->texts.data) FREE(column->texts.data);
+    if (column->text_ranks) FREE(column->text_ranks);
+}
+
+// Builds the column on first use and rebuilds it when the field type becomes known
+static Custom_Field_Column* get_custom_field_column(Custom_Field_Id field_id) {
+    Custom_Field* custom_field = find_custom_field_by_id(field_id, hash_id(field_id)); // TODO hash cache?
+    Custom_Field_Type type = custom_field ? custom_field->type : Custom_Field_Type_None;
+
+    Lazy_Array<Custom_Field_Column*, 8>& columns = folder_contents->custom_field_columns;
+
+    for (u32 index = 0; index < columns.length; index++) {
+        Custom_Field_Column* column = columns[index];
+
+        if (column->field_id == field_id) {
+            if (column->type != type) {
+                free_custom_field_column(column);
+                build_custom_field_column(column, field_id, type);
+            }
+
+            return column;
+        }
+    }
+
+    Custom_Field_Column* column = (Custom_Field_Column*) MALLOC(sizeof(Custom_Field_Column));
+
+    build_custom_field_column(column, field_id, type);
+
+    *lazy_array_add_n_values(columns, 1) = column;
+
+    return column;
+}
+
+// Orders values the same way as the field is sorted, the value has to be present
+static inline u64 get_custom_field_value_key(Custom_Field_Column* column, u32 task_index) {
+    if (is_custom_field_type_numeric(column->type)) {
+        return double_to_sort_key(column->numbers[task_index]);
+    }
+
+    return column->text_ranks[column->text_ids[task_index]];
+}
+
+// Only titles are sorted by text, custom fields use the ranks of their distinct values
+static inline bool is_current_sort_field_text() {
+    return sort_field == Task_List_Sort_Field_Title;
+}
+
+static inline String* get_sort_text(Sorted_Folder_Task* task) {
+    return &task->source_task->title;
+}
+
+static void rank_users_by_full_name() {
+    if (user_name_ranks_capacity < users.length) {
+        user_name_ranks_capacity = users.length;
+        user_name_ranks = (u32*) REALLOC(user_name_ranks, sizeof(u32) * user_name_ranks_capacity);
+    }
+
+    temporary_storage_mark();
+
+    User_Name_Rank_Entry* entries = (User_Name_Rank_Entry*) talloc(sizeof(User_Name_Rank_Entry) * users.length);
+
+    for (u32 index = 0; index < users.length; index++) {
+        entries[index].name = full_user_name_to_temporary_string(&users[index]);
+        entries[index].user_index = index;
+    }
+
+    qsort(entries, users.length, sizeof(User_Name_Rank_Entry), [](const void* ap, const void* bp) {
+        User_Name_Rank_Entry* a = (User_Name_Rank_Entry*) ap;
+        User_Name_Rank_Entry* b = (User_Name_Rank_Entry*) bp;
+
+        int result = compare_strings_ignoring_ascii_case(&a->name, &b->name);
+
+        if (!result) {
+            return (int) a->user_index - (int) b->user_index;
+        }
+
+        return result;
+    });
+
+    for (u32 rank = 0; rank < users.length; rank++) {
+        user_name_ranks[entries[rank].user_index] = rank;
+    }
+
+    num_ranked_users = users.length;
+
+    temporary_storage_reset();
+}
+
+static u64 compute_sort_key(Sorted_Folder_Task* task) {
+    Folder_Task* source = task->source_task;
+
+    switch (sort_field) {
+        case Task_List_Sort_Field_Title: {
+            return string_sort_key(&source->title, 0);
+        }
+
+        case Task_List_Sort_Field_Status: {
+            Custom_Status* status = task->cached_status;
+
+            if (!status) {
+                return missing_value_sort_key;
+            }
+
+            // TODO do status comparison based on status type?
+            return ((u64) status->natural_index << 32) | signed_to_sort_key(status->id);
+        }
+
+        case Task_List_Sort_Field_Assignee: {
+            if (task->cached_first_assignee == NULL_USER_HANDLE) {
+                return missing_value_sort_key;
+            }
+
+            return user_name_ranks[task->cached_first_assignee.value];
+        }
+
+        case Task_List_Sort_Field_Custom_Field: {
+            Custom_Field_Column* column = sort_custom_field_column;
+            u32 task_index = (u32) (task - folder_contents->sorted_folder_tasks);
+
+            if (!is_custom_field_value_present(column, task_index)) {
+                return missing_value_sort_key;
+            }
+
+            return get_custom_field_value_key(column, task_index);
+        }
+
+        default: {}
+    }
+
+    assert(!"Invalid sort field");
+
+    return 0;
+}
+
+static inline u32 task_sort_entry_byte(Task_Sort_Entry* entry, u32 pass) {
+    if (pass < 4) {
+        return (entry->id_key >> (pass * 8)) & 0xFF;
+    }
+
+    return (u32) (entry->key >> ((pass - 4) * 8)) & 0xFF;
+}
+
+// LSD radix sort by (key, id_key), all histograms are built in a single pass and passes
+//  where every entry has the same byte are skipped. Returns either entries or scratch
+static Task_Sort_Entry* radix_sort_task_sort_entries(Task_Sort_Entry* entries, Task_Sort_Entry* scratch, u32 length) {
+    const u32 num_passes = 12;
+
+    u32 counts[num_passes][256];
+
+    memset(counts, 0, sizeof(counts));
+
+    for (Task_Sort_Entry* entry = entries; entry != entries + length; entry++) {
+        for (u32 pass = 0; pass < num_passes; pass++) {
+            counts[pass][task_sort_entry_byte(entry, pass)]++;
+        }
+    }
+
+    for (u32 pass = 0; pass < num_passes; pass++) {
+        u32* pass_counts = counts[pass];
+
+        if (pass_counts[task_sort_entry_byte(entries, pass)] == length) {
+            continue;
+        }
+
+        u32 offset = 0;
+
+        for (u32 byte = 0; byte < 256; byte++) {
+            u32 count = pass_counts[byte];
+            pass_counts[byte] = offset;
+            offset += count;
+        }
+
+        for (Task_Sort_Entry* entry = entries; entry != entries + length; entry++) {
+            scratch[pass_counts[task_sort_entry_byte(entry, pass)]++] = *entry;
+        }
+
+        Task_Sort_Entry* sorted = scratch;
+        scratch = entries;
+        entries = sorted;
+    }
+
+    return entries;
+}
+
+static int compare_task_sort_entries(const void* ap, const void* bp) {
+    Task_Sort_Entry* a = (Task_Sort_Entry*) ap;
+    Task_Sort_Entry* b = (Task_Sort_Entry*) bp;
+
+    if (a->key != b->key) {
+        return a->key < b->key ? -1 : 1;
+    }
+
+    return (a->id_key > b->id_key) - (a->id_key < b->id_key);
+}
+
+// Only for entries with equal text keys, index points into task_sort_tasks_scratch
+static int compare_task_sort_entries_by_text(const void* ap, const void* bp) {
+    Task_Sort_Entry* a = (Task_Sort_Entry*) ap;
+    Task_Sort_Entry* b = (Task_Sort_Entry*) bp;
+
+    String* a_text = get_sort_text(task_sort_tasks_scratch[a->index]);
+    String* b_text = get_sort_text(task_sort_tasks_scratch[b->index]);
+
+    int result = compare_strings_ignoring_ascii_case(a_text, b_text) * sort_direction;
+
+    if (!result) {
+        return (a->id_key > b->id_key) - (a->id_key < b->id_key);
+    }
+
+    return result;
+}
+
+static Task_Sort_Entry* sort_task_sort_entries(Task_Sort_Entry* entries, Task_Sort_Entry* scratch, u32 length) {
+    // Histograms are not worth it for the usual handful of sub tasks
+    if (length < min_radix_sorted_entries) {
+        qsort(entries, length, sizeof(Task_Sort_Entry), compare_task_sort_entries);
+
+        return entries;
+    }
+
+    return radix_sort_task_sort_entries(entries, scratch, length);
+}
+
+// Entries are sorted by the text bytes before key_offset, sorts every run of equal keys by the rest of the text
+static void sort_runs_of_equal_text_keys(Task_Sort_Entry* entries, Task_Sort_Entry* scratch, u32 length, u32 key_offset, u64 key_mask) {
+    for (u32 run_start = 0; run_start < length;) {
+        u32 run_end = run_start + 1;
+
+        while (run_end < length && entries[run_end].key == entries[run_start].key) {
+            run_end++;
+        }
+
+        Task_Sort_Entry* run = entries + run_start;
+        u32 run_length = run_end - run_start;
+
+        run_start = run_end;
+
+        if (run_length == 1 || (run->key ^ key_mask) == missing_value_sort_key) {
+            continue;
+        }
+
+        if (run_length < min_radix_sorted_entries || key_offset >= max_text_sort_key_offset) {
+            qsort(run, run_length, sizeof(Task_Sort_Entry), compare_task_sort_entries_by_text);
+            continue;
+        }
+
+        bool has_longer_texts = false;
+
+        for (Task_Sort_Entry* entry = run; entry != run + run_length; entry++) {
+            String* text = get_sort_text(task_sort_tasks_scratch[entry->index]);
+
+            entry->key = string_sort_key(text, key_offset) ^ key_mask;
+            has_longer_texts |= text->length > key_offset;
+        }
+
+        // All texts fit into the previous key and are equal, so the run is already ordered by the task id
+        if (!has_longer_texts) {
+            continue;
+        }
+
+        Task_Sort_Entry* run_scratch = scratch + (run - entries);
+        Task_Sort_Entry* sorted_run = radix_sort_task_sort_entries(run, run_scratch, run_length);
+
+        if (sorted_run != run) {
+            memcpy(run, sorted_run, sizeof(Task_Sort_Entry) * run_length);
+        }
+
+        sort_runs_of_equal_text_keys(run, run_scratch, run_length, key_offset + 8, key_mask);
+    }
+}
+
+struct Parallel_Task_Sort {
+    Task_Sort_Entry* entries;
+    Task_Sort_Entry* scratch;
+    u32 length;
+    u32 num_chunks;
+    u32 chunks_per_run; // Chunks in every sorted run before the current merge round
+};
+
+static inline bool should_run_in_parallel(u32 length) {
+    return parallel_task_list_enabled && length >= min_parallel_task_list_length && platform_get_num_parallel_threads() > 1;
+}
+
+static inline u32 get_parallel_chunk_start(u32 length, u32 num_chunks, u32 chunk) {
+    return (u32) ((u64) length * MIN(chunk, num_chunks) / num_chunks);
+}
+
+static void sort_task_sort_entries_chunk(void* data, u32 chunk) {
+    Parallel_Task_Sort* sort = (Parallel_Task_Sort*) data;
+
+    u32 start = get_parallel_chunk_start(sort->length, sort->num_chunks, chunk);
+    u32 end = get_parallel_chunk_start(sort->length, sort->num_chunks, chunk + 1);
+
+    Task_Sort_Entry* chunk_entries = sort->entries + start;
+    Task_Sort_Entry* sorted = sort_task_sort_entries(chunk_entries, sort->scratch + start, end - start);
+
+    if (sorted != chunk_entries) {
+        memcpy(chunk_entries, sorted, sizeof(Task_Sort_Entry) * (end - start));
+    }
+}
+
+// Merges two neighbouring runs from entries into scratch, the last run of a round might not have a pair
+static void merge_task_sort_entry_runs(void* data, u32 merge_index) {
+    Parallel_Task_Sort* sort = (Parallel_Task_Sort*) data;
+
+    u32 first_chunk = merge_index * sort->chunks_per_run * 2;
+
+    Task_Sort_Entry* left = sort->entries + get_parallel_chunk_start(sort->length, sort->num_chunks, first_chunk);
+    Task_Sort_Entry* middle = sort->entries + get_parallel_chunk_start(sort->length, sort->num_chunks, first_chunk + sort->chunks_per_run);
+    Task_Sort_Entry* end = sort->entries + get_parallel_chunk_start(sort->length, sort->num_chunks, first_chunk + sort->chunks_per_run * 2);
+    Task_Sort_Entry* right = middle;
+    Task_Sort_Entry* output = sort->scratch + (left - sort->entries);
+
+    while (left != middle && right != end) {
+        if (compare_task_sort_entries(right, left) < 0) {
+            *output++ = *right++;
+        } else {
+            *output++ = *left++;
+        }
+    }
+
+    memcpy(output, left, sizeof(Task_Sort_Entry) * (middle - left));
+    output += middle - left;
+
+    memcpy(output, right, sizeof(Task_Sort_Entry) * (end - right));
+}
+
+// Sorts a chunk per thread, then merges pairs of runs in parallel until a single run is left.
+// Returns either entries or scratch
+static Task_Sort_Entry* parallel_sort_task_sort_entries(Task_Sort_Entry* entries, Task_Sort_Entry* scratch, u32 length) {
+    Parallel_Task_Sort sort;
+    sort.entries = entries;
+    sort.scratch = scratch;
+    sort.length = length;
+    sort.num_chunks = MIN(platform_get_num_parallel_threads(), max_parallel_sort_chunks);
+
+    platform_run_parallel(sort.num_chunks, sort_task_sort_entries_chunk, &sort);
+
+    for (sort.chunks_per_run = 1; sort.chunks_per_run < sort.num_chunks; sort.chunks_per_run *= 2) {
+        u32 chunks_per_merge = sort.chunks_per_run * 2;
+
+        platform_run_parallel((sort.num_chunks + chunks_per_merge - 1) / chunks_per_merge, merge_task_sort_entry_runs, &sort);
+
+        Task_Sort_Entry* merged = sort.scratch;
+        sort.scratch = sort.entries;
+        sort.entries = merged;
+    }
+
+    return sort.entries;
+}
+
+static void sort_tasks_by_precomputed_keys(Sorted_Folder_Task** tasks, u32 length) {
+    if (length < 2) {
+        return;
+    }
+
+    if (task_sort_capacity < length) {
+        task_sort_capacity = length;
+        task_sort_entries = (Task_Sort_Entry*) REALLOC(task_sort_entries, sizeof(Task_Sort_Entry) * length);
+        task_sort_scratch = (Task_Sort_Entry*) REALLOC(task_sort_scratch, sizeof(Task_Sort_Entry) * length);
+        task_sort_tasks_scratch = (Sorted_Folder_Task**) REALLOC(task_sort_tasks_scratch, sizeof(Sorted_Folder_Task*) * length);
+    }
+
+    // Reversing the order of keys and ids reverses the whole sort, tasks without a value included
+    u64 key_mask = sort_direction == Sort_Direction_Reverse ? UINT64_MAX : 0;
+    u32 id_mask = sort_direction == Sort_Direction_Reverse ? UINT32_MAX : 0;
+
+    for (u32 index = 0; index < length; index++) {
+        Task_Sort_Entry* entry = &task_sort_entries[index];
+
+        entry->key = tasks[index]->sort_key ^ key_mask;
+        entry->id_key = signed_to_sort_key(tasks[index]->id) ^ id_mask;
+        entry->index = index;
+    }
+
+    memcpy(task_sort_tasks_scratch, tasks, sizeof(Sorted_Folder_Task*) * length);
+
+    Task_Sort_Entry* sorted;
+
+    if (should_run_in_parallel(length)) {
+        sorted = parallel_sort_task_sort_entries(task_sort_entries, task_sort_scratch, length);
+    } else {
+        sorted = sort_task_sort_entries(task_sort_entries, task_sort_scratch, length);
+    }
+
+    Task_Sort_Entry* scratch = sorted == task_sort_entries ? task_sort_scratch : task_sort_entries;
+
+    if (is_current_sort_field_text()) {
+        sort_runs_of_equal_text_keys(sorted, scratch, length, 8, key_mask);
+    }
+
+    for (u32 index = 0; index < length; index++) {
+        tasks[index] = task_sort_tasks_scratch[sorted[index].index];
+    }
+}
+
+static Flattened_Task_Chunk allocate_flattened_task_chunk() {
+    Flattened_Task_Chunk chunk;
+    chunk.rows = (Flattened_Folder_Task*) MALLOC(sizeof(Flattened_Folder_Task) * max_flattened_chunk_rows);
+    chunk.length = 0;
+
+    return chunk;
+}
+
+static void flattened_task_tree_update_first_rows(Flattened_Task_Tree& tree, u32 from_chunk) {
+    u32 row = from_chunk ? tree.chunk_first_row[from_chunk - 1] + tree.chunks[from_chunk - 1].length : 0;
+
+    for (u32 chunk = from_chunk; chunk < tree.num_chunks; chunk++) {
+        tree.chunk_first_row[chunk] = row;
+        row += tree.chunks[chunk].length;
+    }
+
+    tree.length = row;
+}
+
+// Makes room for num_inserted chunks before the chunk at index, the new chunks are allocated and empty
+static void flattened_task_tree_insert_chunks(Flattened_Task_Tree& tree, u32 index, u32 num_inserted) {
+    if (tree.num_chunks + num_inserted > tree.chunks_capacity) {
+        tree.chunks_capacity = MAX(tree.chunks_capacity * 2, tree.num_chunks + num_inserted);
+        tree.chunks = (Flattened_Task_Chunk*) REALLOC(tree.chunks, sizeof(Flattened_Task_Chunk) * tree.chunks_capacity);
+        tree.chunk_first_row = (u32*) REALLOC(tree.chunk_first_row, sizeof(u32) * tree.chunks_capacity);
+    }
+
+    memmove(tree.chunks + index + num_inserted, tree.chunks + index, sizeof(Flattened_Task_Chunk) * (tree.num_chunks - index));
+
+    for (u32 chunk = index; chunk < index + num_inserted; chunk++) {
+        tree.chunks[chunk] = allocate_flattened_task_chunk();
+    }
+
+    tree.num_chunks += num_inserted;
+}
+
+static void flattened_task_tree_remove_chunk(Flattened_Task_Tree& tree, u32 index) {
+    FREE(tree.chunks[index].rows);
+
+    tree.num_chunks--;
+
+    memmove(tree.chunks + index, tree.chunks + index + 1, sizeof(Flattened_Task_Chunk) * (tree.num_chunks - index));
+}
+
+static void flattened_task_tree_free(Flattened_Task_Tree& tree) {
+    for (u32 chunk = 0; chunk < tree.num_chunks; chunk++) {
+        FREE(tree.chunks[chunk].rows);
+    }
+
+    if (tree.chunks) {
+        FREE(tree.chunks);
+        FREE(tree.chunk_first_row);
+    }
+
+    tree = {};
+}
+
+// Chunk holding the row, a row equal to the tree length maps past the end of the last chunk
+static u32 flattened_task_tree_find_chunk(Flattened_Task_Tree& tree, u32 row, u32* offset_in_chunk) {
+    u32 low = 0;
+    u32 high = tree.num_chunks - 1;
+
+    while (low < high) {
+        u32 middle = (low + high + 1) / 2;
+
+        if (tree.chunk_first_row[middle] <= row) {
+            low = middle;
+        } else {
+            high = middle - 1;
+        }
+    }
+
+    *offset_in_chunk = row - tree.chunk_first_row[low];
+
+    return low;
+}
+
+static inline Flattened_Folder_Task* get_flattened_task(u32 row) {
+    Flattened_Task_Tree& tree = flattened_sorted_folder_task_tree;
+
+    u32 offset;
+    u32 chunk = flattened_task_tree_find_chunk(tree, row, &offset);
+
+    return &tree.chunks[chunk].rows[offset];
+}
+
+// Copies rows starting at the given chunk and offset, moving on to the following chunks when one is full
+static void write_flattened_rows(Flattened_Task_Tree& tree, u32* chunk, u32* offset, u32 chunk_capacity, Flattened_Folder_Task* rows, u32 num_rows) {
+    while (num_rows) {
+        if (*offset == chunk_capacity) {
+            (*chunk)++;
+            *offset = 0;
+        }
+
+        Flattened_Task_Chunk* target = &tree.chunks[*chunk];
+
+        u32 num_copied = MIN(num_rows, chunk_capacity - *offset);
+
+        memcpy(target->rows + *offset, rows, sizeof(Flattened_Folder_Task) * num_copied);
+
+        *offset += num_copied;
+        target->length = MAX(target->length, *offset);
+
+        rows += num_copied;
+        num_rows -= num_copied;
+    }
+}
+
+// Replaces all rows, chunks are left partially empty so expanding a task rarely has to split them
+static void flattened_task_tree_assign(Flattened_Task_Tree& tree, Flattened_Folder_Task* rows, u32 num_rows) {
+    u32 num_chunks = (num_rows + flattened_chunk_rows_after_rebuild - 1) / flattened_chunk_rows_after_rebuild;
+
+    while (tree.num_chunks > num_chunks) {
+        flattened_task_tree_remove_chunk(tree, tree.num_chunks - 1);
+    }
+
+    if (tree.num_chunks < num_chunks) {
+        flattened_task_tree_insert_chunks(tree, tree.num_chunks, num_chunks - tree.num_chunks);
+    }
+
+    for (u32 chunk = 0; chunk < num_chunks; chunk++) {
+        tree.chunks[chunk].length = 0;
+    }
+
+    u32 chunk = 0;
+    u32 offset = 0;
+
+    write_flattened_rows(tree, &chunk, &offset, flattened_chunk_rows_after_rebuild, rows, num_rows);
+    flattened_task_tree_update_first_rows(tree, 0);
+}
+
+static void flattened_task_tree_insert(Flattened_Task_Tree& tree, u32 row, Flattened_Folder_Task* rows, u32 num_rows) {
+    if (!num_rows) {
+        return;
+    }
+
+    if (!tree.num_chunks) {
+        flattened_task_tree_insert_chunks(tree, 0, 1);
+        flattened_task_tree_update_first_rows(tree, 0);
+    }
+
+    u32 offset;
+    u32 chunk = flattened_task_tree_find_chunk(tree, row, &offset);
+
+    Flattened_Task_Chunk* target = &tree.chunks[chunk];
+
+    if (target->length + num_rows <= max_flattened_chunk_rows) {
+        memmove(target->rows + offset + num_rows, target->rows + offset, sizeof(Flattened_Folder_Task) * (target->length - offset));
+        memcpy(target->rows + offset, rows, sizeof(Flattened_Folder_Task) * num_rows);
+
+        target->length += num_rows;
+    } else {
+        // The chunk is split at the row, inserted rows and then the rest of the chunk go into new chunks
+        u32 tail_length = target->length - offset;
+        u32 num_new_rows = num_rows + tail_length;
+        u32 num_new_chunks = (num_new_rows + flattened_chunk_rows_after_rebuild - 1) / flattened_chunk_rows_after_rebuild;
+
+        memcpy(flattened_chunk_tail, target->rows + offset, sizeof(Flattened_Folder_Task) * tail_length);
+
+        target->length = offset;
+
+        flattened_task_tree_insert_chunks(tree, chunk + 1, num_new_chunks);
+
+        u32 write_chunk = chunk + 1;
+        u32 write_offset = 0;
+
+        write_flattened_rows(tree, &write_chunk, &write_offset, flattened_chunk_rows_after_rebuild, rows, num_rows);
+        write_flattened_rows(tree, &write_chunk, &write_offset, flattened_chunk_rows_after_rebuild, flattened_chunk_tail, tail_length);
+
+        // Inserting chunks might have moved the chunk
+        if (!tree.chunks[chunk].length) {
+            flattened_task_tree_remove_chunk(tree, chunk);
+        }
+    }
+
+    flattened_task_tree_update_first_rows(tree, chunk);
+}
+
+static void flattened_task_tree_remove(Flattened_Task_Tree& tree, u32 row, u32 num_rows) {
+    if (!num_rows) {
+        return;
+    }
+
+    u32 offset;
+    u32 first_chunk = flattened_task_tree_find_chunk(tree, row, &offset);
+    u32 chunk = first_chunk;
+
+    while (num_rows) {
+        Flattened_Task_Chunk* target = &tree.chunks[chunk];
+
+        u32 num_removed = MIN(num_rows, target->length - offset);
+
+        memmove(target->rows + offset, target->rows + offset + num_removed, sizeof(Flattened_Folder_Task) * (target->length - offset - num_removed));
+
+        target->length -= num_removed;
+        num_rows -= num_removed;
+
+        if (target->length) {
+            chunk++;
+        } else {
+            flattened_task_tree_remove_chunk(tree, chunk);
+        }
+
+        offset = 0;
+    }
+
+    // Keeps collapsing from leaving lots of nearly empty chunks behind
+    if (first_chunk + 1 < tree.num_chunks) {
+        Flattened_Task_Chunk* target = &tree.chunks[first_chunk];
+        Flattened_Task_Chunk* next = &tree.chunks[first_chunk + 1];
+
+        if (target->length + next->length <= flattened_chunk_rows_after_rebuild) {
+            memcpy(target->rows + target->length, next->rows, sizeof(Flattened_Folder_Task) * next->length);
+
+            target->length += next->length;
+
+            flattened_task_tree_remove_chunk(tree, first_chunk + 1);
+        }
+    }
+
+    flattened_task_tree_update_first_rows(tree, MIN(first_chunk, tree.num_chunks));
+}
+
+// Same number of rows, only used to write re-sorted sub tasks over the previous order
+static void flattened_task_tree_overwrite(Flattened_Task_Tree& tree, u32 row, Flattened_Folder_Task* rows, u32 num_rows) {
+    u32 offset;
+    u32 chunk = flattened_task_tree_find_chunk(tree, row, &offset);
+
+    while (num_rows) {
+        Flattened_Task_Chunk* target = &tree.chunks[chunk];
+
+        u32 num_copied = MIN(num_rows, target->length - offset);
+
+        memcpy(target->rows + offset, rows, sizeof(Flattened_Folder_Task) * num_copied);
+
+        rows += num_copied;
+        num_rows -= num_copied;
+
+        chunk++;
+        offset = 0;
+    }
+}
+
+static void build_task_filter_indexes(Folder_Contents* contents) {
+    u32 num_tasks = contents->folder_tasks.length;
+    u32 num_words = bitmap_words_for_ids(num_tasks);
+
+    value_bitmap_index_init(contents->status_group_index, num_tasks);
+    value_bitmap_index_init(contents->status_index, num_tasks);
+    value_bitmap_index_init(contents->assignee_index, num_tasks);
+
+    for (u32 pass = 0; pass < 2; pass++) {
+        for (u32 task_index = 0; task_index < num_tasks; task_index++) {
+            Folder_Task* task = &contents->folder_tasks[task_index];
+
+            if (pass == 0) {
+                value_bitmap_index_count(contents->status_group_index, task->status_group);
+                value_bitmap_index_count(contents->status_index, task->custom_status_id);
+            } else {
+                value_bitmap_index_add(contents->status_group_index, task->status_group, task_index);
+                value_bitmap_index_add(contents->status_index, task->custom_status_id, task_index);
+            }
+
+            for (u32 assignee_index = 0; assignee_index < task->num_assignees; assignee_index++) {
+                if (pass == 0) {
+                    value_bitmap_index_count(contents->assignee_index, task->assignees[assignee_index]);
+                } else {
+                    value_bitmap_index_add(contents->assignee_index, task->assignees[assignee_index], task_index);
+                }
+            }
+        }
+
+        if (pass == 0) {
+            value_bitmap_index_allocate(contents->status_group_index);
+            value_bitmap_index_allocate(contents->status_index);
+            value_bitmap_index_allocate(contents->assignee_index);
+        }
+    }
+
+    // Parents are taken from the already resolved sub tasks
+    u32* parent_task_offsets = (u32*) arena_calloc(contents->arena, sizeof(u32) * (num_tasks + 1));
+    u32 total_parents = 0;
+
+    for (u32 task_index = 0; task_index < num_tasks; task_index++) {
+        Sorted_Folder_Task* task = &contents->sorted_folder_tasks[task_index];
+
+        for (u32 sub_task_index = 0; sub_task_index < task->num_sub_tasks; sub_task_index++) {
+            parent_task_offsets[task->sub_tasks[sub_task_index] - contents->sorted_folder_tasks + 1]++;
+            total_parents++;
+        }
+    }
+
+    for (u32 task_index = 0; task_index < num_tasks; task_index++) {
+        parent_task_offsets[task_index + 1] += parent_task_offsets[task_index];
+    }
+
+    u32* parent_task_indices = arena_alloc_array<u32>(contents->arena, MAX(total_parents, 1));
+    u32* next_parent = (u32*) MALLOC(sizeof(u32) * MAX(num_tasks, 1));
+
+    memcpy(next_parent, parent_task_offsets, sizeof(u32) * num_tasks);
+
+    for (u32 task_index = 0; task_index < num_tasks; task_index++) {
+        Sorted_Folder_Task* task = &contents->sorted_folder_tasks[task_index];
+
+        for (u32 sub_task_index = 0; sub_task_index < task->num_sub_tasks; sub_task_index++) {
+            parent_task_indices[next_parent[task->sub_tasks[sub_task_index] - contents->sorted_folder_tasks]++] = task_index;
+        }
+    }
+
+    FREE(next_parent);
+
+    contents->parent_task_offsets = parent_task_offsets;
+    contents->parent_task_indices = parent_task_indices;
+    contents->visible_tasks = (u64*) arena_calloc(contents->arena, sizeof(u64) * MAX(num_words, 1));
+    contents->filter_scratch = arena_alloc_array<u64>(contents->arena, MAX(num_words, 1) * 2);
+}
+
+static void build_task_title_index(Folder_Contents* contents) {
+    trigram_index_init(contents->title_index);
+
+    for (u32 task_index = 0; task_index < contents->folder_tasks.length; task_index++) {
+        String& title = contents->folder_tasks[task_index].title;
+
+        trigram_index_set(contents->title_index, task_index, title.start, title.length);
+    }
+}
+
+static void free_task_filter_indexes(Folder_Contents* contents) {
+    value_bitmap_index_destroy(contents->status_group_index);
+    value_bitmap_index_destroy(contents->status_index);
+    value_bitmap_index_destroy(contents->assignee_index);
+
+    trigram_index_destroy(contents->title_index);
+}
+
+static void intersect_bitmaps(u64* into, u64* words, u32 num_words) {
+    for (u32 word = 0; word < num_words; word++) {
+        into[word] &= words[word];
+    }
+}
+
+static void intersect_with_tasks_having_any_value(u64* matching, u64* scratch, Value_Bitmap_Index& index, s32* values, u32 num_values, u32 num_words) {
+    if (!num_values) {
+        return;
+    }
+
+    memset(scratch, 0, sizeof(u64) * num_words);
+
+    for (u32 value_index = 0; value_index < num_values; value_index++) {
+        Id_Set* set = value_bitmap_index_find(index, values[value_index]);
+
+        if (set) {
+            id_set_or_into_bitmap(set, scratch, num_words);
+        }
+    }
+
+    intersect_bitmaps(matching, scratch, num_words);
+}
+
+// Ranges over columns parsed as a different type since the range was added are ignored
+static void intersect_with_custom_field_range(u64* matching, u64* scratch, Custom_Field_Range* range, u32 num_words) {
+    Custom_Field_Column* column = get_custom_field_column(range->field_id);
+
+    if (column->type != range->type) {
+        return;
+    }
+
+    memset(scratch, 0, sizeof(u64) * num_words);
+
+    for (u32 word = 0; word < num_words; word++) {
+        // Only tasks which are still matching need their values checked
+        for (u64 bits = column->presence[word] & matching[word]; bits; bits &= bits - 1) {
+            u32 task_index = word * 64 + __builtin_ctzll(bits);
+            u64 key = get_custom_field_value_key(column, task_index);
+
+            if (key >= range->min_key && key <= range->max_key) {
+                bitmap_set(scratch, task_index);
+            }
+        }
+    }
+
+    intersect_bitmaps(matching, scratch, num_words);
+}
+
+static void mark_parents_visible(u64* visible, u32 task_index) {
+    for (u32 parent = folder_contents->parent_task_offsets[task_index]; parent < folder_contents->parent_task_offsets[task_index + 1]; parent++) {
+        u32 parent_index = folder_contents->parent_task_indices[parent];
+
+        // Matching parents mark their own parents when they are reached
+        if (!bitmap_test(visible, parent_index)) {
+            bitmap_set(visible, parent_index);
+            mark_parents_visible(visible, parent_index);
+        }
+    }
+}
+
+static void apply_task_filter() {
+    if (folder_contents == &empty_folder_contents) {
+        return;
+    }
+
+    u32 num_tasks = folder_contents->folder_tasks.length;
+    u32 num_words = bitmap_words_for_ids(num_tasks);
+
+    u64* matching = folder_contents->filter_scratch;
+    u64* scratch = folder_contents->filter_scratch + num_words;
+
+    memset(matching, 0xff, sizeof(u64) * num_words);
+
+    if (num_tasks % 64) {
+        matching[num_words - 1] = (1ull << (num_tasks % 64)) - 1;
+    }
+
+    s32 status_groups[Status_Group_Cancelled + 1];
+    u32 num_status_groups = 0;
+
+    for (s32 group = Status_Group_Active; group <= Status_Group_Cancelled; group++) {
+        if (task_filter.status_groups & (1 << group)) {
+            status_groups[num_status_groups++] = group;
+        }
+    }
+
+    intersect_with_tasks_having_any_value(matching, scratch, folder_contents->status_group_index, status_groups, num_status_groups, num_words);
+    intersect_with_tasks_having_any_value(matching, scratch, folder_contents->status_index, task_filter.status_ids.data, task_filter.status_ids.length, num_words);
+    intersect_with_tasks_having_any_value(matching, scratch, folder_contents->assignee_index, task_filter.assignees.data, task_filter.assignees.length, num_words);
+
+    for (u32 range_index = 0; range_index < task_filter.custom_field_ranges.length; range_index++) {
+        intersect_with_custom_field_range(matching, scratch, &task_filter.custom_field_ranges[range_index], num_words);
+    }
+
+    u32 search_length = (u32) strlen(task_search_buffer);
+
+    if (search_length) {
+        memset(scratch, 0, sizeof(u64) * num_words);
+
+        trigram_index_match_all(folder_contents->title_index, task_search_buffer, search_length, scratch);
+        intersect_bitmaps(matching, scratch, num_words);
+    }
+
+    u64* visible = folder_contents->visible_tasks;
+
+    memcpy(visible, matching, sizeof(u64) * num_words);
+
+    for (u32 word = 0; word < num_words; word++) {
+        for (u64 bits = matching[word]; bits; bits &= bits - 1) {
+            mark_parents_visible(visible, word * 64 + __builtin_ctzll(bits));
+        }
+    }
+}
+
+static inline bool is_sorted_folder_task_visible(Sorted_Folder_Task* task) {
+    return bitmap_test(folder_contents->visible_tasks, (u32) (task - folder_contents->sorted_folder_tasks));
+}
+
+static u32 rebuild_flattened_task_tree_hierarchically(Sorted_Folder_Task* task, bool is_parent_expanded, u32 level, Flattened_Folder_Task** current_task) {
+    if (!is_sorted_folder_task_visible(task)) {
+        return 0;
+    }
+
+    if (is_parent_expanded) {
+        Flattened_Folder_Task* flattened_task = *current_task;
+        flattened_task->sorted_task = task;
+        flattened_task->nesting_level = level;
+        flattened_task->num_visible_sub_tasks = 0;
+        flattened_task->needs_sub_task_sort = true;
+
+        *current_task = flattened_task + 1;
+
+        for (u32 sub_task_index = 0; sub_task_index < task->num_sub_tasks; sub_task_index++) {
+            flattened_task->num_visible_sub_tasks += rebuild_flattened_task_tree_hierarchically(task->sub_tasks[sub_task_index], task->is_expanded, level + 1, current_task);
+        }
+    }
+
+    return 1;
+}
+
+// Rows rebuild_flattened_task_tree_hierarchically writes for the task and its expanded sub tasks
+static u32 count_flattened_task_tree_rows(Sorted_Folder_Task* task) {
+    if (!is_sorted_folder_task_visible(task)) {
+        return 0;
+    }
+
+    u32 rows = 1;
+
+    if (task->is_expanded) {
+        for (u32 sub_task_index = 0; sub_task_index < task->num_sub_tasks; sub_task_index++) {
+            rows += count_flattened_task_tree_rows(task->sub_tasks[sub_task_index]);
+        }
+    }
+
+    return rows;
+}
+
+// Top level tasks are split into more chunks than there are threads since subtree sizes vary a lot
+struct Parallel_Flatten {
+    Sorted_Folder_Task** tasks;
+    u32 length;
+    u32 num_chunks;
+    u32 chunk_first_row[max_parallel_flatten_chunks]; // Row counts of chunks until the prefix sum
+};
+
+static void count_flattened_rows_of_chunk(void* data, u32 chunk) {
+    Parallel_Flatten* flatten = (Parallel_Flatten*) data;
+
+    u32 start = get_parallel_chunk_start(flatten->length, flatten->num_chunks, chunk);
+    u32 end = get_parallel_chunk_start(flatten->length, flatten->num_chunks, chunk + 1);
+    u32 rows = 0;
+
+    for (u32 task_index = start; task_index < end; task_index++) {
+        rows += count_flattened_task_tree_rows(flatten->tasks[task_index]);
+    }
+
+    flatten->chunk_first_row[chunk] = rows;
+}
+
+static void flatten_chunk(void* data, u32 chunk) {
+    Parallel_Flatten* flatten = (Parallel_Flatten*) data;
+
+    u32 start = get_parallel_chunk_start(flatten->length, flatten->num_chunks, chunk);
+    u32 end = get_parallel_chunk_start(flatten->length, flatten->num_chunks, chunk + 1);
+
+    Flattened_Folder_Task* current_task = flattened_rows_scratch.data + flatten->chunk_first_row[chunk];
+
+    for (u32 task_index = start; task_index < end; task_index++) {
+        rebuild_flattened_task_tree_hierarchically(flatten->tasks[task_index], true, 0, &current_task);
+    }
+}
+
+static void rebuild_flattened_task_tree() {
+    Lazy_Array<Sorted_Folder_Task*, 32>& top_level_tasks = folder_contents->top_level_tasks;
+
+    if (should_run_in_parallel(top_level_tasks.length)) {
+        Parallel_Flatten flatten;
+        flatten.tasks = top_level_tasks.data;
+        flatten.length = top_level_tasks.length;
+        flatten.num_chunks = MIN(platform_get_num_parallel_threads() * 4, max_parallel_flatten_chunks);
+
+        platform_run_parallel(flatten.num_chunks, count_flattened_rows_of_chunk, &flatten);
+
+        u32 total_rows = 0;
+
+        for (u32 chunk = 0; chunk < flatten.num_chunks; chunk++) {
+            u32 rows = flatten.chunk_first_row[chunk];
+            flatten.chunk_first_row[chunk] = total_rows;
+            total_rows += rows;
+        }
+
+        platform_run_parallel(flatten.num_chunks, flatten_chunk, &flatten);
+
+        flattened_rows_scratch.length = total_rows;
+    } else {
+        Flattened_Folder_Task* current_task = flattened_rows_scratch.data;
+
+        for (u32 task_index = 0; task_index < top_level_tasks.length; task_index++) {
+            rebuild_flattened_task_tree_hierarchically(top_level_tasks[task_index], true, 0, &current_task);
+        }
+
+        flattened_rows_scratch.length = (u32) (current_task - flattened_rows_scratch.data);
+    }
+
+    flattened_task_tree_assign(flattened_sorted_folder_task_tree, flattened_rows_scratch.data, flattened_rows_scratch.length);
+}
+
+// The task at the row and its visible sub tasks, written into the scratch rows. Returns the number of rows
+static u32 flatten_task_subtree_into_scratch(u32 row) {
+    Flattened_Folder_Task* flattened_task = get_flattened_task(row);
+    Flattened_Folder_Task* current_task = flattened_rows_scratch.data;
+
+    rebuild_flattened_task_tree_hierarchically(flattened_task->sorted_task, true, flattened_task->nesting_level, &current_task);
+
+    return (u32) (current_task - flattened_rows_scratch.data);
+}
+
+static void rebuild_flattened_task_subtree(u32 row) {
+    flattened_task_tree_overwrite(flattened_sorted_folder_task_tree, row, flattened_rows_scratch.data, flatten_task_subtree_into_scratch(row));
+}
+
+// Only the rows of the subtree are inserted or removed, the rest of the tree is not touched
+static void toggle_flattened_task_expansion(u32 row) {
+    Sorted_Folder_Task* task = get_flattened_task(row)->sorted_task;
+
+    if (task->is_expanded) {
+        u32 num_sub_task_rows = count_flattened_task_tree_rows(task) - 1;
+
+        task->is_expanded = false;
+
+        flattened_task_tree_remove(flattened_sorted_folder_task_tree, row + 1, num_sub_task_rows);
+    } else {
+        task->is_expanded = true;
+
+        u32 num_rows = flatten_task_subtree_into_scratch(row);
+
+        // The first row is the task itself which is already there
+        flattened_task_tree_insert(flattened_sorted_folder_task_tree, row + 1, flattened_rows_scratch.data + 1, num_rows - 1);
+    }
+}
+
+static void sort_sub_tasks_of_task(Sorted_Folder_Task* task) {
+    sort_tasks_by_precomputed_keys(task->sub_tasks, task->num_sub_tasks);
+}
+
+static void sort_top_level_tasks_and_rebuild_flattened_tree() {
+    Lazy_Array<Sorted_Folder_Task*, 32>& top_level_tasks = folder_contents->top_level_tasks;
+
+    sort_tasks_by_precomputed_keys(top_level_tasks.data, top_level_tasks.length);
+
+    rebuild_flattened_task_tree();
+}
+
+static void update_cached_status_and_assignee(Sorted_Folder_Task* sorted_folder_task) {
+    Folder_Task* source = sorted_folder_task->source_task;
+
+    sorted_folder_task->cached_status = find_custom_status_by_id(source->custom_status_id, source->custom_status_id_hash);
+
+    if (source->num_assignees) {
+        sorted_folder_task->cached_first_assignee = find_user_handle_by_id(source->assignees[0]);
+    } else {
+        sorted_folder_task->cached_first_assignee = NULL_USER_HANDLE;
+    }
+}
+
+static void update_cached_data_for_sorted_tasks_in_range(u32 start, u32 end) {
+    for (u32 index = start; index < end; index++) {
+        Sorted_Folder_Task* sorted_folder_task = &folder_contents->sorted_folder_tasks[index];
+
+        update_cached_status_and_assignee(sorted_folder_task);
+
+        sorted_folder_task->sort_key = compute_sort_key(sorted_folder_task);
+    }
+}
+
+// Lookups only read the maps, so tasks can be split between threads
+static void update_cached_data_for_sorted_tasks_chunk(void* data, u32 chunk) {
+    u32 num_tasks = folder_contents->folder_tasks.length;
+    u32 num_chunks = platform_get_num_parallel_threads();
+
+    update_cached_data_for_sorted_tasks_in_range(get_parallel_chunk_start(num_tasks, num_chunks, chunk), get_parallel_chunk_start(num_tasks, num_chunks, chunk + 1));
+}
+
+// Expects sort_field to be already set
+static void update_cached_data_for_sorted_tasks() {
+    if (sort_field == Task_List_Sort_Field_Assignee) {
+        rank_users_by_full_name();
+    }
+
+    if (sort_field == Task_List_Sort_Field_Custom_Field) {
+        sort_custom_field_column = get_custom_field_column(sort_custom_field_id);
+    }
+
+    // TODO We actually only need to do that once when tasks/workflows combination changes, not for every sort
+    u32 num_tasks = folder_contents->folder_tasks.length;
+
+    if (should_run_in_parallel(num_tasks)) {
+        platform_run_parallel(platform_get_num_parallel_threads(), update_cached_data_for_sorted_tasks_chunk, NULL);
+    } else {
+        update_cached_data_for_sorted_tasks_in_range(0, num_tasks);
+    }
+}
+
+static void sort_by_field(Task_List_Sort_Field sort_by) {
+    assert(sort_by != Task_List_Sort_Field_Custom_Field);
+
+    if (sort_field == sort_by) {
+        sort_direction *= -1;
+    } else {
+        sort_direction = Sort_Direction_Normal;
+    }
+
+    sort_field = sort_by;
+
+    u64 start = platform_get_app_time_precise();
+    update_cached_data_for_sorted_tasks();
+    sort_top_level_tasks_and_rebuild_flattened_tree();
+    printf("Sorting %i elements by %i took %fms\n", folder_contents->folder_tasks.length, sort_by, platform_get_delta_time_ms(start));
+}
+
+static void sort_by_custom_field(Custom_Field_Id field_id) {
+    if (sort_field == Task_List_Sort_Field_Custom_Field && field_id == sort_custom_field_id) {
+        sort_direction *= -1;
+    } else {
+        sort_direction = Sort_Direction_Normal;
+    }
+
+    sort_field = Task_List_Sort_Field_Custom_Field;
+    sort_custom_field_id = field_id;
 
-    bool is_expanded;
-};
+    u64 start = platform_get_app_time_precise();
+    update_cached_data_for_sorted_tasks();
+    sort_top_level_tasks_and_rebuild_flattened_tree();
+    printf("Sorting %i elements by %i took %fms\n", folder_contents->folder_tasks.length, field_id, platform_get_delta_time_ms(start));
+}
 
-struct Flattened_Folder_Task {
-    Sorted_Folder_Task* sorted_task;
-    u32 nesting_level;
-    u32 num_visible_sub_tasks;
+Custom_Field** map_columns_to_custom_fields_and_queue_missing() {
+    Custom_Field** column_to_custom_field = (Custom_Field**) talloc(sizeof(Custom_Field*) * current_folder.custom_columns.length);
 
-    bool needs_sub_task_sort;
-};
+    for (u32 column = 0; column < current_folder.custom_columns.length; column++) {
+        Custom_Field_Id custom_field_id = current_folder.custom_columns[column];
 
-struct Table_Paint_Context {
-    ImDrawList* draw_list;
-    Custom_Field** column_to_custom_field;
-    u32 total_columns;
-    float row_height;
-    float scale;
-    float text_padding_y;
-};
+        // TODO hash cache!
+        u32 hash = hash_id(custom_field_id);
 
-typedef int (Comparator)(const void*, const void*);
+        Custom_Field* custom_field = find_custom_field_by_id(custom_field_id, hash);
 
-static const u32 custom_columns_start_index = 3;
+        if (!custom_field) {
+            try_queue_custom_field_info_request(custom_field_id, hash);
+        }
 
-static Folder_Header current_folder{};
+        column_to_custom_field[column] = custom_field;
+    }
 
-static Array<Folder_Task> folder_tasks{};
-static Sorted_Folder_Task* sorted_folder_tasks = NULL;
-static Array<Flattened_Folder_Task> flattened_sorted_folder_task_tree{};
-static Lazy_Array<Sorted_Folder_Task*, 32> top_level_tasks{};
+    return column_to_custom_field;
+}
 
-static Id_Hash_Map<Task_Id, Sorted_Folder_Task*> id_to_sorted_folder_task{};
+static void update_task_filter() {
+    u64 start = platform_get_app_time_precise();
+    apply_task_filter();
+    rebuild_flattened_task_tree();
+    printf("Filtering %i elements took %fms\n", folder_contents->folder_tasks.length, platform_get_delta_time_ms(start));
+}
 
-static Lazy_Array<Custom_Field_Value, 16> custom_field_values{};
-static Lazy_Array<Task_Id, 16> parent_task_ids{};
-static Lazy_Array<User_Id, 16> assignee_ids{};
-static Sorted_Folder_Task** sub_tasks = NULL;
+// Fields of a modified task the list shows, filters and sorts by. Titles, parents and custom fields
+//  are not applied, the task list keeps pointing into the folder response for those
+struct Folder_Task_Delta {
+    Task_Id id;
 
-typedef char Sort_Direction;
-static const Sort_Direction Sort_Direction_Normal = 1;
-static const Sort_Direction Sort_Direction_Reverse = -1;
+    bool has_status_group;
+    Status_Group status_group;
 
-static Task_List_Sort_Field sort_field = Task_List_Sort_Field_None;
-static Custom_Field_Id sort_custom_field_id{};
-static Custom_Field* sort_custom_field;
-static Sort_Direction sort_direction = Sort_Direction_Normal;
-static bool has_been_sorted_after_loading = false;
-static bool show_only_active_tasks = true;
-static bool queue_flattened_tree_rebuild = false;
+    bool has_custom_status_id;
+    Custom_Status_Id custom_status_id;
 
-static inline int compare_tasks_custom_fields(Folder_Task* a, Folder_Task* b, Custom_Field_Type custom_field_type) {
-    String* a_value = NULL;
-    String* b_value = NULL;
+    jsmntok_t* assignee_tokens; // NULL if the assignees were not sent
+    u32 num_assignees;
+};
 
-    // TODO we could cache that to sort big lists faster
-    for (u32 index = 0; index < a->num_custom_field_values; index++) {
-        if (a->custom_field_values[index].field_id == sort_custom_field_id) {
-            a_value = &a->custom_field_values[index].value;
-            break;
-        }
-    }
+static void mark_task_and_its_parents(u64* marked, u32 task_index) {
+    bitmap_set(marked, task_index);
 
-    // TODO if both things are NULL then this comparison is unstable because comparison order is not guaranteed, bro!
-    if (!a_value) {
-        return 1;
-    }
+    for (u32 parent = folder_contents->parent_task_offsets[task_index]; parent < folder_contents->parent_task_offsets[task_index + 1]; parent++) {
+        u32 parent_index = folder_contents->parent_task_indices[parent];
 
-    for (u32 index = 0; index < b->num_custom_field_values; index++) {
-        if (b->custom_field_values[index].field_id == sort_custom_field_id) {
-            b_value = &b->custom_field_values[index].value;
-            break;
+        if (!bitmap_test(marked, parent_index)) {
+            mark_task_and_its_parents(marked, parent_index);
         }
     }
+}
 
-    if (!b_value) {
-        return -1;
-    }
+// The top level task at the row and the rows of its visible sub tasks, which follow it until the next top level row
+static u32 count_flattened_top_level_subtree_rows(u32 row) {
+    Flattened_Task_Tree& tree = flattened_sorted_folder_task_tree;
 
-    switch (custom_field_type) {
-        case Custom_Field_Type_Numeric: {
-            return string_atoi(a_value) - string_atoi(b_value);
-        }
+    u32 offset;
+    u32 chunk = flattened_task_tree_find_chunk(tree, row, &offset);
+    u32 rows = 1;
 
-        case Custom_Field_Type_DropDown:
-        case Custom_Field_Type_Text: {
-            return strncmp(a_value->start, b_value->start, MIN(a_value->length, b_value->length));
-        }
+    for (offset++; chunk < tree.num_chunks; chunk++, offset = 0) {
+        Flattened_Task_Chunk* current_chunk = &tree.chunks[chunk];
 
-        default: {
-            return 0;
+        for (; offset < current_chunk->length; offset++, rows++) {
+            if (current_chunk->rows[offset].nesting_level == 0) {
+                return rows;
+            }
         }
     }
+
+    return rows;
 }
 
-static int compare_folder_tasks_based_on_title(const void* ap, const void* bp) {
-    Sorted_Folder_Task* as = *(Sorted_Folder_Task**) ap;
-    Sorted_Folder_Task* bs = *(Sorted_Folder_Task**) bp;
+static inline bool is_sorted_folder_task_marked(u64* marked, Sorted_Folder_Task* task) {
+    return bitmap_test(marked, (u32) (task - folder_contents->sorted_folder_tasks));
+}
 
-    Folder_Task* a = as->source_task;
-    Folder_Task* b = bs->source_task;
+// Modified tasks can change their place, visibility and the visibility of their parents, but only inside
+//  the subtrees of the marked top level tasks. Those are removed before filtering and flattened again after,
+//  the rows of every other top level task stay where they are
+static void remove_flattened_top_level_subtrees(u64* marked) {
+    Flattened_Task_Tree& tree = flattened_sorted_folder_task_tree;
 
-    int result = strncmp(a->title.start, b->title.start, MIN(a->title.length, b->title.length));
+    for (u32 row = 0; row < tree.length;) {
+        u32 num_rows = count_flattened_top_level_subtree_rows(row);
 
-    if (result == 0) {
-        return (int) (as->source_task->id - bs->source_task->id);
+        if (is_sorted_folder_task_marked(marked, get_flattened_task(row)->sorted_task)) {
+            flattened_task_tree_remove(tree, row, num_rows);
+        } else {
+            row += num_rows;
+        }
     }
-
-    return result;
 }
 
-static int compare_folder_tasks_based_on_assignees(const void* ap, const void* bp) {
-    Sorted_Folder_Task* as = *(Sorted_Folder_Task**) ap;
-    Sorted_Folder_Task* bs = *(Sorted_Folder_Task**) bp;
+static void insert_flattened_top_level_subtrees(u64* marked) {
+    Flattened_Task_Tree& tree = flattened_sorted_folder_task_tree;
+    Lazy_Array<Sorted_Folder_Task*, 32>& top_level_tasks = folder_contents->top_level_tasks;
 
-    User_Handle a_assignee = as->cached_first_assignee;
+    u32 row = 0;
 
-    if (a_assignee == NULL_USER_HANDLE) {
-        return 1;
-    }
+    for (u32 task_index = 0; task_index < top_level_tasks.length; task_index++) {
+        Sorted_Folder_Task* task = top_level_tasks[task_index];
 
-    User_Handle b_assignee = bs->cached_first_assignee;
+        if (!is_sorted_folder_task_visible(task)) {
+            continue;
+        }
 
-    if (b_assignee == NULL_USER_HANDLE) {
-        return -1;
-    }
+        if (is_sorted_folder_task_marked(marked, task)) {
+            Flattened_Folder_Task* current_task = flattened_rows_scratch.data;
 
-    temporary_storage_mark();
+            rebuild_flattened_task_tree_hierarchically(task, true, 0, &current_task);
 
-    String a_name = full_user_name_to_temporary_string(get_user_by_handle(a_assignee));
-    String b_name = full_user_name_to_temporary_string(get_user_by_handle(b_assignee));
+            u32 num_rows = (u32) (current_task - flattened_rows_scratch.data);
 
-    s32 result = strncmp(a_name.start, b_name.start, MIN(a_name.length, b_name.length));
+            flattened_task_tree_insert(tree, row, flattened_rows_scratch.data, num_rows);
 
-    temporary_storage_reset();
+            row += num_rows;
+        } else {
+            assert(get_flattened_task(row)->sorted_task == task);
 
-    if (result == 0) {
-        return (int) (as->source_task->id - bs->source_task->id);
+            row += count_flattened_top_level_subtree_rows(row);
+        }
     }
 
-    return result;
+    assert(row == tree.length);
 }
 
-static int compare_folder_tasks_based_on_status(const void* ap, const void* bp) {
-    Sorted_Folder_Task* as = *(Sorted_Folder_Task**) ap;
-    Sorted_Folder_Task* bs = *(Sorted_Folder_Task**) bp;
-
-    Custom_Status* a_status = as->cached_status;
-    Custom_Status* b_status = bs->cached_status;
+// Same order sort_tasks_by_precomputed_keys puts the tasks in
+static bool is_task_sorted_before(Sorted_Folder_Task* a, Sorted_Folder_Task* b) {
+    u64 key_mask = sort_direction == Sort_Direction_Reverse ? UINT64_MAX : 0;
+    u32 id_mask = sort_direction == Sort_Direction_Reverse ? UINT32_MAX : 0;
 
-    // TODO do status comparison based on status type?
-
-    s32 result = a_status->natural_index - b_status->natural_index;
-
-    if (!result) {
-        result = a_status->id - b_status->id;
+    if (a->sort_key != b->sort_key) {
+        return (a->sort_key ^ key_mask) < (b->sort_key ^ key_mask);
     }
 
-    if (!result) {
-        return (int) (as->source_task->id - bs->source_task->id);
+    if (is_current_sort_field_text() && a->sort_key != missing_value_sort_key) {
+        int result = compare_strings_ignoring_ascii_case(get_sort_text(a), get_sort_text(b)) * sort_direction;
+
+        if (result) {
+            return result < 0;
+        }
     }
 
-    return result;
+    return (signed_to_sort_key(a->id) ^ id_mask) < (signed_to_sort_key(b->id) ^ id_mask);
 }
 
-static int compare_folder_tasks_based_on_custom_field(const void* ap, const void* bp) {
-    Sorted_Folder_Task* as = *(Sorted_Folder_Task**) ap;
-    Sorted_Folder_Task* bs = *(Sorted_Folder_Task**) bp;
-
-    Folder_Task* a = as->source_task;
-    Folder_Task* b = bs->source_task;
+// Moves a task with a changed sort key to its new place in an already sorted list
+static void reinsert_task_in_sort_order(Sorted_Folder_Task** tasks, u32 length, Sorted_Folder_Task* task) {
+    u32 index = 0;
 
-    // TODO inline that?
-    s32 result = compare_tasks_custom_fields(a, b, sort_custom_field->type);
-
-    if (!result) {
-        return (int) (as->source_task->id - bs->source_task->id);
+    while (index < length && tasks[index] != task) {
+        index++;
     }
 
-    return result;
-}
+    if (index == length) {
+        return;
+    }
 
-static inline Comparator* get_comparator_by_current_sort_type() {
-    switch (sort_field) {
-        case Task_List_Sort_Field_Title: {
-            return [](const void* a, const void* b) {
-                return compare_folder_tasks_based_on_title(a, b) * sort_direction;
-            };
-        }
+    memmove(tasks + index, tasks + index + 1, sizeof(Sorted_Folder_Task*) * (length - index - 1));
 
-        case Task_List_Sort_Field_Assignee: {
-            return [](const void* a, const void* b) {
-                return compare_folder_tasks_based_on_assignees(a, b) * sort_direction;
-            };
-        }
+    u32 low = 0, high = length - 1;
 
-        case Task_List_Sort_Field_Status: {
-            return [](const void* a, const void* b) {
-                return compare_folder_tasks_based_on_status(a, b) * sort_direction;
-            };
-        }
+    while (low < high) {
+        u32 middle = (low + high) / 2;
 
-        case Task_List_Sort_Field_Custom_Field: {
-            return [](const void* a, const void* b) {
-                return compare_folder_tasks_based_on_custom_field(a, b) * sort_direction;
-            };
+        if (is_task_sorted_before(tasks[middle], task)) {
+            low = middle + 1;
+        } else {
+            high = middle;
         }
-
-        default: {}
     }
 
-    assert(!"Invalid sort field");
+    memmove(tasks + low + 1, tasks + low, sizeof(Sorted_Folder_Task*) * (length - 1 - low));
 
-    return NULL;
+    tasks[low] = task;
 }
 
-static u32 rebuild_flattened_task_tree_hierarchically(Sorted_Folder_Task* task, bool is_parent_expanded, u32 level, Flattened_Folder_Task** current_task) {
-    if (show_only_active_tasks && task->source_task->status_group != Status_Group_Active) {
-        return 0;
-    }
-
-    if (is_parent_expanded) {
-        Flattened_Folder_Task* flattened_task = *current_task;
-        flattened_task->sorted_task = task;
-        flattened_task->nesting_level = level;
-        flattened_task->num_visible_sub_tasks = 0;
-        flattened_task->needs_sub_task_sort = true;
+static void reinsert_task_into_parent_lists(Sorted_Folder_Task* sorted_task) {
+    u32 task_index = (u32) (sorted_task - folder_contents->sorted_folder_tasks);
+    u32 first_parent = folder_contents->parent_task_offsets[task_index];
+    u32 end_parent = folder_contents->parent_task_offsets[task_index + 1];
 
-        *current_task = flattened_task + 1;
+    for (u32 parent = first_parent; parent < end_parent; parent++) {
+        Sorted_Folder_Task* parent_task = &folder_contents->sorted_folder_tasks[folder_contents->parent_task_indices[parent]];
 
-        for (u32 sub_task_index = 0; sub_task_index < task->num_sub_tasks; sub_task_index++) {
-            flattened_task->num_visible_sub_tasks += rebuild_flattened_task_tree_hierarchically(task->sub_tasks[sub_task_index], task->is_expanded, level + 1, current_task);
-        }
+        reinsert_task_in_sort_order(parent_task->sub_tasks, parent_task->num_sub_tasks, sorted_task);
     }
 
-    return 1;
+    Lazy_Array<Sorted_Folder_Task*, 32>& top_level_tasks = folder_contents->top_level_tasks;
+
+    reinsert_task_in_sort_order(top_level_tasks.data, top_level_tasks.length, sorted_task);
 }
 
-static void rebuild_flattened_task_tree() {
-    Flattened_Folder_Task* current_task = flattened_sorted_folder_task_tree.data;
+// Returns the modified task, NULL if it is not in the loaded folder
+static Sorted_Folder_Task* apply_folder_task_delta(char* json, Folder_Task_Delta* delta, bool* needs_full_sort) {
+    Sorted_Folder_Task* sorted_task = id_hash_map_get(&folder_contents->id_to_sorted_folder_task, delta->id, hash_id(delta->id));
 
-    for (u32 task_index = 0; task_index < top_level_tasks.length; task_index++) {
-        rebuild_flattened_task_tree_hierarchically(top_level_tasks[task_index], true, 0, &current_task);
+    if (!sorted_task) {
+        return NULL;
     }
 
-    flattened_sorted_folder_task_tree.length = (u32) (current_task - flattened_sorted_folder_task_tree.data);
-}
+    Folder_Task* task = sorted_task->source_task;
+    u32 task_index = (u32) (sorted_task - folder_contents->sorted_folder_tasks);
 
-static void rebuild_flattened_task_subtree(Flattened_Folder_Task* starting_at) {
-    rebuild_flattened_task_tree_hierarchically(starting_at->sorted_task, true, starting_at->nesting_level, &starting_at);
-}
+    if (delta->has_status_group && delta->status_group != task->status_group) {
+        value_bitmap_index_remove(folder_contents->status_group_index, task->status_group, task_index);
+        value_bitmap_index_insert(folder_contents->status_group_index, delta->status_group, task_index);
 
-static void sort_sub_tasks_of_task(Sorted_Folder_Task* task) {
-    qsort(task->sub_tasks, task->num_sub_tasks, sizeof(Sorted_Folder_Task*), get_comparator_by_current_sort_type());
-}
+        task->status_group = delta->status_group;
+    }
 
-static void sort_top_level_tasks_and_rebuild_flattened_tree() {
-    qsort(top_level_tasks.data, top_level_tasks.length, sizeof(Sorted_Folder_Task*), get_comparator_by_current_sort_type());
+    if (delta->has_custom_status_id && delta->custom_status_id != task->custom_status_id) {
+        value_bitmap_index_remove(folder_contents->status_index, task->custom_status_id, task_index);
+        value_bitmap_index_insert(folder_contents->status_index, delta->custom_status_id, task_index);
 
-    rebuild_flattened_task_tree();
-}
+        task->custom_status_id = delta->custom_status_id;
+        task->custom_status_id_hash = hash_id(delta->custom_status_id);
+    }
 
-static void update_cached_data_for_sorted_tasks() {
-    // TODO We actually only need to do that once when tasks/workflows combination changes, not for every sort
-    for (u32 index = 0; index < folder_tasks.length; index++) {
-        Sorted_Folder_Task* sorted_folder_task = &sorted_folder_tasks[index];
-        Folder_Task* source = sorted_folder_task->source_task;
+    if (delta->assignee_tokens) {
+        for (u32 assignee_index = 0; assignee_index < task->num_assignees; assignee_index++) {
+            value_bitmap_index_remove(folder_contents->assignee_index, task->assignees[assignee_index], task_index);
+        }
+
+        // The previous assignees are released with the rest of the folder
+        if (delta->num_assignees > task->num_assignees) {
+            task->assignees = arena_alloc_array<User_Id>(folder_contents->arena, delta->num_assignees);
+        }
 
-        sorted_folder_task->cached_status = find_custom_status_by_id(source->custom_status_id, source->custom_status_id_hash);
+        task->num_assignees = delta->num_assignees;
+        task->assignee_names = {};
 
-        if (source->num_assignees) {
-            sorted_folder_task->cached_first_assignee = find_user_handle_by_id(source->assignees[0]);
-        } else {
-            sorted_folder_task->cached_first_assignee = NULL_USER_HANDLE;
+        if (delta->num_assignees) {
+            json_tokens_to_id8_array(json, delta->assignee_tokens, delta->num_assignees, &task->assignees[0]);
+        }
+
+        for (u32 assignee_index = 0; assignee_index < task->num_assignees; assignee_index++) {
+            value_bitmap_index_insert(folder_contents->assignee_index, task->assignees[assignee_index], task_index);
         }
     }
-}
 
-static void sort_by_field(Task_List_Sort_Field sort_by) {
-    assert(sort_by != Task_List_Sort_Field_Custom_Field);
+    update_cached_status_and_assignee(sorted_task);
 
-    if (sort_field == sort_by) {
-        sort_direction *= -1;
-    } else {
-        sort_direction = Sort_Direction_Normal;
+    if (sort_field == Task_List_Sort_Field_None) {
+        return sorted_task;
     }
 
-    update_cached_data_for_sorted_tasks();
+    if (sort_field == Task_List_Sort_Field_Assignee && sorted_task->cached_first_assignee != NULL_USER_HANDLE &&
+        (u32) sorted_task->cached_first_assignee.value >= num_ranked_users) {
+        *needs_full_sort = true;
 
-    sort_field = sort_by;
+        return sorted_task;
+    }
 
-    u64 start = platform_get_app_time_precise();
-    sort_top_level_tasks_and_rebuild_flattened_tree();
-    printf("Sorting %i elements by %i took %fms\n", folder_tasks.length, sort_by, platform_get_delta_time_ms(start));
-}
+    u64 old_sort_key = sorted_task->sort_key;
 
-static void sort_by_custom_field(Custom_Field_Id field_id) {
-    if (sort_field == Task_List_Sort_Field_Custom_Field && field_id == sort_custom_field_id) {
-        sort_direction *= -1;
-    } else {
-        sort_direction = Sort_Direction_Normal;
+    sorted_task->sort_key = compute_sort_key(sorted_task);
+
+    if (sorted_task->sort_key != old_sort_key) {
+        reinsert_task_into_parent_lists(sorted_task);
     }
 
-    update_cached_data_for_sorted_tasks();
+    return sorted_task;
+}
 
-    sort_field = Task_List_Sort_Field_Custom_Field;
-    sort_custom_field_id = field_id;
-    sort_custom_field = find_custom_field_by_id(field_id, hash_id(field_id)); // TODO hash cache?
+static void toggle_filter_value(Lazy_Array<s32, 4>& values, s32 value) {
+    for (u32 index = 0; index < values.length; index++) {
+        if (values[index] == value) {
+            values[index] = values[--values.length];
+            return;
+        }
+    }
 
-    u64 start = platform_get_app_time_precise();
-    sort_top_level_tasks_and_rebuild_flattened_tree();
-    printf("Sorting %i elements by %i took %fms\n", folder_tasks.length, field_id, platform_get_delta_time_ms(start));
+    *lazy_array_add_n_values(values, 1) = value;
 }
 
-Custom_Field** map_columns_to_custom_fields_and_queue_missing() {
-    Custom_Field** column_to_custom_field = (Custom_Field**) talloc(sizeof(Custom_Field*) * current_folder.custom_columns.length);
+// A field is filtered by a single value at a time, filtering by the same value again removes the filter
+static void toggle_custom_field_value_filter(Custom_Field_Column* column, u32 task_index) {
+    Lazy_Array<Custom_Field_Range, 4>& ranges = task_filter.custom_field_ranges;
 
-    for (u32 column = 0; column < current_folder.custom_columns.length; column++) {
-        Custom_Field_Id custom_field_id = current_folder.custom_columns[column];
+    u64 key = get_custom_field_value_key(column, task_index);
 
-        // TODO hash cache!
-        u32 hash = hash_id(custom_field_id);
+    for (u32 index = 0; index < ranges.length; index++) {
+        Custom_Field_Range* range = &ranges[index];
 
-        Custom_Field* custom_field = find_custom_field_by_id(custom_field_id, hash);
+        if (range->field_id == column->field_id) {
+            bool is_same_value = range->type == column->type && range->min_key == key && range->max_key == key;
 
-        if (!custom_field) {
-            try_queue_custom_field_info_request(custom_field_id, hash);
-        }
+            ranges[index] = ranges[--ranges.length];
 
-        column_to_custom_field[column] = custom_field;
+            if (is_same_value) {
+                return;
+            }
+
+            break;
+        }
     }
 
-    return column_to_custom_field;
+    Custom_Field_Range* range = lazy_array_add_n_values(ranges, 1);
+    range->field_id = column->field_id;
+    range->type = column->type;
+    range->min_key = key;
+    range->max_key = key;
 }
 
-Custom_Field_Value* try_find_custom_field_value_in_task(Folder_Task* task, Custom_Field* field) {
-    if (!field) return NULL;
+static bool has_cell_value_filters() {
+    return task_filter.status_ids.length || task_filter.assignees.length || task_filter.custom_field_ranges.length;
+}
 
-    for (u32 index = 0; index < task->num_custom_field_values; index++) {
-        Custom_Field_Value* value = &task->custom_field_values[index];
+// Null for columns of fields which are not loaded yet
+Custom_Field_Column** map_columns_to_custom_field_values(Custom_Field** column_to_custom_field) {
+    Custom_Field_Column** column_to_values = (Custom_Field_Column**) talloc(sizeof(Custom_Field_Column*) * current_folder.custom_columns.length);
 
-        if (value->field_id == field->id) {
-            return value;
-        }
+    for (u32 column = 0; column < current_folder.custom_columns.length; column++) {
+        column_to_values[column] = column_to_custom_field[column] ? get_custom_field_column(current_folder.custom_columns[column]) : NULL;
     }
 
-    return NULL;
+    return column_to_values;
 }
 
-void draw_assignees_cell_contents(ImDrawList* draw_list, Folder_Task* task, ImVec2 text_position) {
+// Users which are not loaded yet are requested and shown as "..."
+static String assignee_names_to_temporary_string(Folder_Task* task, bool& all_users_loaded, u32& loaded_at) {
+    String result{};
+
+    all_users_loaded = true;
+    loaded_at = 0;
+
     for (u32 assignee_index = 0; assignee_index < task->num_assignees; assignee_index++) {
         User_Id user_id = task->assignees[assignee_index];
         u32 hash = hash_id(user_id);
         User* user = find_user_by_id(user_id, hash);
-        u32 color = color_black_text_on_white;
 
-        char* start, *end;
-        bool is_not_last = assignee_index < task->num_assignees - 1;
+        const char* separator = assignee_index ? ", " : "";
 
         if (user) {
-            const char* name_pattern = "%.*s %.*s";
+            result = tprintf("%.*s%s%.*s %.*s", result.length, result.start, separator,
+                             user->first_name.length, user->first_name.start,
+                             user->last_name.length, user->last_name.start);
 
-            if (is_not_last) {
-                name_pattern = "%.*s %.*s, ";
-            }
-
-            tprintf(name_pattern, &start, &end,
-                    user->first_name.length, user->first_name.start,
-                    user->last_name.length, user->last_name.start);
-
-            color = lerp_color_alpha(color, user->loaded_at, tick, 8);
+            loaded_at = MAX(loaded_at, user->loaded_at);
         } else {
-            if (is_not_last) {
-                tprintf("..., ", &start, &end);
-            } else {
-                tprintf("...", &start, &end);
-            }
+            result = tprintf("%.*s%s...", result.length, result.start, separator);
+
+            all_users_loaded = false;
 
             try_queue_user_info_request(user_id, hash);
         }
+    }
+
+    return result;
+}
+
+void draw_assignees_cell_contents(ImDrawList* draw_list, Folder_Task* task, ImVec2 text_position, float max_width) {
+    if (!task->num_assignees) {
+        return;
+    }
+
+    String names = task->assignee_names;
+    u32 loaded_at = task->assignees_loaded_at;
+
+    if (!names.start) {
+        bool all_users_loaded;
+
+        names = assignee_names_to_temporary_string(task, all_users_loaded, loaded_at);
+
+        if (!all_users_loaded) {
+            u32 color = lerp_color_alpha(color_black_text_on_white, loaded_at, tick, 8);
 
-        float text_width = ImGui::CalcTextSize(start, end).x;
+            draw_cached_text(draw_list, text_position, color, names.start, names.start + names.length, max_width);
+            return;
+        }
 
-        draw_list->AddText(text_position, color, start, end);
+        task->assignee_names = arena_copy_string(folder_contents->arena, names);
+        task->assignees_loaded_at = loaded_at;
 
-        text_position.x += text_width;
+        names = task->assignee_names;
     }
+
+    u32 color = lerp_color_alpha(color_black_text_on_white, loaded_at, tick, 8);
+
+    draw_cached_string(draw_list, text_position, color, names, max_width);
 }
 
 bool draw_open_task_button(Table_Paint_Context& context, ImVec2 cell_top_left, float column_width) {
@@ -476,6 +1938,19 @@ bool draw_open_task_button(Table_Paint_Context& context, ImVec2 cell_top_left, f
     return button_state.pressed;
 }
 
+// Clicking a status, assignee or custom field cell filters the list by its value
+bool draw_cell_filter_button(Table_Paint_Context& context, const char* string_id, ImVec2 cell_top_left, float column_width) {
+    ImVec2 size(column_width, context.row_height);
+
+    Button_State button_state = button(string_id, cell_top_left, size);
+
+    if (!button_state.clipped && button_state.hovered) {
+        context.draw_list->AddLine(cell_top_left + ImVec2(0, size.y - 2.0f * context.scale), cell_top_left + size - ImVec2(0, 2.0f * context.scale), color_link, 1.5f);
+    }
+
+    return button_state.pressed;
+}
+
 void draw_table_cell_for_task(Table_Paint_Context& context, u32 column, float column_width, Flattened_Folder_Task* flattened_task, ImVec2 cell_top_left) {
     ImVec2 padding(context.scale * 8.0f, context.text_padding_y);
     Sorted_Folder_Task* sorted_task = flattened_task->sorted_task;
@@ -489,24 +1964,14 @@ void draw_table_cell_for_task(Table_Paint_Context& context, u32 column, float co
                 ImVec2 arrow_point = cell_top_left + ImVec2(context.scale * 20.0f + nesting_level_padding, context.row_height / 2.0f);
 
                 if (draw_expand_arrow_button(context.draw_list, arrow_point, context.row_height, sorted_task->is_expanded)) {
-                    sorted_task->is_expanded = !sorted_task->is_expanded;
-                    /* TODO We don't need to rebuild the whole tree there
-                     * TODO     this is just inserting/removing subtask tree after the current task and could be done
-                     * TODO     with a simple subtree traversal to determine subtree size, then a subsequent list insert
-                     * TODO     or a simple memcpy in case of a removal
-                     * TODO Also queuing there is not really necessary, since the only part of the flattened array
-                     * TODO     which changes lies after the current element but the current solution feels cleaner,
-                     * TODO     although it delays the update for one frame
-                     */
-                    queue_flattened_tree_rebuild = true;
+                    // Rows can't move while they are being drawn, applied after the table is done
+                    queued_expand_toggle = flattened_task;
                 }
             }
 
             ImVec2 title_padding(context.scale * 40.0f + nesting_level_padding, context.text_padding_y);
 
-            char* start = task->title.start, * end = task->title.start + task->title.length;
-
-            context.draw_list->AddText(cell_top_left + title_padding, color_black_text_on_white, start, end);
+            draw_cached_string(context.draw_list, cell_top_left + title_padding, color_black_text_on_white, task->title, column_width - title_padding.x - padding.x);
 
             if (ImGui::IsMouseHoveringRect(cell_top_left, cell_top_left + ImVec2(column_width, context.row_height))) {
                 if (draw_open_task_button(context, cell_top_left, column_width)) {
@@ -521,9 +1986,12 @@ void draw_table_cell_for_task(Table_Paint_Context& context, u32 column, float co
             Custom_Status* status = sorted_task->cached_status;
 
             if (status) {
-                char* start = status->name.start, * end = status->name.start + status->name.length;
+                draw_cached_string(context.draw_list, cell_top_left + padding, status->color, status->name, column_width - padding.x * 2.0f);
+            }
 
-                context.draw_list->AddText(cell_top_left + padding, status->color, start, end);
+            if (draw_cell_filter_button(context, "status_filter_button", cell_top_left, column_width)) {
+                toggle_filter_value(task_filter.status_ids, task->custom_status_id);
+                queued_filter_update = true;
             }
 
             break;
@@ -532,20 +2000,30 @@ void draw_table_cell_for_task(Table_Paint_Context& context, u32 column, float co
         case 2: {
             ImVec2 text_position = cell_top_left + padding;
 
-            draw_assignees_cell_contents(context.draw_list, task, text_position);
+            draw_assignees_cell_contents(context.draw_list, task, text_position, column_width - padding.x * 2.0f);
+
+            if (task->num_assignees && draw_cell_filter_button(context, "assignee_filter_button", cell_top_left, column_width)) {
+                toggle_filter_value(task_filter.assignees, task->assignees[0]);
+                queued_filter_update = true;
+            }
 
             break;
         }
 
         default: {
-            if (column > custom_columns_start_index) {
-                Custom_Field* custom_field = context.column_to_custom_field[column - custom_columns_start_index];
-                Custom_Field_Value* field_value = try_find_custom_field_value_in_task(task, custom_field);
+            if (column >= custom_columns_start_index) {
+                Custom_Field_Column* values = context.column_to_values[column - custom_columns_start_index];
+                u32 task_index = (u32) (sorted_task - folder_contents->sorted_folder_tasks);
 
-                if (field_value) {
-                    char* start = field_value->value.start, * end = field_value->value.start + field_value->value.length;
+                if (values && is_custom_field_value_present(values, task_index)) {
+                    String* value = &values->values[task_index];
 
-                    context.draw_list->AddText(cell_top_left + padding, color_black_text_on_white, start, end);
+                    draw_cached_string(context.draw_list, cell_top_left + padding, color_black_text_on_white, *value, column_width - padding.x * 2.0f);
+
+                    if (draw_cell_filter_button(context, "custom_field_filter_button", cell_top_left, column_width)) {
+                        toggle_custom_field_value_filter(values, task_index);
+                        queued_filter_update = true;
+                    }
                 }
             }
         }
@@ -589,19 +2067,72 @@ String get_column_title(Table_Paint_Context& context, u32 column) {
         column_title.length = (u32) strlen(column_title.start);
     }
 
-    return column_title;
+    return column_title;
+}
+
+Task_List_Sort_Field get_column_sort_field(u32 column) {
+    switch (column) {
+        case 0: return Task_List_Sort_Field_Title;
+        case 1: return Task_List_Sort_Field_Status;
+        case 2: return Task_List_Sort_Field_Assignee;
+
+        default: {
+            return Task_List_Sort_Field_Custom_Field;
+        }
+    }
+}
+
+// Narrows the list to tasks with titles containing the text, drawn at the right of the toolbar
+bool draw_task_search_input(Table_Paint_Context& context, ImVec2 toolbar_top_right, float toolbar_height) {
+    const u32 placeholder_color = 0xff8c8c8c;
+
+    ImVec2 cursor = ImGui::GetCursorScreenPos();
+
+    float input_width = 240.0f * context.scale;
+    ImVec2 frame_padding(8.0f * context.scale, toolbar_height / 2.0f - ImGui::GetFontSize() / 2.0f);
+    ImVec2 input_top_left = toolbar_top_right - ImVec2(input_width, 0);
+
+    ImGui::SetCursorScreenPos(input_top_left);
+    ImGui::PushStyleVar(ImGuiStyleVar_FramePadding, frame_padding);
+    ImGui::PushStyleColor(ImGuiCol_FrameBg, IM_COL32_WHITE);
+    ImGui::PushItemWidth(input_width);
+
+    bool changed = ImGui::InputText("##task_search", task_search_buffer, ARRAY_SIZE(task_search_buffer));
+
+    ImGui::PopItemWidth();
+    ImGui::PopStyleColor();
+    ImGui::PopStyleVar();
+
+    if (!task_search_buffer[0] && !ImGui::IsItemActive()) {
+        context.draw_list->AddText(input_top_left + frame_padding, placeholder_color, "Search tasks");
+    }
+
+    ImGui::SetCursorScreenPos(cursor);
+
+    return changed;
 }
 
-Task_List_Sort_Field get_column_sort_field(u32 column) {
-    switch (column) {
-        case 0: return Task_List_Sort_Field_Title;
-        case 1: return Task_List_Sort_Field_Status;
-        case 2: return Task_List_Sort_Field_Assignee;
+// Advances top_left past the button
+bool draw_toolbar_filter_button(Table_Paint_Context& context, const char* text, bool is_selected, float toolbar_height, ImVec2& top_left) {
+    const u32 color_not_selected = 0xff8c8c8c;
 
-        default: {
-            return Task_List_Sort_Field_Custom_Field;
-        }
+    ImVec2 text_size = ImGui::CalcTextSize(text);
+    ImVec2 padding(8.0f * context.scale, toolbar_height / 2.0f - text_size.y / 2.0f);
+    ImVec2 size(text_size.x + padding.x * 2.0f, toolbar_height);
+
+    Button_State button_state = button(text, top_left, size);
+
+    u32 color = is_selected ? color_link : color_not_selected;
+
+    if (button_state.hovered) {
+        color = color_black_text_on_white;
     }
+
+    context.draw_list->AddText(top_left + padding, color, text);
+
+    top_left.x += size.x;
+
+    return button_state.pressed;
 }
 
 void draw_folder_header(Table_Paint_Context& context, float content_width) {
@@ -630,15 +2161,42 @@ void draw_folder_header(Table_Paint_Context& context, float content_width) {
 
     context.draw_list->AddRectFilled(toolbar_top_left, toolbar_bottom_right, toolbar_background);
 
-    if (folder_tasks.length > 0) {
+    if (folder_contents->folder_tasks.length > 0) {
         ImVec2 toolbar_text_padding = ImVec2(8.0f * context.scale, toolbar_height / 2.0f - ImGui::GetFontSize() / 2.0f);
 
         char* toolbar_text_start;
         char* toolbar_text_end;
 
-        tprintf("Total: %d", &toolbar_text_start, &toolbar_text_end, folder_tasks.length);
+        tprintf("Total: %d", &toolbar_text_start, &toolbar_text_end, folder_contents->folder_tasks.length);
 
         context.draw_list->AddText(toolbar_top_left + toolbar_text_padding, color_black_text_on_white, toolbar_text_start, toolbar_text_end);
+
+        ImVec2 filter_top_left = toolbar_top_left + ImVec2(toolbar_text_padding.x * 3.0f + ImGui::CalcTextSize(toolbar_text_start, toolbar_text_end).x, 0);
+
+        const char* status_group_names[] = { "Active", "Completed", "Deferred", "Cancelled" };
+        bool filter_changed = draw_task_search_input(context, toolbar_bottom_right - ImVec2(0, toolbar_height), toolbar_height);
+
+        for (s32 group = Status_Group_Active; group <= Status_Group_Cancelled; group++) {
+            const char* name = status_group_names[group - Status_Group_Active];
+            bool is_selected = (task_filter.status_groups & (1 << group)) != 0;
+
+            if (draw_toolbar_filter_button(context, name, is_selected, toolbar_height, filter_top_left)) {
+                task_filter.status_groups ^= 1 << group;
+                filter_changed = true;
+            }
+        }
+
+        if (has_cell_value_filters() && draw_toolbar_filter_button(context, "Clear filters", true, toolbar_height, filter_top_left)) {
+            lazy_array_soft_reset(task_filter.status_ids);
+            lazy_array_soft_reset(task_filter.assignees);
+            lazy_array_soft_reset(task_filter.custom_field_ranges);
+
+            filter_changed = true;
+        }
+
+        if (filter_changed) {
+            update_task_filter();
+        }
     }
 }
 
@@ -699,7 +2257,7 @@ void draw_table_header(Table_Paint_Context& context, ImVec2 window_top_left) {
         const u32 grid_color = 0xffebebeb;
 
         draw_list->AddRectFilled(column_top_left_absolute, column_top_left_absolute + size, IM_COL32_WHITE);
-        draw_list->AddText(column_top_left_absolute + ImVec2(8.0f * context.scale, context.text_padding_y), text_color, start, end);
+        draw_cached_text(draw_list, column_top_left_absolute + ImVec2(8.0f * context.scale, context.text_padding_y), text_color, start, end, column_width - 16.0f * context.scale);
         draw_list->AddLine(column_top_left_absolute, column_top_left_absolute + ImVec2(0, context.row_height), grid_color, 1.25f);
 
         if (sorting_by_this_column) {
@@ -738,6 +2296,7 @@ void draw_task_list() {
         paint_context.row_height = row_height;
         paint_context.text_padding_y = row_height / 2.0f - ImGui::GetFontSize() / 2.0f;
         paint_context.column_to_custom_field = column_to_custom_field;
+        paint_context.column_to_values = map_columns_to_custom_field_values(column_to_custom_field);
         paint_context.total_columns = current_folder.custom_columns.length + custom_columns_start_index;
 
         draw_folder_header(paint_context, ImGui::GetWindowWidth());
@@ -762,12 +2321,12 @@ void draw_task_list() {
 
         u32 first_top_level_task_row = first_visible_row;
 
-        while (first_top_level_task_row > 0 && flattened_sorted_folder_task_tree[first_top_level_task_row].nesting_level) {
+        while (first_top_level_task_row > 0 && get_flattened_task(first_top_level_task_row)->nesting_level) {
             first_top_level_task_row--;
         }
 
         for (u32 row = first_top_level_task_row; row < last_visible_row; row++) {
-            Flattened_Folder_Task* flattened_task = &flattened_sorted_folder_task_tree[row];
+            Flattened_Folder_Task* flattened_task = get_flattened_task(row);
 
             bool is_expanded = flattened_task->sorted_task->is_expanded;
             bool needs_to_be_sorted = flattened_task->needs_sub_task_sort;
@@ -775,7 +2334,7 @@ void draw_task_list() {
 
             if (is_expanded && needs_to_be_sorted && has_more_than_one_visible_task) {
                 sort_sub_tasks_of_task(flattened_task->sorted_task);
-                rebuild_flattened_task_subtree(flattened_task);
+                rebuild_flattened_task_subtree(row);
 
                 flattened_task->needs_sub_task_sort = false;
             }
@@ -785,7 +2344,7 @@ void draw_task_list() {
             float column_width = get_column_width(paint_context, column);
 
             for (u32 row = first_visible_row; row < last_visible_row; row++) {
-                Flattened_Folder_Task* flattened_task = &flattened_sorted_folder_task_tree[row];
+                Flattened_Folder_Task* flattened_task = get_flattened_task(row);
 
                 float row_top_y = row_height * (row + 1);
 
@@ -822,9 +2381,21 @@ void draw_task_list() {
         ImGui::Dummy(ImVec2(column_left_x, flattened_sorted_folder_task_tree.length * row_height));
         ImGui::EndChild();
 
-        if (queue_flattened_tree_rebuild) {
-            queue_flattened_tree_rebuild = false;
-            rebuild_flattened_task_tree();
+        if (queued_expand_toggle) {
+            for (u32 row = first_visible_row; row < last_visible_row; row++) {
+                if (get_flattened_task(row) == queued_expand_toggle) {
+                    toggle_flattened_task_expansion(row);
+                    break;
+                }
+            }
+
+            queued_expand_toggle = NULL;
+        }
+
+        if (queued_filter_update) {
+            update_task_filter();
+
+            queued_filter_update = false;
         }
 
         u32
@@ -844,18 +2415,41 @@ void draw_task_list() {
     ImGui::EndChildFrame();
 }
 
-static void process_folder_contents_data_object(char* json, jsmntok_t*& token) {
+#define FOLDER_TASK_KEYS(KEY) \
+    KEY(Folder_Task_Key_Title, "title") \
+    KEY(Folder_Task_Key_Id, "id") \
+    KEY(Folder_Task_Key_Status, "status") \
+    KEY(Folder_Task_Key_Custom_Status_Id, "customStatusId") \
+    KEY(Folder_Task_Key_Responsible_Ids, "responsibleIds") \
+    KEY(Folder_Task_Key_Parent_Ids, "parentIds") \
+    KEY(Folder_Task_Key_Super_Task_Ids, "superTaskIds") \
+    KEY(Folder_Task_Key_Custom_Fields, "customFields")
+
+DEFINE_JSON_KEYS(Folder_Task_Key, json_to_folder_task_key, FOLDER_TASK_KEYS)
+
+#define FOLDER_HEADER_KEYS(KEY) \
+    KEY(Folder_Header_Key_Title, "title") \
+    KEY(Folder_Header_Key_Custom_Column_Ids, "customColumnIds")
+
+DEFINE_JSON_KEYS(Folder_Header_Key, json_to_folder_header_key, FOLDER_HEADER_KEYS)
+
+// Runs on a worker thread, should only touch the contents being built
+static void process_folder_contents_data_object(Folder_Contents* contents, char* json, jsmntok_t*& token) {
     jsmntok_t* object_token = token++;
 
     assert(object_token->type == JSMN_OBJECT);
 
+    Array<Folder_Task>& folder_tasks = contents->folder_tasks;
+
     Folder_Task* folder_task = &folder_tasks[folder_tasks.length];
     folder_task->num_parent_task_ids = 0;
     folder_task->num_parent_folder_ids = 0;
     folder_task->num_custom_field_values = 0;
     folder_task->num_assignees = 0;
+    folder_task->assignee_names = {};
+    folder_task->assignees_loaded_at = 0;
 
-    Sorted_Folder_Task* sorted_folder_task = &sorted_folder_tasks[folder_tasks.length];
+    Sorted_Folder_Task* sorted_folder_task = &contents->sorted_folder_tasks[folder_tasks.length];
     sorted_folder_task->num_sub_tasks = 0;
     sorted_folder_task->source_task = folder_task;
     sorted_folder_task->is_expanded = false;
@@ -869,88 +2463,116 @@ static void process_folder_contents_data_object(char* json, jsmntok_t*& token) {
 
         jsmntok_t* next_token = token;
 
-        if (json_string_equals(json, property_token, "title")) {
-            json_token_to_string(json, next_token, folder_task->title);
-        } else if (json_string_equals(json, property_token, "id")) {
-            json_token_to_right_part_of_id16(json, next_token, folder_task->id);
-        } else if (json_string_equals(json, property_token, "status")) {
-            String group_name;
-            json_token_to_string(json, next_token, group_name);
+        switch (json_to_folder_task_key(json, property_token)) {
+            case Folder_Task_Key_Title: {
+                String title;
+                json_token_to_string(json, next_token, title);
 
-            folder_task->status_group = status_group_name_to_status_group(group_name);
-        } else if (json_string_equals(json, property_token, "customStatusId")) {
-            json_token_to_right_part_of_id16(json, next_token, folder_task->custom_status_id);
+                folder_task->title = arena_copy_string(contents->arena, title);
+                break;
+            }
 
-            folder_task->custom_status_id_hash = hash_id(folder_task->custom_status_id);
-        } else if (json_string_equals(json, property_token, "responsibleIds")) {
-            assert(next_token->type == JSMN_ARRAY);
+            case Folder_Task_Key_Id: {
+                json_token_to_right_part_of_id16(json, next_token, folder_task->id);
+                break;
+            }
 
-            token++;
+            case Folder_Task_Key_Status: {
+                String group_name;
+                json_token_to_string(json, next_token, group_name);
 
-            if (next_token->size > 0) {
-                folder_task->assignees = lazy_array_add_n_values_relative_pointer(assignee_ids, next_token->size);
+                folder_task->status_group = status_group_name_to_status_group(group_name);
+                break;
             }
 
-            for (u32 field_index = 0; field_index < next_token->size; field_index++, token++) {
-                json_token_to_id8(json, token, folder_task->assignees[folder_task->num_assignees++]);
+            case Folder_Task_Key_Custom_Status_Id: {
+                json_token_to_right_part_of_id16(json, next_token, folder_task->custom_status_id);
+
+                folder_task->custom_status_id_hash = hash_id(folder_task->custom_status_id);
+                break;
             }
 
-            token--;
-        } else if (json_string_equals(json, property_token, "parentIds")) {
-            assert(next_token->type == JSMN_ARRAY);
+            case Folder_Task_Key_Responsible_Ids: {
+                assert(next_token->type == JSMN_ARRAY);
 
-            token++;
+                token++;
 
-            if (next_token->size > 0) {
-                folder_task->parent_folder_ids = lazy_array_add_n_values_relative_pointer(parent_task_ids, next_token->size);
-            }
+                if (next_token->size > 0) {
+                    folder_task->assignees = arena_alloc_array<User_Id>(contents->arena, next_token->size);
+                    folder_task->num_assignees = next_token->size;
 
-            for (u32 field_index = 0; field_index < next_token->size; field_index++, token++) {
-                json_token_to_right_part_of_id16(json, token, folder_task->parent_folder_ids[folder_task->num_parent_folder_ids++]);
+                    json_tokens_to_id8_array(json, token, next_token->size, &folder_task->assignees[0]);
+                }
+
+                token += next_token->size - 1;
+                break;
             }
 
-            token--;
-        } else if (json_string_equals(json, property_token, "superTaskIds")) {
-            assert(next_token->type == JSMN_ARRAY);
+            case Folder_Task_Key_Parent_Ids: {
+                assert(next_token->type == JSMN_ARRAY);
 
-            token++;
+                token++;
 
-            if (next_token->size > 0) {
-                folder_task->parent_task_ids = lazy_array_add_n_values_relative_pointer(parent_task_ids, next_token->size);
-            }
+                if (next_token->size > 0) {
+                    folder_task->parent_folder_ids = arena_alloc_array<Folder_Id>(contents->arena, next_token->size);
+                    folder_task->num_parent_folder_ids = next_token->size;
+
+                    json_tokens_to_right_part_of_id16_array(json, token, next_token->size, &folder_task->parent_folder_ids[0]);
+                }
 
-            for (u32 field_index = 0; field_index < next_token->size; field_index++, token++) {
-                json_token_to_right_part_of_id16(json, token, folder_task->parent_task_ids[folder_task->num_parent_task_ids++]);
+                token += next_token->size - 1;
+                break;
             }
 
-            token--;
-        } else if (json_string_equals(json, property_token, "customFields")) {
-            assert(next_token->type == JSMN_ARRAY);
+            case Folder_Task_Key_Super_Task_Ids: {
+                assert(next_token->type == JSMN_ARRAY);
+
+                token++;
 
-            token++;
+                if (next_token->size > 0) {
+                    folder_task->parent_task_ids = arena_alloc_array<Task_Id>(contents->arena, next_token->size);
+                    folder_task->num_parent_task_ids = next_token->size;
+
+                    json_tokens_to_right_part_of_id16_array(json, token, next_token->size, &folder_task->parent_task_ids[0]);
+                }
 
-            if (next_token->size > 0) {
-                folder_task->custom_field_values = lazy_array_add_n_values_relative_pointer(custom_field_values, next_token->size);
+                token += next_token->size - 1;
+                break;
             }
 
-            for (u32 field_index = 0; field_index < next_token->size; field_index++) {
-                Custom_Field_Value* value = &folder_task->custom_field_values[folder_task->num_custom_field_values++];
+            case Folder_Task_Key_Custom_Fields: {
+                assert(next_token->type == JSMN_ARRAY);
+
+                token++;
+
+                if (next_token->size > 0) {
+                    folder_task->custom_field_values = arena_alloc_array<Custom_Field_Value>(contents->arena, next_token->size);
+                }
+
+                for (u32 field_index = 0; field_index < next_token->size; field_index++) {
+                    Custom_Field_Value* value = &folder_task->custom_field_values[folder_task->num_custom_field_values++];
 
-                // TODO a dependency on task_view is not really good, should we move the code somewhere else?
-                process_task_custom_field_value(value, json, token);
+                    // TODO a dependency on task_view is not really good, should we move the code somewhere else?
+                    process_task_custom_field_value(value, json, token);
+
+                    value->value = arena_copy_string(contents->arena, value->value);
+                }
+
+                token--;
+                break;
             }
 
-            token--;
-        } else {
-            eat_json(token);
-            token--;
+            default: {
+                json_skip(token);
+                token--;
+            }
         }
     }
 
     sorted_folder_task->id = folder_task->id;
     sorted_folder_task->id_hash = hash_id(folder_task->id);
 
-    id_hash_map_put(&id_to_sorted_folder_task, sorted_folder_task, folder_task->id, sorted_folder_task->id_hash);
+    id_hash_map_put(&contents->id_to_sorted_folder_task, sorted_folder_task, folder_task->id, sorted_folder_task->id_hash);
 }
 
 void process_folder_header_data(char* json, u32 data_size, jsmntok_t*& token) {
@@ -967,27 +2589,144 @@ void process_folder_header_data(char* json, u32 data_size, jsmntok_t*& token) {
 
         jsmntok_t* next_token = token;
 
-        if (json_string_equals(json, property_token, "title")) {
-            json_token_to_string(json, next_token, current_folder.name);
-        } else if (json_string_equals(json, property_token, "customColumnIds")) {
-            current_folder.custom_columns.data = (Custom_Field_Id*) REALLOC(current_folder.custom_columns.data, sizeof(Custom_Field_Id) * next_token->size);
-            current_folder.custom_columns.length = 0;
+        switch (json_to_folder_header_key(json, property_token)) {
+            case Folder_Header_Key_Title: {
+                String name;
+                json_token_to_string(json, next_token, name);
+
+                current_folder.name = intern_string(name);
+                break;
+            }
+
+            case Folder_Header_Key_Custom_Column_Ids: {
+                current_folder.custom_columns.data = (Custom_Field_Id*) REALLOC(current_folder.custom_columns.data, sizeof(Custom_Field_Id) * next_token->size);
+                current_folder.custom_columns.length = next_token->size;
+
+                json_tokens_to_right_part_of_id16_array(json, token + 1, next_token->size, current_folder.custom_columns.data);
+
+                token += next_token->size;
+
+                break;
+            }
+
+            default: {
+                json_skip(token);
+                token--;
+            }
+        }
+    }
+}
+
+static void process_folder_task_delta_object(char* json, jsmntok_t*& token, Folder_Task_Delta* delta) {
+    jsmntok_t* object_token = token++;
+
+    assert(object_token->type == JSMN_OBJECT);
+
+    for (u32 propety_index = 0; propety_index < object_token->size; propety_index++, token++) {
+        jsmntok_t* property_token = token++;
+
+        assert(property_token->type == JSMN_STRING);
+
+        jsmntok_t* next_token = token;
+
+        switch (json_to_folder_task_key(json, property_token)) {
+            case Folder_Task_Key_Id: {
+                json_token_to_right_part_of_id16(json, next_token, delta->id);
+                break;
+            }
+
+            case Folder_Task_Key_Status: {
+                String group_name;
+                json_token_to_string(json, next_token, group_name);
+
+                delta->status_group = status_group_name_to_status_group(group_name);
+                delta->has_status_group = true;
+                break;
+            }
+
+            case Folder_Task_Key_Custom_Status_Id: {
+                json_token_to_right_part_of_id16(json, next_token, delta->custom_status_id);
+
+                delta->has_custom_status_id = true;
+                break;
+            }
 
-            for (u32 array_index = 0; array_index < next_token->size; array_index++) {
-                jsmntok_t* id_token = ++token;
+            case Folder_Task_Key_Responsible_Ids: {
+                assert(next_token->type == JSMN_ARRAY);
 
-                assert(id_token->type == JSMN_STRING);
+                token++;
 
-                json_token_to_right_part_of_id16(json, id_token, current_folder.custom_columns[current_folder.custom_columns.length++]);
+                delta->assignee_tokens = token;
+                delta->num_assignees = next_token->size;
+
+                token += next_token->size - 1;
+                break;
+            }
+
+            default: {
+                json_skip(token);
+                token--;
             }
-        } else {
-            eat_json(token);
-            token--;
         }
     }
 }
 
-static void associate_parent_tasks_with_sub_tasks(Folder_Id top_parent_id) {
+// Responses to task modifications have the whole modified task, it is patched in the loaded folder
+//  and moved to its new place in the current sort order, without reloading or resorting the folder
+void process_task_list_modification_data(char* json, u32 data_size, jsmntok_t*& token) {
+    if (folder_contents == &empty_folder_contents) {
+        return;
+    }
+
+    u64 start = platform_get_app_time_precise();
+
+    u32 num_applied = 0;
+    bool needs_full_sort = false;
+
+    u32 num_words = bitmap_words_for_ids(folder_contents->folder_tasks.length);
+    u64* modified_subtrees = (u64*) talloc(sizeof(u64) * num_words);
+
+    memset(modified_subtrees, 0, sizeof(u64) * num_words);
+
+    for (u32 task_index = 0; task_index < data_size; task_index++) {
+        Folder_Task_Delta delta{};
+
+        process_folder_task_delta_object(json, token, &delta);
+
+        Sorted_Folder_Task* modified_task = apply_folder_task_delta(json, &delta, &needs_full_sort);
+
+        if (modified_task) {
+            mark_task_and_its_parents(modified_subtrees, (u32) (modified_task - folder_contents->sorted_folder_tasks));
+
+            num_applied++;
+        }
+    }
+
+    if (!num_applied) {
+        return;
+    }
+
+    // A new assignee nobody was ranked against
+    if (needs_full_sort) {
+        update_cached_data_for_sorted_tasks();
+        sort_tasks_by_precomputed_keys(folder_contents->top_level_tasks.data, folder_contents->top_level_tasks.length);
+
+        apply_task_filter();
+        rebuild_flattened_task_tree();
+    } else {
+        remove_flattened_top_level_subtrees(modified_subtrees);
+        apply_task_filter();
+        insert_flattened_top_level_subtrees(modified_subtrees);
+    }
+
+    printf("Applying %i modified tasks took %fms\n", num_applied, platform_get_delta_time_ms(start));
+}
+
+static void associate_parent_tasks_with_sub_tasks(Folder_Contents* contents) {
+    Array<Folder_Task>& folder_tasks = contents->folder_tasks;
+    Sorted_Folder_Task* sorted_folder_tasks = contents->sorted_folder_tasks;
+    Folder_Id top_parent_id = contents->folder_id;
+
     u32 total_sub_tasks = 0;
 
     // Step 0: determine and populate top level tasks
@@ -999,7 +2738,7 @@ static void associate_parent_tasks_with_sub_tasks(Folder_Id top_parent_id) {
             Folder_Id parent_id = source_task->parent_folder_ids[id_index];
 
             if (parent_id == top_parent_id) {
-                Sorted_Folder_Task** pointer_to_task = lazy_array_add_n_values(top_level_tasks, 1);
+                Sorted_Folder_Task** pointer_to_task = lazy_array_add_n_values(contents->top_level_tasks, 1);
                 *pointer_to_task = folder_task;
             }
         }
@@ -1012,7 +2751,7 @@ static void associate_parent_tasks_with_sub_tasks(Folder_Id top_parent_id) {
 
         for (u32 id_index = 0; id_index < source_task->num_parent_task_ids; id_index++) {
             Task_Id parent_id = source_task->parent_task_ids[id_index];
-            Sorted_Folder_Task* parent_or_null = id_hash_map_get(&id_to_sorted_folder_task, parent_id, hash_id(parent_id));
+            Sorted_Folder_Task* parent_or_null = id_hash_map_get(&contents->id_to_sorted_folder_task, parent_id, hash_id(parent_id));
 
             if (parent_or_null) {
                 parent_or_null->num_sub_tasks++;
@@ -1022,7 +2761,13 @@ static void associate_parent_tasks_with_sub_tasks(Folder_Id top_parent_id) {
     }
 
     // Step 2: allocate space for sub tasks
-    sub_tasks = (Sorted_Folder_Task**) REALLOC(sub_tasks, total_sub_tasks * sizeof(Sorted_Folder_Task*));
+    Sorted_Folder_Task** sub_tasks = NULL;
+
+    if (total_sub_tasks) {
+        sub_tasks = arena_alloc_array<Sorted_Folder_Task*>(contents->arena, total_sub_tasks);
+    }
+
+    contents->sub_tasks = sub_tasks;
     total_sub_tasks = 0;
 
     for (u32 task_index = 0; task_index < folder_tasks.length; task_index++) {
@@ -1045,7 +2790,7 @@ static void associate_parent_tasks_with_sub_tasks(Folder_Id top_parent_id) {
         for (u32 id_index = 0; id_index < source_task->num_parent_task_ids; id_index++) {
             Task_Id parent_id = source_task->parent_task_ids[id_index];
 
-            Sorted_Folder_Task* parent_or_null = id_hash_map_get(&id_to_sorted_folder_task, parent_id, hash_id(parent_id));
+            Sorted_Folder_Task* parent_or_null = id_hash_map_get(&contents->id_to_sorted_folder_task, parent_id, hash_id(parent_id));
 
             if (parent_or_null) {
                 parent_or_null->sub_tasks[parent_or_null->num_sub_tasks++] = folder_task;
@@ -1054,30 +2799,106 @@ static void associate_parent_tasks_with_sub_tasks(Folder_Id top_parent_id) {
     }
 }
 
-void process_folder_contents_data(char* json, u32 data_size, jsmntok_t*& token) {
-    if (id_to_sorted_folder_task.table) {
-        id_hash_map_destroy(&id_to_sorted_folder_task);
-    }
+// The contents are the first allocation of their own arena
+static Folder_Contents* allocate_folder_contents() {
+    Arena arena{};
+
+    Folder_Contents* contents = (Folder_Contents*) arena_calloc(arena, sizeof(Folder_Contents));
+    contents->arena = arena;
+
+    return contents;
+}
+
+void* build_folder_contents(char* json, jsmntok_t* tokens, u32 num_tokens, void* data) {
+    u64 start = platform_get_app_time_precise();
 
-    id_hash_map_init(&id_to_sorted_folder_task);
+    jsmntok_t* data_token = json_find_data_array(json, tokens, num_tokens);
 
-    if (folder_tasks.length < data_size) {
-        folder_tasks.data = (Folder_Task*) REALLOC(folder_tasks.data, sizeof(Folder_Task) * data_size);
-        sorted_folder_tasks = (Sorted_Folder_Task*) REALLOC(sorted_folder_tasks, sizeof(Sorted_Folder_Task) * data_size);
-        flattened_sorted_folder_task_tree.data = (Flattened_Folder_Task*) REALLOC(flattened_sorted_folder_task_tree.data, sizeof(Flattened_Folder_Task) * data_size);
+    if (!data_token) {
+        return NULL;
     }
 
-    folder_tasks.length = 0;
+    u32 data_size = (u32) data_token->size;
 
-    lazy_array_soft_reset(custom_field_values);
-    lazy_array_soft_reset(parent_task_ids);
-    lazy_array_soft_reset(top_level_tasks);
+    Folder_Contents* contents = allocate_folder_contents();
+    contents->folder_id = (Folder_Id) (intptr_t) data;
+    contents->folder_tasks.data = arena_alloc_array<Folder_Task>(contents->arena, MAX(1, data_size));
+    contents->sorted_folder_tasks = arena_alloc_array<Sorted_Folder_Task>(contents->arena, MAX(1, data_size));
+
+    id_hash_map_reserve(&contents->id_to_sorted_folder_task, data_size);
+
+    jsmntok_t* token = data_token + 1;
 
     for (u32 array_index = 0; array_index < data_size; array_index++) {
-        process_folder_contents_data_object(json, token);
+        process_folder_contents_data_object(contents, json, token);
+    }
+
+    associate_parent_tasks_with_sub_tasks(contents);
+    build_task_filter_indexes(contents);
+    build_task_title_index(contents);
+
+    printf("Built %i folder tasks into %i bytes in %.3fms\n", data_size, contents->arena.bytes_reserved, platform_get_delta_time_ms(start));
+
+    return contents;
+}
+
+void free_folder_contents(void* prepared_contents) {
+    Folder_Contents* contents = (Folder_Contents*) prepared_contents;
+
+    if (!contents || contents == &empty_folder_contents) {
+        return;
+    }
+
+    id_hash_map_destroy(&contents->id_to_sorted_folder_task);
+
+    if (contents->top_level_tasks.data) lazy_array_clear(contents->top_level_tasks);
+
+    for (u32 index = 0; index < contents->custom_field_columns.length; index++) {
+        free_custom_field_column(contents->custom_field_columns[index]);
+        FREE(contents->custom_field_columns[index]);
+    }
+
+    if (contents->custom_field_columns.data) lazy_array_clear(contents->custom_field_columns);
+
+    free_task_filter_indexes(contents);
+
+    // The contents themselves are in the arena too
+    Arena arena = contents->arena;
+
+    arena_free(arena);
+}
+
+void publish_folder_contents(void* prepared_contents) {
+    if (!prepared_contents) {
+        return;
+    }
+
+    Folder_Contents* previous_contents = folder_contents;
+
+    folder_contents = (Folder_Contents*) prepared_contents;
+
+    u32 num_tasks = folder_contents->folder_tasks.length;
+
+    if (num_tasks > previous_contents->folder_tasks.length) {
+        flattened_rows_scratch.data = (Flattened_Folder_Task*) REALLOC(flattened_rows_scratch.data, sizeof(Flattened_Folder_Task) * num_tasks);
     }
 
-    associate_parent_tasks_with_sub_tasks(current_folder.id);
+    flattened_rows_scratch.length = 0;
+    flattened_task_tree_assign(flattened_sorted_folder_task_tree, NULL, 0);
+
+    free_folder_contents(previous_contents);
+
+    // Cells of the previous folder were cached by the addresses of its strings
+    glyph_cache_clear();
+
+    // Statuses, assignees and custom fields are picked from the previous folder, status groups are kept
+    lazy_array_soft_reset(task_filter.status_ids);
+    lazy_array_soft_reset(task_filter.assignees);
+    lazy_array_soft_reset(task_filter.custom_field_ranges);
+
+    task_search_buffer[0] = 0;
+
+    apply_task_filter();
 
     has_been_sorted_after_loading = false;
     sort_field = Task_List_Sort_Field_None;
@@ -1089,4 +2910,242 @@ void set_current_folder_id(Folder_Id id) {
 
 void process_current_folder_as_logical() {
     current_folder.custom_columns.length = 0;
-}
\ No newline at end of file
+}
+
+#if BENCHMARK
+static bool flattened_task_tree_equals(Flattened_Folder_Task* expected_rows, u32 num_expected_rows) {
+    if (flattened_sorted_folder_task_tree.length != num_expected_rows) {
+        return false;
+    }
+
+    for (u32 row = 0; row < num_expected_rows; row++) {
+        Flattened_Folder_Task* expected = &expected_rows[row];
+        Flattened_Folder_Task* actual = get_flattened_task(row);
+
+        if (expected->sorted_task != actual->sorted_task || expected->nesting_level != actual->nesting_level) {
+            return false;
+        }
+
+        if (expected->num_visible_sub_tasks != actual->num_visible_sub_tasks) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void task_list_benchmark() {
+    const u32 sizes[] = { 10000, 100000, 1000000 };
+    const u32 title_length = 16;
+
+    Folder_Contents* previous_contents = folder_contents;
+    Flattened_Task_Tree previous_tree = flattened_sorted_folder_task_tree;
+    Array<Flattened_Folder_Task> previous_rows_scratch = flattened_rows_scratch;
+
+    flattened_sorted_folder_task_tree = {};
+    flattened_rows_scratch = {};
+
+    for (u32 size : sizes) {
+        Folder_Contents* contents = allocate_folder_contents();
+        contents->folder_tasks.data = (Folder_Task*) arena_calloc(contents->arena, sizeof(Folder_Task) * size);
+        contents->folder_tasks.length = size;
+        contents->sorted_folder_tasks = (Sorted_Folder_Task*) arena_calloc(contents->arena, sizeof(Sorted_Folder_Task) * size);
+        contents->sub_tasks = arena_alloc_array<Sorted_Folder_Task*>(contents->arena, size);
+
+        char* titles = arena_alloc_array<char>(contents->arena, size * title_length);
+
+        // Every fourth task is a top level task with the next three as sub tasks, half of them expanded.
+        // Titles share long prefixes so the text keys have to be refined
+        for (u32 index = 0; index < size; index++) {
+            Folder_Task* task = &contents->folder_tasks[index];
+            Sorted_Folder_Task* sorted_task = &contents->sorted_folder_tasks[index];
+
+            task->id = (Task_Id) (index * 2654435761u);
+            task->status_group = index % 5 ? Status_Group_Active : Status_Group_Completed;
+            task->title.start = titles + index * title_length;
+            task->title.length = (u32) snprintf(task->title.start, title_length, "%s %u", index % 3 ? "Backlog" : "Bug", (index * 7919u) % size);
+
+            sorted_task->id = task->id;
+            sorted_task->source_task = task;
+
+            if (index % 4 == 0) {
+                sorted_task->sub_tasks = contents->sub_tasks + index;
+                sorted_task->num_sub_tasks = MIN(3, size - index - 1);
+                sorted_task->is_expanded = index % 8 == 0;
+
+                *lazy_array_add_n_values(contents->top_level_tasks, 1) = sorted_task;
+            } else {
+                contents->sub_tasks[index - 1] = sorted_task;
+            }
+        }
+
+        flattened_rows_scratch.data = (Flattened_Folder_Task*) REALLOC(flattened_rows_scratch.data, sizeof(Flattened_Folder_Task) * size);
+
+        folder_contents = contents;
+        sort_field = Task_List_Sort_Field_Title;
+        sort_direction = Sort_Direction_Normal;
+
+        build_task_filter_indexes(contents);
+        apply_task_filter();
+
+        u32 num_top_level_tasks = contents->top_level_tasks.length;
+
+        Sorted_Folder_Task** unsorted = (Sorted_Folder_Task**) MALLOC(sizeof(Sorted_Folder_Task*) * num_top_level_tasks);
+        Sorted_Folder_Task** sorted_on_one_thread = (Sorted_Folder_Task**) MALLOC(sizeof(Sorted_Folder_Task*) * num_top_level_tasks);
+        Flattened_Folder_Task* flattened_on_one_thread = (Flattened_Folder_Task*) MALLOC(sizeof(Flattened_Folder_Task) * size);
+        u32 rows_on_one_thread = 0;
+
+        memcpy(unsorted, contents->top_level_tasks.data, sizeof(Sorted_Folder_Task*) * num_top_level_tasks);
+
+        float sort_time[2];
+        float flatten_time[2];
+        bool same_output = true;
+
+        for (u32 parallel = 0; parallel < 2; parallel++) {
+            parallel_task_list_enabled = parallel == 1;
+
+            memcpy(contents->top_level_tasks.data, unsorted, sizeof(Sorted_Folder_Task*) * num_top_level_tasks);
+
+            u64 start = platform_get_app_time_precise();
+
+            update_cached_data_for_sorted_tasks();
+            sort_tasks_by_precomputed_keys(contents->top_level_tasks.data, num_top_level_tasks);
+
+            sort_time[parallel] = platform_get_delta_time_ms(start);
+
+            start = platform_get_app_time_precise();
+
+            rebuild_flattened_task_tree();
+
+            flatten_time[parallel] = platform_get_delta_time_ms(start);
+
+            if (!parallel) {
+                memcpy(sorted_on_one_thread, contents->top_level_tasks.data, sizeof(Sorted_Folder_Task*) * num_top_level_tasks);
+                memcpy(flattened_on_one_thread, flattened_rows_scratch.data, sizeof(Flattened_Folder_Task) * flattened_rows_scratch.length);
+                rows_on_one_thread = flattened_rows_scratch.length;
+            } else {
+                same_output &= memcmp(sorted_on_one_thread, contents->top_level_tasks.data, sizeof(Sorted_Folder_Task*) * num_top_level_tasks) == 0;
+                same_output &= flattened_task_tree_equals(flattened_on_one_thread, rows_on_one_thread);
+            }
+        }
+
+        // Expands and collapses tasks spread over the whole tree, then checks against a full rebuild
+        const u32 num_toggles = 200;
+
+        u64 start = platform_get_app_time_precise();
+
+        for (u32 toggle = 0; toggle < num_toggles; toggle++) {
+            toggle_flattened_task_expansion((u32) (((u64) toggle * 2654435761u) % flattened_sorted_folder_task_tree.length));
+        }
+
+        float toggle_time = platform_get_delta_time_ms(start);
+
+        start = platform_get_app_time_precise();
+
+        rebuild_flattened_task_tree();
+
+        float rebuild_time = platform_get_delta_time_ms(start);
+
+        bool same_after_toggles = flattened_task_tree_equals(flattened_rows_scratch.data, flattened_rows_scratch.length);
+
+        // Every fifth task is completed, some of them are parents of active tasks which have to stay visible
+        u32 previous_status_groups = task_filter.status_groups;
+
+        task_filter.status_groups = 1 << Status_Group_Completed;
+
+        start = platform_get_app_time_precise();
+
+        apply_task_filter();
+
+        float filter_time = platform_get_delta_time_ms(start);
+
+        bool parents_are_visible = true;
+
+        for (u32 task_index = 0; task_index < size; task_index++) {
+            if (!bitmap_test(contents->visible_tasks, task_index)) {
+                continue;
+            }
+
+            for (u32 parent = contents->parent_task_offsets[task_index]; parent < contents->parent_task_offsets[task_index + 1]; parent++) {
+                parents_are_visible &= bitmap_test(contents->visible_tasks, contents->parent_task_indices[parent]);
+            }
+        }
+
+        task_filter.status_groups = previous_status_groups;
+
+        start = platform_get_app_time_precise();
+
+        build_task_title_index(contents);
+
+        float index_time = platform_get_delta_time_ms(start);
+
+        const char* search_query = "BUG 12";
+
+        strcpy(task_search_buffer, search_query);
+
+        start = platform_get_app_time_precise();
+
+        apply_task_filter();
+
+        float search_time = platform_get_delta_time_ms(start);
+
+        // Matching tasks are left in the first scratch bitmap
+        bool same_search_output = true;
+
+        for (u32 task_index = 0; task_index < size; task_index++) {
+            Folder_Task* task = &contents->folder_tasks[task_index];
+
+            u32 query_length = (u32) strlen(search_query);
+            bool contains_query = false;
+
+            for (u32 position = 0; !contains_query && position + query_length <= task->title.length; position++) {
+                u32 matched = 0;
+
+                while (matched < query_length && fold_ascii_case(task->title.start[position + matched]) == fold_ascii_case(search_query[matched])) {
+                    matched++;
+                }
+
+                contains_query = matched == query_length;
+            }
+
+            bool expected = task->status_group == Status_Group_Active && contains_query;
+
+            same_search_output &= bitmap_test(contents->filter_scratch, task_index) == expected;
+        }
+
+        task_search_buffer[0] = 0;
+
+        printf("Task list benchmark on %u tasks (%u rows): sort 1 thread %.3fms, %u threads %.3fms; flatten %.3fms, %.3fms, %s\n",
+               size, rows_on_one_thread, sort_time[0], platform_get_num_parallel_threads(), sort_time[1], flatten_time[0], flatten_time[1],
+               same_output ? "same output" : "OUTPUT MISMATCH"
+        );
+
+        printf("    %u expand/collapse toggles %.3fms (%.4fms each), full rebuild %.3fms, %s\n",
+               num_toggles, toggle_time, toggle_time / num_toggles, rebuild_time, same_after_toggles ? "same output" : "OUTPUT MISMATCH"
+        );
+
+        printf("    status group filter %.3fms, %s; title index %.3fms, search '%s' %.3fms, %s\n",
+               filter_time, parents_are_visible ? "parents visible" : "MISSING PARENTS",
+               index_time, search_query, search_time, same_search_output ? "same output" : "OUTPUT MISMATCH"
+        );
+
+        FREE(unsorted);
+        FREE(sorted_on_one_thread);
+        FREE(flattened_on_one_thread);
+
+        free_folder_contents(contents);
+    }
+
+    if (flattened_rows_scratch.data) {
+        FREE(flattened_rows_scratch.data);
+    }
+
+    flattened_task_tree_free(flattened_sorted_folder_task_tree);
+
+    parallel_task_list_enabled = true;
+    folder_contents = previous_contents;
+    flattened_sorted_folder_task_tree = previous_tree;
+    flattened_rows_scratch = previous_rows_scratch;
+    sort_field = Task_List_Sort_Field_None;
+}
+#endif
@@ -1,5 +1,13 @@
 void draw_task_list();
 void set_current_folder_id(Folder_Id id);
 void process_current_folder_as_logical();
-void process_folder_contents_data(char* json, u32 data_size, jsmntok_t*& token);
-void process_folder_header_data(char* json, u32 data_size, jsmntok_t*& token);
\ No newline at end of file
+void* build_folder_contents(char* json, jsmntok_t* tokens, u32 num_tokens, void* data);
+void publish_folder_contents(void* prepared_contents);
+void free_folder_contents(void* prepared_contents);
+void process_folder_header_data(char* json, u32 data_size, jsmntok_t*& token);
+void process_task_list_modification_data(char* json, u32 data_size, jsmntok_t*& token);
+
+#if BENCHMARK
+// Sorts and flattens synthetic task trees of 10k, 100k and 1M tasks on one and on all cores, prints the timings
+void task_list_benchmark();
+#endif
@@ -8,6 +8,7 @@
 #include "workflows.h"
 #include "ui.h"
 #include "custom_fields.h"
+#include "arena.h"
 
 #include <imgui.h>
 #include <cstdlib>
@@ -36,6 +37,9 @@ static Array<User_Handle> filtered_users{};
 static Lazy_Array<Rich_Text_String, 64> comment_strings{};
 static Lazy_Array<char, 512> comment_chars{};
 
+// Strings of the current task, copied out of the response and replaced together with the task
+static Arena current_task_strings{};
+
 static const float status_picker_row_height = 50.0f;
 static const float assignee_avatar_side = 32.0f;
 
@@ -127,58 +131,17 @@ static u32 change_color_luminance(u32 in_color, float luminance) {
     return ImGui::ColorConvertFloat4ToU32({ rgb_out.r, rgb_out.g, rgb_out.b, 1.0f });
 }
 
-static char* string_contains_substring_ignore_case(String string, char* query_lowercase) {
-    static const u32 buffer_length = 512;
-    static char string_buffer[buffer_length];
-
-    assert(string.length < buffer_length);
-
-    for (u32 index = 0; index < string.length; index++) {
-        string_buffer[index] = (char) tolower(string.start[index]);
-    }
-
-    string_buffer[string.length] = 0;
-
-    return string_in_substring(string_buffer, query_lowercase, string.length);
-}
-
 static void update_user_search(char* query) {
     u64 start_time = platform_get_app_time_precise();
 
-    if (!filtered_users.data) {
-        filtered_users.data = (User_Handle*) MALLOC(sizeof(User_Handle) * users.length);
-    }
-
-    filtered_users.length = 0;
-
-    u32 query_length = (u32) strlen(query);
-    bool add_all = query_length == 0;
-
-    char* query_lowercase = (char*) talloc(query_length + 1);
-
-    // Query to lowercase
-    {
-        for (u32 index = 0; index < query_length; index++) {
-            query_lowercase[index] = (char) tolower(query[index]);
-        }
-
-        query_lowercase[query_length] = 0;
-    }
-
-    for (User* it = users.data; it != users.data + users.length; it++) {
-        User_Handle handle = User_Handle(it - users.data);
-
-        if (add_all) {
-            filtered_users[filtered_users.length++] = handle;
-
-            continue;
-        }
-
-        char* first_name_contains_query = string_contains_substring_ignore_case(it->first_name, query_lowercase);
-        char* last_name_contains_query = string_contains_substring_ignore_case(it->last_name, query_lowercase);
+    if (strlen(query)) {
+        fuzzy_search_users(query, &filtered_users);
+    } else {
+        filtered_users.data = (User_Handle*) REALLOC(filtered_users.data, sizeof(User_Handle) * MAX(1, users.length));
+        filtered_users.length = 0;
 
-        if (first_name_contains_query || last_name_contains_query) {
-            filtered_users[filtered_users.length++] = handle;
+        for (User* it = users.data; it != users.data + users.length; it++) {
+            filtered_users[filtered_users.length++] = User_Handle(it - users.data);
         }
     }
 
@@ -442,7 +405,7 @@ static void draw_folder_picker_contents(bool set_focus) {
     static Array<Folder_Tree_Node*> search_result{};
 
     if (ImGui::InputText("##folder_picker_search", search_buffer, search_buffer_size)) {
-        folder_tree_search(search_buffer, &search_result);
+        folder_tree_search(search_buffer, &search_result, true);
     }
 
     if (set_focus) {
@@ -1614,30 +1577,53 @@ static void find_and_request_missing_folders_if_necessary() {
     }
 }
 
-typedef void (*Id_Processor)(char* json, jsmntok_t* token, s32& id);
+typedef void (*Id_Array_Processor)(char* json, jsmntok_t* tokens, u32 num_tokens, s32* ids);
 
 template <typename T>
 static void token_array_to_id_array(char* json,
                                     jsmntok_t*& token,
                                     Array<T>& id_array,
-                                    Id_Processor id_processor) {
+                                    Id_Array_Processor id_array_processor) {
     assert(token->type == JSMN_ARRAY);
 
     if (id_array.length < token->size) {
         id_array.data = (T*) REALLOC(id_array.data, sizeof(T) * token->size);
     }
 
-    id_array.length = 0;
-
-    for (u32 array_index = 0, length = (u32) token->size; array_index < length; array_index++) {
-        jsmntok_t* id_token = ++token;
+    id_array.length = (u32) token->size;
 
-        assert(id_token->type == JSMN_STRING);
+    id_array_processor(json, token + 1, id_array.length, id_array.data);
 
-        id_processor(json, id_token, id_array[id_array.length++]);
-    }
+    token += id_array.length;
 }
 
+#define CUSTOM_FIELD_VALUE_KEYS(KEY) \
+    KEY(Custom_Field_Value_Key_Id, "id") \
+    KEY(Custom_Field_Value_Key_Value, "value")
+
+DEFINE_JSON_KEYS(Custom_Field_Value_Key, json_to_custom_field_value_key, CUSTOM_FIELD_VALUE_KEYS)
+
+#define COMMENT_KEYS(KEY) \
+    KEY(Comment_Key_Text, "text") \
+    KEY(Comment_Key_Author_Id, "authorId")
+
+DEFINE_JSON_KEYS(Comment_Key, json_to_comment_key, COMMENT_KEYS)
+
+#define TASK_KEYS(KEY) \
+    KEY(Task_Key_Id, "id") \
+    KEY(Task_Key_Title, "title") \
+    KEY(Task_Key_Description, "description") \
+    KEY(Task_Key_Permalink, "permalink") \
+    KEY(Task_Key_Custom_Status_Id, "customStatusId") \
+    KEY(Task_Key_Responsible_Ids, "responsibleIds") \
+    KEY(Task_Key_Author_Ids, "authorIds") \
+    KEY(Task_Key_Parent_Ids, "parentIds") \
+    KEY(Task_Key_Inherited_Custom_Column_Ids, "inheritedCustomColumnIds") \
+    KEY(Task_Key_Super_Parent_Ids, "superParentIds") \
+    KEY(Task_Key_Custom_Fields, "customFields")
+
+DEFINE_JSON_KEYS(Task_Key, json_to_task_key, TASK_KEYS)
+
 void process_task_custom_field_value(Custom_Field_Value* custom_field_value, char* json, jsmntok_t*& token) {
     jsmntok_t* object_token = token++;
 
@@ -1650,13 +1636,21 @@ void process_task_custom_field_value(Custom_Field_Value* custom_field_value, cha
 
         jsmntok_t* next_token = token;
 
-        if (json_string_equals(json, property_token, "id")) {
-            json_token_to_right_part_of_id16(json, next_token, custom_field_value->field_id);
-        } else if (json_string_equals(json, property_token, "value")) {
-            json_token_to_string(json, next_token, custom_field_value->value);
-        } else {
-            eat_json(token);
-            token--;
+        switch (json_to_custom_field_value_key(json, property_token)) {
+            case Custom_Field_Value_Key_Id: {
+                json_token_to_right_part_of_id16(json, next_token, custom_field_value->field_id);
+                break;
+            }
+
+            case Custom_Field_Value_Key_Value: {
+                json_token_to_string(json, next_token, custom_field_value->value);
+                break;
+            }
+
+            default: {
+                json_skip(token);
+                token--;
+            }
         }
     }
 }
@@ -1687,30 +1681,38 @@ void process_task_comments_data(char* json, u32 data_size, jsmntok_t*& token) {
 
             jsmntok_t* next_token = token;
 
-            if (json_string_equals(json, property_token, "text")) {
-                String comment_text{};
+            switch (json_to_comment_key(json, property_token)) {
+                case Comment_Key_Text: {
+                    String comment_text{};
 
-                json_token_to_string(json, next_token, comment_text);
+                    json_token_to_string(json, next_token, comment_text);
 
-                temporary_storage_mark();
+                    temporary_storage_mark();
 
-                Rich_Text temporary_text = parse_string_into_temporary_rich_text(comment_text);
-                Rich_Text_String* persisted_strings = lazy_array_add_n_values(comment_strings, temporary_text.rich.length);
-                char* persisted_chars = lazy_array_add_n_values(comment_chars, temporary_text.raw.length);
+                    Rich_Text temporary_text = parse_string_into_temporary_rich_text(comment_text);
+                    Rich_Text_String* persisted_strings = lazy_array_add_n_values(comment_strings, temporary_text.rich.length);
+                    char* persisted_chars = lazy_array_add_n_values(comment_chars, temporary_text.raw.length);
 
-                // We'll fix up the data pointers later
-                memcpy(persisted_chars, temporary_text.raw.start, temporary_text.raw.length);
-                memcpy(persisted_strings, temporary_text.rich.data, temporary_text.rich.length * sizeof(Rich_Text_String));
+                    // We'll fix up the data pointers later
+                    memcpy(persisted_chars, temporary_text.raw.start, temporary_text.raw.length);
+                    memcpy(persisted_strings, temporary_text.rich.data, temporary_text.rich.length * sizeof(Rich_Text_String));
 
-                comment->text.rich.length = temporary_text.rich.length;
-                comment->text.raw.length = temporary_text.raw.length;
+                    comment->text.rich.length = temporary_text.rich.length;
+                    comment->text.raw.length = temporary_text.raw.length;
 
-                temporary_storage_reset();
-            } else if (json_string_equals(json, property_token, "authorId")) {
-                json_token_to_id8(json, next_token, comment->author);
-            } else {
-                eat_json(token);
-                token--;
+                    temporary_storage_reset();
+                    break;
+                }
+
+                case Comment_Key_Author_Id: {
+                    json_token_to_id8(json, next_token, comment->author);
+                    break;
+                }
+
+                default: {
+                    json_skip(token);
+                    token--;
+                }
             }
         }
     }
@@ -1748,6 +1750,8 @@ void parse_and_update_task_description(String description) {
 }
 
 void process_task_data(char* json, u32 data_size, jsmntok_t*& token) {
+    arena_free(current_task_strings);
+
     // The task stopped existing?
     if (data_size == 0) {
         current_task = {};
@@ -1770,57 +1774,96 @@ void process_task_data(char* json, u32 data_size, jsmntok_t*& token) {
 
         jsmntok_t* next_token = token;
 
-#define IS_PROPERTY(s) json_string_equals(json, property_token, (s))
 #define TOKEN_TO_STRING(s) json_token_to_string(json, next_token, (s))
 
-        if (IS_PROPERTY("id")) {
-            json_token_to_right_part_of_id16(json, next_token, current_task.id);
-        } else if (IS_PROPERTY("title")) {
-            TOKEN_TO_STRING(current_task.title);
-        } else if (IS_PROPERTY("description")) {
-            TOKEN_TO_STRING(description);
-        } else if (IS_PROPERTY("permalink")) {
-            TOKEN_TO_STRING(current_task.permalink);
-        } else if (IS_PROPERTY("customStatusId")) {
-            json_token_to_right_part_of_id16(json, next_token, current_task.status_id);
-        } else if (IS_PROPERTY("responsibleIds")) {
-            token_array_to_id_array(json, token, current_task.assignees, json_token_to_id8);
-        } else if (IS_PROPERTY("authorIds")) {
-            token_array_to_id_array(json, token, current_task.authors, json_token_to_id8);
-        } else if (IS_PROPERTY("parentIds")) {
-            token_array_to_id_array(json, token, current_task.parents, json_token_to_right_part_of_id16);
-        } else if (IS_PROPERTY("inheritedCustomColumnIds")) {
-            token_array_to_id_array(json, token, current_task.inherited_custom_fields, json_token_to_right_part_of_id16);
-        } else if (IS_PROPERTY("superParentIds")) {
-            token_array_to_id_array(json, token, current_task.super_parents, json_token_to_right_part_of_id16);
-        } else if (IS_PROPERTY("customFields")) {
-            assert(next_token->type == JSMN_ARRAY);
-
-            token++;
-
-            if (current_task.custom_field_values.length < next_token->size) {
-                current_task.custom_field_values.data = (Custom_Field_Value*) REALLOC(
-                        current_task.custom_field_values.data,
-                        sizeof(Custom_Field_Value) * next_token->size
-                );
+        switch (json_to_task_key(json, property_token)) {
+            case Task_Key_Id: {
+                json_token_to_right_part_of_id16(json, next_token, current_task.id);
+                break;
             }
 
-            current_task.custom_field_values.length = 0;
+            case Task_Key_Title: {
+                TOKEN_TO_STRING(current_task.title);
 
-            for (u32 field_index = 0; field_index < next_token->size; field_index++) {
-                Custom_Field_Value* value = &current_task.custom_field_values[current_task.custom_field_values.length++];
+                current_task.title = arena_copy_string(current_task_strings, current_task.title);
+                break;
+            }
 
-                process_task_custom_field_value(value, json, token);
+            case Task_Key_Description: {
+                TOKEN_TO_STRING(description);
+                break;
             }
 
-            token--;
-        } else {
-            eat_json(token);
-            token--;
+            case Task_Key_Permalink: {
+                TOKEN_TO_STRING(current_task.permalink);
+
+                current_task.permalink = arena_copy_string(current_task_strings, current_task.permalink);
+                break;
+            }
+
+            case Task_Key_Custom_Status_Id: {
+                json_token_to_right_part_of_id16(json, next_token, current_task.status_id);
+                break;
+            }
+
+            case Task_Key_Responsible_Ids: {
+                token_array_to_id_array(json, token, current_task.assignees, json_tokens_to_id8_array);
+                break;
+            }
+
+            case Task_Key_Author_Ids: {
+                token_array_to_id_array(json, token, current_task.authors, json_tokens_to_id8_array);
+                break;
+            }
+
+            case Task_Key_Parent_Ids: {
+                token_array_to_id_array(json, token, current_task.parents, json_tokens_to_right_part_of_id16_array);
+                break;
+            }
+
+            case Task_Key_Inherited_Custom_Column_Ids: {
+                token_array_to_id_array(json, token, current_task.inherited_custom_fields, json_tokens_to_right_part_of_id16_array);
+                break;
+            }
+
+            case Task_Key_Super_Parent_Ids: {
+                token_array_to_id_array(json, token, current_task.super_parents, json_tokens_to_right_part_of_id16_array);
+                break;
+            }
+
+            case Task_Key_Custom_Fields: {
+                assert(next_token->type == JSMN_ARRAY);
+
+                token++;
+
+                if (current_task.custom_field_values.length < next_token->size) {
+                    current_task.custom_field_values.data = (Custom_Field_Value*) REALLOC(
+                            current_task.custom_field_values.data,
+                            sizeof(Custom_Field_Value) * next_token->size
+                    );
+                }
+
+                current_task.custom_field_values.length = 0;
+
+                for (u32 field_index = 0; field_index < next_token->size; field_index++) {
+                    Custom_Field_Value* value = &current_task.custom_field_values[current_task.custom_field_values.length++];
+
+                    process_task_custom_field_value(value, json, token);
+
+                    value->value = arena_copy_string(current_task_strings, value->value);
+                }
+
+                token--;
+                break;
+            }
+
+            default: {
+                json_skip(token);
+                token--;
+            }
         }
     }
 
-#undef IS_PROPERTY
 #undef TOKEN_TO_STRING
 
     parse_and_update_task_description(description);
@@ -1,41 +1,208 @@
 #include <cstdlib>
 #include "temporary_storage.h"
 
-static const u32 available_memory_bytes = 1024 * 1024 * 8;
+#if DEBUG_MEMORY
+#include <mutex>
+#endif
 
-static char pointer_initial[available_memory_bytes];
-static char* pointer_current = pointer_initial;
-static char* pointer_previous = nullptr;
-static char* pointer_mark = nullptr;
+static const u32 temporary_storage_block_size = 1024 * 1024 * 8;
+static const u32 temporary_storage_alignment = 16;
+static const u32 max_temporary_storage_marks = 32;
+
+struct Temporary_Storage_Block {
+    Temporary_Storage_Block* next;
+    char* data; // Aligned
+    u32 size;
+    u32 used;
+
+#if DEBUG_MEMORY
+    Temporary_Storage_Block* next_registered;
+#endif
+};
+
+struct Temporary_Storage_Mark {
+    Temporary_Storage_Block* block;
+    u32 used;
+    u32 bytes_in_previous_blocks;
+};
+
+// Every thread has its own chain, talloc and the rest pick the one of the calling thread
+struct Temporary_Storage {
+    Temporary_Storage_Block* first_block;
+    Temporary_Storage_Block* current_block;
+    u32 bytes_in_previous_blocks; // Used by the blocks before the current one
+    char* last_allocation; // Only while it can still grow in place
+
+    Temporary_Storage_Mark marks[max_temporary_storage_marks];
+    u32 num_marks;
+
+    u32 frame_peak_bytes_used;
+    u32 frame_overflows;
+    Temporary_Storage_Stats stats;
+};
+
+static thread_local Temporary_Storage storage{};
+
+#if DEBUG_MEMORY
+// Blocks of all threads, to tell a pointer into another thread's storage from memory which is not temporary at all
+static std::mutex registered_blocks_mutex;
+static Temporary_Storage_Block* registered_blocks = nullptr;
+#endif
+
+static inline u32 align_temporary_size(u32 size) {
+    return (size + temporary_storage_alignment - 1) & ~(temporary_storage_alignment - 1);
+}
+
+static Temporary_Storage_Block* allocate_temporary_storage_block(u32 min_size) {
+    u32 size = MAX(min_size, temporary_storage_block_size);
+
+    Temporary_Storage_Block* block = (Temporary_Storage_Block*) MALLOC(sizeof(Temporary_Storage_Block) + size + temporary_storage_alignment - 1);
+    block->next = nullptr;
+    block->data = (char*) (((uintptr_t) (block + 1) + temporary_storage_alignment - 1) & ~(uintptr_t) (temporary_storage_alignment - 1));
+    block->size = size;
+    block->used = 0;
+
+#if DEBUG_MEMORY
+    {
+        std::lock_guard<std::mutex> lock(registered_blocks_mutex);
+
+        block->next_registered = registered_blocks;
+        registered_blocks = block;
+    }
+#endif
+
+    storage.stats.bytes_reserved += size;
+    storage.stats.num_blocks++;
+
+    return block;
+}
+
+static inline Temporary_Storage_Block* get_current_block() {
+    if (!storage.current_block) {
+        storage.first_block = allocate_temporary_storage_block(0);
+        storage.current_block = storage.first_block;
+    }
+
+    return storage.current_block;
+}
+
+static inline void update_frame_peak_bytes_used() {
+    u32 bytes_used = storage.bytes_in_previous_blocks + storage.current_block->used;
+
+    if (bytes_used > storage.frame_peak_bytes_used) {
+        storage.frame_peak_bytes_used = bytes_used;
+    }
+}
+
+#if DEBUG_MEMORY
+// Released memory is overwritten, so reading through a pointer which outlived its frame or mark is noticeable
+static void poison_temporary_storage(Temporary_Storage_Block* from_block, u32 from_used) {
+    for (Temporary_Storage_Block* block = from_block; block; block = block->next) {
+        u32 start = block == from_block ? from_used : 0;
+
+        memset(block->data + start, 0xCD, block->used - start);
+
+        if (block == storage.current_block) {
+            break;
+        }
+    }
+}
+#endif
+
+// Blocks after the current one are not in use, so the next one is taken if it is large enough.
+// Otherwise a new block is chained in front of it and kept for the following frames
+static void move_to_block_with_space(u32 size) {
+    Temporary_Storage_Block* next = storage.current_block->next;
+
+    if (!next || next->size < size) {
+        Temporary_Storage_Block* block = allocate_temporary_storage_block(size);
+        block->next = next;
+
+        storage.current_block->next = block;
+        next = block;
+
+        printf("Temporary storage grew to %i blocks, %i bytes\n", storage.stats.num_blocks, storage.stats.bytes_reserved);
+    }
+
+    storage.frame_overflows++;
+    storage.bytes_in_previous_blocks += storage.current_block->used;
+
+    next->used = 0;
+    storage.current_block = next;
+}
 
 void clear_temporary_storage() {
-    pointer_current = pointer_initial;
+    assert(storage.num_marks == 0);
+
+    storage.stats.peak_bytes_used = storage.frame_peak_bytes_used;
+    storage.stats.num_overflows = storage.frame_overflows;
+
+    storage.frame_peak_bytes_used = 0;
+    storage.frame_overflows = 0;
+
+    storage.num_marks = 0;
+    storage.bytes_in_previous_blocks = 0;
+    storage.last_allocation = nullptr;
+
+    // Threads which never allocated don't get a block, talloc creates the first one
+    if (!storage.first_block) {
+        return;
+    }
+
+#if DEBUG_MEMORY
+    poison_temporary_storage(storage.first_block, 0);
+#endif
+
+    storage.current_block = storage.first_block;
+    storage.current_block->used = 0;
 }
 
 void temporary_storage_mark() {
-    pointer_mark = pointer_current;
+    assert(storage.num_marks < max_temporary_storage_marks);
+
+    Temporary_Storage_Mark* mark = &storage.marks[storage.num_marks++];
+    mark->block = get_current_block();
+    mark->used = storage.current_block->used;
+    mark->bytes_in_previous_blocks = storage.bytes_in_previous_blocks;
+
+    // Growing an allocation made before the mark in place would overlap the allocations made after it
+    storage.last_allocation = nullptr;
 }
 
 void temporary_storage_reset() {
-    pointer_current = pointer_mark;
+    assert(storage.num_marks > 0);
+
+    Temporary_Storage_Mark* mark = &storage.marks[--storage.num_marks];
+
+#if DEBUG_MEMORY
+    poison_temporary_storage(mark->block, mark->used);
+#endif
+
+    storage.current_block = mark->block;
+    storage.current_block->used = mark->used;
+    storage.bytes_in_previous_blocks = mark->bytes_in_previous_blocks;
+    storage.last_allocation = nullptr;
 }
 
 void* talloc(u32 size) {
-    if ((pointer_current - pointer_initial) + size > available_memory_bytes) {
-        void* heap_pointer = MALLOC(size);
+    Temporary_Storage_Block* block = get_current_block();
+
+    size = align_temporary_size(size);
 
-        printf("Requested allocation of %i bytes which exceeded %i size of temporary storage, %p was allocated on heap\n",
-               size, available_memory_bytes, heap_pointer);
+    if (block->used + size > block->size) {
+        move_to_block_with_space(size);
 
-        return heap_pointer;
+        block = storage.current_block;
     }
 
-    size = (size + 4) & ~0x03; // Align, &~0x03 simply sets two trailing bits to 0
+    char* result = block->data + block->used;
 
-    pointer_previous = pointer_current;
-    pointer_current += size;
+    block->used += size;
+    storage.last_allocation = result;
 
-    return pointer_previous;
+    update_frame_peak_bytes_used();
+
+    return result;
 }
 
 void* trealloc(void* pointer, u32 previous_size, u32 new_size) {
@@ -43,11 +210,83 @@ void* trealloc(void* pointer, u32 previous_size, u32 new_size) {
         return talloc(new_size);
     }
 
-    if (pointer == pointer_previous) {
-        pointer_current = pointer_previous;
-    } else {
-        memcpy(pointer_current, pointer, previous_size);
+    TEMPORARY_STORAGE_CHECK(pointer);
+
+    // The latest allocation grows in place while its block has space
+    if (pointer == storage.last_allocation) {
+        u32 offset = (u32) (storage.last_allocation - storage.current_block->data);
+        u32 size = align_temporary_size(new_size);
+
+        if (offset + size <= storage.current_block->size) {
+            storage.current_block->used = offset + size;
+
+            update_frame_peak_bytes_used();
+
+            return pointer;
+        }
     }
 
-    return talloc(new_size);
+    void* result = talloc(new_size);
+
+    memcpy(result, pointer, MIN(previous_size, new_size));
+
+    return result;
+}
+
+Temporary_Storage_Stats get_temporary_storage_stats() {
+    return storage.stats;
+}
+
+#if DEBUG_MEMORY
+static bool is_in_registered_block(const char* address) {
+    std::lock_guard<std::mutex> lock(registered_blocks_mutex);
+
+    for (Temporary_Storage_Block* block = registered_blocks; block; block = block->next_registered) {
+        if (address >= block->data && address < block->data + block->size) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void check_temporary_pointer(const char* file, u32 line, const void* pointer, bool must_be_temporary) {
+    const char* address = (const char*) pointer;
+    bool is_after_current_block = false;
+
+    for (Temporary_Storage_Block* block = storage.first_block; block; block = block->next) {
+        if (address >= block->data && address < block->data + block->size) {
+            if (!is_after_current_block && address < block->data + block->used) {
+                return;
+            }
+
+            printf("%s:%i: temporary pointer %p outlived its frame or mark\n", file, line, pointer);
+            assert(!"Temporary pointer outlived its frame");
+
+            return;
+        }
+
+        is_after_current_block |= block == storage.current_block;
+    }
+
+    if (is_in_registered_block(address)) {
+        printf("%s:%i: temporary pointer %p was allocated on another thread\n", file, line, pointer);
+        assert(!"Temporary pointer crossed threads");
+
+        return;
+    }
+
+    if (must_be_temporary) {
+        printf("%s:%i: pointer %p is not temporary storage\n", file, line, pointer);
+        assert(!"Pointer is not temporary storage");
+    }
+}
+
+void temporary_storage_check(const char* file, u32 line, const void* pointer) {
+    check_temporary_pointer(file, line, pointer, true);
+}
+
+void temporary_storage_check_if_temporary(const char* file, u32 line, const void* pointer) {
+    check_temporary_pointer(file, line, pointer, false);
 }
+#endif
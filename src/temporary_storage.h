@@ -1,8 +1,24 @@
+#pragma once
+
 #include <cstddef>
 #include "common.h"
 
+// Per frame allocations, everything is freed at once by clear_temporary_storage.
+// Memory comes from a chain of blocks which grows when a frame needs more and is reused by the following frames.
+// Allocations are 16 byte aligned. Marks nest, every temporary_storage_reset returns to the latest mark.
+// Every thread has its own storage. Worker threads clear theirs before every piece of work, the main thread every frame
+struct Temporary_Storage_Stats {
+    u32 peak_bytes_used; // During the previous frame
+    u32 num_overflows; // Allocations during the previous frame which did not fit into the block they were made in
+    u32 bytes_reserved;
+    u32 num_blocks;
+};
+
 void clear_temporary_storage();
 void temporary_storage_mark();
 void temporary_storage_reset();
 void* talloc(u32 size);
-void* trealloc(void* pointer, u32 previous_size, u32 new_size);
\ No newline at end of file
+void* trealloc(void* pointer, u32 previous_size, u32 new_size);
+Temporary_Storage_Stats get_temporary_storage_stats();
+
+// TEMPORARY_STORAGE_CHECK and TEMPORARY_STORAGE_CHECK_IF_TEMPORARY are in common.h, next to the other DEBUG_MEMORY helpers
@@ -1,21 +1,61 @@
 #include <cstddef>
 #include <cstdio>
 #include <cstdlib>
+#include <mutex>
 #include "common.h"
 
+// Every live block is found by its pointer in an open addressed table, so logging an allocation or a free
+//  does not depend on the number of live blocks. Blocks are also summed up per call site (file:line)
 struct Memory_Record {
-    void* pointer;
+    void* pointer; // NULL for empty slots
     size_t size;
-    u32 line;
-    const char* function;
+    u32 site;
+};
+
+struct Allocation_Site {
     const char* file;
+    const char* function;
+    u32 line;
+    u32 hash;
+
+    size_t live_bytes;
+    size_t peak_bytes;
+    u32 live_blocks;
+    u32 num_allocations;
+};
+
+enum Memory_Sort_Column {
+    Memory_Sort_Column_Site,
+    Memory_Sort_Column_Live_Bytes,
+    Memory_Sort_Column_Peak_Bytes,
+    Memory_Sort_Column_Live_Blocks,
+    Memory_Sort_Column_Allocations
 };
 
-static u32 history_length = 0;
-static u32 history_watermark = 0;
+// Linear probing, capacities are powers of two
 static Memory_Record* memory_records = NULL;
+static u32 memory_records_capacity = 0;
+static u32 num_memory_records = 0;
 
-static u32 total_allocated_memory = 0;
+static Allocation_Site* allocation_sites = NULL;
+static u32 allocation_sites_capacity = 0;
+static u32 num_allocation_sites = 0;
+
+static s32* site_slots = NULL; // Index into allocation_sites or -1
+static u32 site_slots_capacity = 0;
+
+// Copied out under the lock, so the memory window can allocate while it draws them
+static Allocation_Site* site_snapshot = NULL;
+static u32 site_snapshot_capacity = 0;
+static Memory_Sort_Column memory_sort_column = Memory_Sort_Column_Live_Bytes;
+static bool memory_sort_ascending = false;
+
+static size_t total_allocated_memory = 0;
+static size_t peak_allocated_memory = 0;
+
+// Response builders allocate on a worker thread, so every access to the records goes through this.
+// Nothing which can allocate through MALLOC is allowed while it's held, that would lock it again
+static std::mutex memory_records_mutex;
 
 static void bytes_to_human_readable_size(size_t bytes, float& out_size, const char*& out_unit) {
     static const char* sizes[] = { "B", "kB", "MB", "GB" };
@@ -32,99 +72,338 @@ static void bytes_to_human_readable_size(size_t bytes, float& out_size, const ch
     out_size = (float)bytes + (float)rem / 1024.0f;
 }
 
-void draw_memory_records() {
-    {
-        const char *unit = "";
-        float size = 0.0f;
+static void text_human_readable_size(size_t bytes) {
+    const char* unit = "";
+    float size = 0.0f;
 
-        bytes_to_human_readable_size(total_allocated_memory, size, unit);
+    bytes_to_human_readable_size(bytes, size, unit);
 
-        ImGui::Text("Total memory occupied: %.1f %s", size, unit);
-        ImGui::Text("Total blocks: %i", history_length);
+    ImGui::Text("%.1f %s", size, unit);
+}
+
+static inline u32 hash_pointer(void* pointer) {
+    u64 bits = (u64) (uintptr_t) pointer;
+
+    bits ^= bits >> 33;
+    bits *= 0xff51afd7ed558ccdull;
+    bits ^= bits >> 33;
+
+    return (u32) bits;
+}
+
+static inline u32 hash_allocation_site(const char* file, u32 line) {
+    // The same header can be compiled into many files, so its __FILE__ can have different addresses
+    return XXH32(file, strlen(file), line);
+}
+
+static u32 find_or_add_allocation_site(const char* file, const char* function, u32 line) {
+    u32 hash = hash_allocation_site(file, line);
+
+    if (!site_slots_capacity) {
+        site_slots_capacity = 256;
+        site_slots = (s32*) malloc(sizeof(s32) * site_slots_capacity);
+        memset(site_slots, 0xff, sizeof(s32) * site_slots_capacity);
     }
 
-    ImGui::Columns(4, "memory_table", true);
+    u32 mask = site_slots_capacity - 1;
+    u32 slot = hash & mask;
 
-    for (u32 index = 0; index < history_length; index++) {
-        Memory_Record* record = &memory_records[index];
+    for (; site_slots[slot] != -1; slot = (slot + 1) & mask) {
+        Allocation_Site* site = &allocation_sites[site_slots[slot]];
 
-        const char* last_slash = strrchr(record->file, '/');
-        const char* file = last_slash ? (last_slash + 1) : record->file;
+        if (site->hash == hash && site->line == line && (site->file == file || strcmp(site->file, file) == 0)) {
+            return (u32) site_slots[slot];
+        }
+    }
 
-        ImGui::Text("%s", file);
+    if (num_allocation_sites == allocation_sites_capacity) {
+        allocation_sites_capacity = MAX(allocation_sites_capacity * 2, 256);
+        allocation_sites = (Allocation_Site*) realloc(allocation_sites, sizeof(Allocation_Site) * allocation_sites_capacity);
     }
 
-    ImGui::NextColumn();
+    u32 site_index = num_allocation_sites++;
+
+    Allocation_Site* site = &allocation_sites[site_index];
+    site->file = file;
+    site->function = function;
+    site->line = line;
+    site->hash = hash;
+    site->live_bytes = 0;
+    site->peak_bytes = 0;
+    site->live_blocks = 0;
+    site->num_allocations = 0;
+
+    site_slots[slot] = (s32) site_index;
 
-    for (u32 index = 0; index < history_length; index++) {
-        ImGui::Text("%s", (&memory_records[index])->function);
+    // Sites are never removed, so the slots only need to be rebuilt when growing
+    if (num_allocation_sites * 2 > site_slots_capacity) {
+        site_slots_capacity *= 2;
+        site_slots = (s32*) realloc(site_slots, sizeof(s32) * site_slots_capacity);
+        memset(site_slots, 0xff, sizeof(s32) * site_slots_capacity);
+
+        mask = site_slots_capacity - 1;
+
+        for (u32 index = 0; index < num_allocation_sites; index++) {
+            u32 new_slot = allocation_sites[index].hash & mask;
+
+            while (site_slots[new_slot] != -1) {
+                new_slot = (new_slot + 1) & mask;
+            }
+
+            site_slots[new_slot] = (s32) index;
+        }
     }
 
-    ImGui::NextColumn();
+    return site_index;
+}
+
+static void add_to_allocation_site(u32 site_index, size_t size) {
+    Allocation_Site* site = &allocation_sites[site_index];
 
-    for (u32 index = 0; index < history_length; index++) {
-        ImGui::Text("%p", (&memory_records[index])->pointer);
+    site->live_bytes += size;
+    site->live_blocks++;
+    site->num_allocations++;
+
+    if (site->live_bytes > site->peak_bytes) {
+        site->peak_bytes = site->live_bytes;
     }
 
-    ImGui::NextColumn();
+    total_allocated_memory += size;
+
+    if (total_allocated_memory > peak_allocated_memory) {
+        peak_allocated_memory = total_allocated_memory;
+    }
+}
 
-    for (u32 index = 0; index < history_length; index++) {
-        Memory_Record* record = &memory_records[index];
+static void remove_from_allocation_site(u32 site_index, size_t size) {
+    Allocation_Site* site = &allocation_sites[site_index];
 
-        const char* unit = "";
-        float size = 0.0f;
+    site->live_bytes -= size;
+    site->live_blocks--;
 
-        bytes_to_human_readable_size(record->size, size, unit);
+    total_allocated_memory -= size;
+}
 
-        ImGui::Text("%.1f %s", size, unit);
+static Memory_Record* find_memory_record(void* pointer) {
+    if (!memory_records_capacity) {
+        return NULL;
     }
 
+    u32 mask = memory_records_capacity - 1;
+
+    for (u32 slot = hash_pointer(pointer) & mask; memory_records[slot].pointer; slot = (slot + 1) & mask) {
+        if (memory_records[slot].pointer == pointer) {
+            return &memory_records[slot];
+        }
+    }
+
+    return NULL;
+}
+
+static void insert_memory_record(Memory_Record* records, u32 capacity, Memory_Record& record) {
+    u32 mask = capacity - 1;
+    u32 slot = hash_pointer(record.pointer) & mask;
+
+    while (records[slot].pointer) {
+        slot = (slot + 1) & mask;
+    }
+
+    records[slot] = record;
+}
+
+// Later records of the same probe run are shifted back into the hole, so no tombstones are needed
+static void remove_memory_record(Memory_Record* record) {
+    u32 mask = memory_records_capacity - 1;
+    u32 hole = (u32) (record - memory_records);
+
+    for (u32 slot = (hole + 1) & mask; memory_records[slot].pointer; slot = (slot + 1) & mask) {
+        u32 home = hash_pointer(memory_records[slot].pointer) & mask;
+
+        // Can only move back if its home slot is not between the hole and itself
+        if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+            memory_records[hole] = memory_records[slot];
+            hole = slot;
+        }
+    }
+
+    memory_records[hole].pointer = NULL;
+
+    num_memory_records--;
 }
 
 static void record_memory(void* pointer, const char* file, const char* function, u32 line, size_t size) {
+    if (!pointer) {
+        return;
+    }
+
+    if ((num_memory_records + 1) * 4 > memory_records_capacity * 3) {
+        u32 new_capacity = MAX(memory_records_capacity * 2, 4096);
+        Memory_Record* new_records = (Memory_Record*) calloc(new_capacity, sizeof(Memory_Record));
+
+        for (u32 slot = 0; slot < memory_records_capacity; slot++) {
+            if (memory_records[slot].pointer) {
+                insert_memory_record(new_records, new_capacity, memory_records[slot]);
+            }
+        }
+
+        free(memory_records);
+
+        memory_records = new_records;
+        memory_records_capacity = new_capacity;
+    }
+
     Memory_Record record;
     record.pointer = pointer;
     record.size = size;
-    record.file = file;
-    record.line = line;
-    record.function = function;
+    record.site = find_or_add_allocation_site(file, function, line);
+
+    add_to_allocation_site(record.site, size);
+    insert_memory_record(memory_records, memory_records_capacity, record);
+
+    num_memory_records++;
+}
+
+static int compare_allocation_sites(const void* ap, const void* bp) {
+    Allocation_Site* a = (Allocation_Site*) ap;
+    Allocation_Site* b = (Allocation_Site*) bp;
+
+    int result = 0;
+
+    switch (memory_sort_column) {
+        case Memory_Sort_Column_Site: {
+            result = strcmp(a->file, b->file);
+
+            if (!result) {
+                result = (a->line > b->line) - (a->line < b->line);
+            }
+
+            break;
+        }
+
+        case Memory_Sort_Column_Live_Bytes: {
+            result = (a->live_bytes > b->live_bytes) - (a->live_bytes < b->live_bytes);
+            break;
+        }
+
+        case Memory_Sort_Column_Peak_Bytes: {
+            result = (a->peak_bytes > b->peak_bytes) - (a->peak_bytes < b->peak_bytes);
+            break;
+        }
 
-    if (history_length == history_watermark) {
-        history_watermark += 1000;
-        memory_records = (Memory_Record*) realloc(memory_records, sizeof(Memory_Record) * history_watermark);
+        case Memory_Sort_Column_Live_Blocks: {
+            result = (a->live_blocks > b->live_blocks) - (a->live_blocks < b->live_blocks);
+            break;
+        }
+
+        case Memory_Sort_Column_Allocations: {
+            result = (a->num_allocations > b->num_allocations) - (a->num_allocations < b->num_allocations);
+            break;
+        }
     }
 
-    memory_records[history_length++] = record;
+    return memory_sort_ascending ? result : -result;
+}
+
+static void draw_memory_sort_header(const char* label, Memory_Sort_Column column) {
+    bool is_selected = memory_sort_column == column;
+
+    char* text_start;
+    char* text_end;
+
+    tprintf("%s%s", &text_start, &text_end, label, is_selected ? (memory_sort_ascending ? " ^" : " v") : "");
+
+    if (ImGui::Selectable(text_start, is_selected)) {
+        if (is_selected) {
+            memory_sort_ascending = !memory_sort_ascending;
+        } else {
+            memory_sort_column = column;
+            memory_sort_ascending = column == Memory_Sort_Column_Site;
+        }
+    }
+
+    ImGui::NextColumn();
 }
 
-/*
 void draw_memory_records() {
-    const u32 current_tail = total_recorded % history_length;
+    size_t total_memory;
+    size_t peak_memory;
+    u32 num_blocks;
+    u32 num_sites;
+
+    {
+        std::lock_guard<std::mutex> lock(memory_records_mutex);
+
+        total_memory = total_allocated_memory;
+        peak_memory = peak_allocated_memory;
+        num_blocks = num_memory_records;
+        num_sites = num_allocation_sites;
 
-    if (total_recorded > history_length){
-        for (u32 index = current_tail; index < history_length; index++) {
-            log_record(memory_records[index]);
+        // Plain realloc, MALLOC would record itself
+        if (site_snapshot_capacity < num_sites) {
+            site_snapshot_capacity = allocation_sites_capacity;
+            site_snapshot = (Allocation_Site*) realloc(site_snapshot, sizeof(Allocation_Site) * site_snapshot_capacity);
         }
+
+        memcpy(site_snapshot, allocation_sites, sizeof(Allocation_Site) * num_sites);
     }
 
-    for (u32 index = 0; index < current_tail; index++) {
-        log_record(memory_records[index]);
+    {
+        const char *unit = "";
+        float size = 0.0f;
+
+        bytes_to_human_readable_size(total_memory, size, unit);
+
+        ImGui::Text("Total memory occupied: %.1f %s", size, unit);
+
+        bytes_to_human_readable_size(peak_memory, size, unit);
+
+        ImGui::Text("Peak memory occupied: %.1f %s", size, unit);
+        ImGui::Text("Total blocks: %i, call sites: %i", num_blocks, num_sites);
     }
-}
 
-static void record_memory(void* pointer, const char* file, u32 line, size_t size) {
-    Memory_Record record;
-    record.pointer = pointer;
-    record.size = size;
-    record.file = file;
-    record.line = line;
+    qsort(site_snapshot, num_sites, sizeof(Allocation_Site), compare_allocation_sites);
+
+    ImGui::Columns(5, "memory_table", true);
+
+    draw_memory_sort_header("Call site", Memory_Sort_Column_Site);
+    draw_memory_sort_header("Live", Memory_Sort_Column_Live_Bytes);
+    draw_memory_sort_header("Peak", Memory_Sort_Column_Peak_Bytes);
+    draw_memory_sort_header("Blocks", Memory_Sort_Column_Live_Blocks);
+    draw_memory_sort_header("Allocations", Memory_Sort_Column_Allocations);
+
+    ImGui::Separator();
+
+    // Only the visible rows are submitted
+    ImGuiListClipper clipper(num_sites);
+
+    while (clipper.Step()) {
+        for (s32 row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+            Allocation_Site* site = &site_snapshot[row];
+            const char* last_slash = strrchr(site->file, '/');
+            const char* file = last_slash ? (last_slash + 1) : site->file;
+
+            ImGui::Text("%s:%i %s", file, site->line, site->function);
+            ImGui::NextColumn();
+
+            text_human_readable_size(site->live_bytes);
+            ImGui::NextColumn();
 
-    memory_records[total_recorded % history_length] = record;
-    total_recorded++;
-}*/
+            text_human_readable_size(site->peak_bytes);
+            ImGui::NextColumn();
+
+            ImGui::Text("%i", site->live_blocks);
+            ImGui::NextColumn();
+
+            ImGui::Text("%i", site->num_allocations);
+            ImGui::NextColumn();
+        }
+    }
+
+    ImGui::Columns(1);
+}
 
 void log_memory(const char* file, const char* function, u32 line, void* pointer, size_t size) {
-    total_allocated_memory += size;
+    std::lock_guard<std::mutex> lock(memory_records_mutex);
 
     record_memory(pointer, file, function, line, size);
 }
@@ -132,7 +411,7 @@ void log_memory(const char* file, const char* function, u32 line, void* pointer,
 void* malloc_and_log(const char* file, const char* function, u32 line, size_t size) {
     void* pointer = malloc(size);
 
-    total_allocated_memory += size;
+    std::lock_guard<std::mutex> lock(memory_records_mutex);
 
     record_memory(pointer, file, function, line, size);
 
@@ -142,7 +421,7 @@ void* malloc_and_log(const char* file, const char* function, u32 line, size_t si
 void* calloc_and_log(const char* file, const char* function, u32 line, size_t num, size_t size) {
     void* pointer = calloc(num, size);
 
-    total_allocated_memory += size * num;
+    std::lock_guard<std::mutex> lock(memory_records_mutex);
 
     record_memory(pointer, file, function, line, size * num);
 
@@ -151,23 +430,20 @@ void* calloc_and_log(const char* file, const char* function, u32 line, size_t nu
 
 void* realloc_and_log(const char* file, const char* function, u32 line, void* realloc_what, size_t new_size) {
     if (realloc_what) {
-        void* pointer = realloc(realloc_what, new_size);
+        std::lock_guard<std::mutex> lock(memory_records_mutex);
 
-        for (u32 index = 0; index < history_length; index++) {
-            Memory_Record& old_record = memory_records[index];
+        void* pointer = realloc(realloc_what, new_size);
 
-            if (old_record.pointer == realloc_what) {
-                old_record.pointer = pointer;
+        Memory_Record* old_record = find_memory_record(realloc_what);
 
-                total_allocated_memory -= old_record.size;
-                total_allocated_memory += new_size;
+        if (old_record) {
+            // Like before, the block is attributed to the site which reallocated it last
+            remove_from_allocation_site(old_record->site, old_record->size);
+            remove_memory_record(old_record);
 
-                old_record.size = new_size;
-                old_record.file = file;
-                old_record.line = line;
+            record_memory(pointer, file, function, line, new_size);
 
-                return pointer;
-            }
+            return pointer;
         }
 
         printf("WARNING: Reallocation of an unmanaged pointer %p with size %zu at %s %s:%i\n", realloc_what, new_size, function, file, line);
@@ -179,23 +455,22 @@ void* realloc_and_log(const char* file, const char* function, u32 line, void* re
 }
 
 void free_and_log(const char* file, const char* function, u32 line, void* free_what) {
-    free(free_what);
+    std::lock_guard<std::mutex> lock(memory_records_mutex);
 
-    for (u32 index = 0; index < history_length; index++) {
-        Memory_Record& old_record = memory_records[index];
+    free(free_what);
 
-        if (old_record.pointer == free_what) {
-            total_allocated_memory -= old_record.size;
+    if (!free_what) {
+        return;
+    }
 
-            if (history_length > 1) {
-                old_record = memory_records[history_length - 1];
-            }
+    Memory_Record* old_record = find_memory_record(free_what);
 
-            history_length--;
+    if (old_record) {
+        remove_from_allocation_site(old_record->site, old_record->size);
+        remove_memory_record(old_record);
 
-            return;
-        }
+        return;
     }
 
     printf("WARNING: Freeing of an unmanaged pointer %p at %s %s:%i\n", free_what, function, file, line);
-}
\ No newline at end of file
+}
@@ -1,6 +1,8 @@
 #include "users.h"
 #include "json.h"
 #include "id_hash_map.h"
+#include "search.h"
+#include "string_pool.h"
 
 Lazy_Array<User, 32> users{};
 Array<User_Handle> suggested_users{};
@@ -20,17 +22,30 @@ static Id_Hash_Map<User_Id, s32, -1> id_to_user_map{};
 // TODO to be loaded at the end of a frame
 static Id_Hash_Map<User_Id, bool, false> id_to_is_user_requested{};
 
-static User_Handle process_users_data_object(char* json, jsmntok_t*&token) {
+// Full names, documents are user handles
+static Trigram_Index user_name_index;
+static Search_Results user_search_results{};
+static const u32 max_user_search_results = 256;
+
+#define USER_KEYS(KEY) \
+    KEY(User_Key_Id, "id") \
+    KEY(User_Key_First_Name, "firstName") \
+    KEY(User_Key_Last_Name, "lastName") \
+    KEY(User_Key_Avatar_Url, "avatarUrl") \
+    KEY(User_Key_Me, "me")
+
+DEFINE_JSON_KEYS(User_Key, json_to_user_key, USER_KEYS)
+
+// Doesn't touch any global state, so it can run on a worker thread
+static void parse_user_object(User* user, bool* is_me, char* json, jsmntok_t*& token) {
     jsmntok_t* object_token = token++;
 
     assert(object_token->type == JSMN_OBJECT);
 
-    User_Handle user_handle = User_Handle(users.length);
-    User* user = &users[users.length++];
-
     user->avatar_request_id = NO_REQUEST;
     user->avatar = {};
-    user->loaded_at = tick;
+
+    *is_me = false;
 
     for (u32 propety_index = 0; propety_index < object_token->size; propety_index++, token++) {
         jsmntok_t* property_token = token++;
@@ -39,32 +54,87 @@ static User_Handle process_users_data_object(char* json, jsmntok_t*&token) {
 
         jsmntok_t* next_token = token;
 
-        if (json_string_equals(json, property_token, "id")) {
-            json_token_to_id8(json, next_token, user->id);
-        } else if (json_string_equals(json, property_token, "firstName")) {
-            json_token_to_string(json, next_token, user->first_name);
-        } else if (json_string_equals(json, property_token, "lastName")) {
-            json_token_to_string(json, next_token, user->last_name);
-        } else if (json_string_equals(json, property_token, "avatarUrl")) {
-            json_token_to_string(json, next_token, user->avatar_url);
-        } else if (json_string_equals(json, property_token, "me")) {
-            if (this_user == NULL_USER_HANDLE && *(json + next_token->start) == 't') {
-                this_user = user_handle;
+        switch (json_to_user_key(json, property_token)) {
+            case User_Key_Id: {
+                json_token_to_id8(json, next_token, user->id);
+                break;
+            }
+
+            case User_Key_First_Name: {
+                json_token_to_string(json, next_token, user->first_name);
+                break;
+            }
+
+            case User_Key_Last_Name: {
+                json_token_to_string(json, next_token, user->last_name);
+                break;
+            }
+
+            case User_Key_Avatar_Url: {
+                json_token_to_string(json, next_token, user->avatar_url);
+                break;
+            }
+
+            case User_Key_Me: {
+                *is_me = *(json + next_token->start) == 't';
+                break;
+            }
+
+            default: {
+                json_skip(token);
+                token--;
             }
-        } else {
-            eat_json(token);
-            token--;
         }
     }
+}
+
+static User_Handle add_parsed_user(User* parsed_user, bool is_me) {
+    User_Handle user_handle = User_Handle(users.length);
+    User* user = &users[users.length++];
+
+    *user = *parsed_user;
+    user->first_name = intern_string(parsed_user->first_name);
+    user->last_name = intern_string(parsed_user->last_name);
+    user->avatar_url = intern_string(parsed_user->avatar_url);
+    user->loaded_at = tick;
+
+    if (is_me && this_user == NULL_USER_HANDLE) {
+        this_user = user_handle;
+    }
 
     id_hash_map_put(&id_to_user_map, (s32) user_handle, user->id, hash_id(user->id));
 
+    String full_name = full_user_name_to_temporary_string(user);
+
+    trigram_index_set(user_name_index, (u32) (s32) user_handle, full_name.start, full_name.length);
+
     return user_handle;
 }
 
+static User_Handle process_users_data_object(char* json, jsmntok_t*&token) {
+    User user;
+    bool is_me;
+
+    parse_user_object(&user, &is_me, json, token);
+
+    return add_parsed_user(&user, is_me);
+}
+
 void init_user_storage() {
     id_hash_map_init(&id_to_is_user_requested);
     id_hash_map_init(&id_to_user_map);
+    trigram_index_init(user_name_index);
+}
+
+void fuzzy_search_users(const char* query, Array<User_Handle>* result) {
+    trigram_index_fuzzy_search(user_name_index, query, (u32) strlen(query), max_user_search_results, user_search_results);
+
+    result->data = (User_Handle*) REALLOC(result->data, sizeof(User_Handle) * MAX(1, user_search_results.length));
+    result->length = user_search_results.length;
+
+    for (u32 index = 0; index < user_search_results.length; index++) {
+        result->data[index] = User_Handle((s32) user_search_results.matches[index].document);
+    }
 }
 
 void process_users_data(char* json, u32 data_size, jsmntok_t*&token) {
@@ -75,6 +145,49 @@ void process_users_data(char* json, u32 data_size, jsmntok_t*&token) {
     }
 }
 
+void* build_users_batch(char* json, jsmntok_t* tokens, u32 num_tokens, void* data) {
+    jsmntok_t* data_token = json_find_data_array(json, tokens, num_tokens);
+
+    if (!data_token) {
+        return NULL;
+    }
+
+    u32 data_size = (u32) data_token->size;
+
+    User_Batch* batch = (User_Batch*) MALLOC(sizeof(User_Batch));
+    batch->users.length = 0;
+    batch->users.data = (User*) MALLOC(sizeof(User) * MAX(1, data_size));
+    batch->is_me = (bool*) MALLOC(sizeof(bool) * MAX(1, data_size));
+
+    jsmntok_t* token = data_token + 1;
+
+    for (u32 array_index = 0; array_index < data_size; array_index++) {
+        u32 user_index = batch->users.length++;
+
+        parse_user_object(&batch->users[user_index], &batch->is_me[user_index], json, token);
+    }
+
+    return batch;
+}
+
+void publish_users_batch(void* prepared_batch) {
+    User_Batch* batch = (User_Batch*) prepared_batch;
+
+    if (!batch) {
+        return;
+    }
+
+    lazy_array_reserve_n_values(users, batch->users.length);
+
+    for (u32 index = 0; index < batch->users.length; index++) {
+        add_parsed_user(&batch->users[index], batch->is_me[index]);
+    }
+
+    FREE(batch->is_me);
+    FREE(batch->users.data);
+    FREE(batch);
+}
+
 void process_suggested_users_data(char* json, u32 data_size, jsmntok_t*&token) {
     if (suggested_users.length < data_size) {
         suggested_users.data = (User_Handle*) REALLOC(suggested_users.data, sizeof(User_Handle) * data_size);
@@ -20,6 +20,12 @@ struct User {
 
 using User_Handle = Entity_Handle<User>;
 
+// Users parsed off the main thread, strings still point into the response
+struct User_Batch {
+    Array<User> users;
+    bool* is_me;
+};
+
 extern Lazy_Array<User, 32> users;
 extern Array<User_Handle> suggested_users;
 
@@ -31,12 +37,18 @@ void init_user_storage();
 void process_users_data(char* json, u32 data_size, jsmntok_t*& token);
 void process_suggested_users_data(char* json, u32 data_size, jsmntok_t*&token);
 
+void* build_users_batch(char* json, jsmntok_t* tokens, u32 num_tokens, void* data);
+void publish_users_batch(void* prepared_batch);
+
 bool is_user_requested(User_Id id, u32 id_hash = 0);
 User_Handle find_user_handle_by_id(User_Id id, u32 id_hash = 0);
 User* find_user_by_id(User_Id id, u32 id_hash = 0);
 User* find_user_by_avatar_request_id(Request_Id avatar_request_id);
 User* get_user_by_handle(User_Handle handle);
 
+// Typo tolerant, by full name, best matches first
+void fuzzy_search_users(const char* query, Array<User_Handle>* result);
+
 void mark_user_as_requested(User_Id id, u32 id_hash = 0);
 
 bool check_and_request_user_avatar_if_necessary(User* user);
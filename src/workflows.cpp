@@ -2,6 +2,7 @@
 #include "json.h"
 #include "id_hash_map.h"
 #include "workflows.h"
+#include "string_pool.h"
 
 Array<Workflow> workflows{};
 
@@ -92,6 +93,23 @@ static u32 status_group_to_color(Status_Group group) {
     }
 }
 
+#define CUSTOM_STATUS_KEYS(KEY) \
+    KEY(Custom_Status_Key_Id, "id") \
+    KEY(Custom_Status_Key_Name, "name") \
+    KEY(Custom_Status_Key_Standard, "standard") \
+    KEY(Custom_Status_Key_Hidden, "hidden") \
+    KEY(Custom_Status_Key_Color, "color") \
+    KEY(Custom_Status_Key_Group, "group")
+
+DEFINE_JSON_KEYS(Custom_Status_Key, json_to_custom_status_key, CUSTOM_STATUS_KEYS)
+
+#define WORKFLOW_KEYS(KEY) \
+    KEY(Workflow_Key_Id, "id") \
+    KEY(Workflow_Key_Name, "name") \
+    KEY(Workflow_Key_Custom_Statuses, "customStatuses")
+
+DEFINE_JSON_KEYS(Workflow_Key, json_to_workflow_key, WORKFLOW_KEYS)
+
 static void process_custom_status(Workflow* workflow, char* json, jsmntok_t*& token, u32 natural_index) {
     jsmntok_t* object_token = token++;
 
@@ -114,27 +132,50 @@ static void process_custom_status(Workflow* workflow, char* json, jsmntok_t*& to
 
         jsmntok_t* next_token = token;
 
-        if (json_string_equals(json, property_token, "id")) {
-            json_token_to_right_part_of_id16(json, next_token, custom_status->id);
-        } else if (json_string_equals(json, property_token, "name")) {
-            json_token_to_string(json, next_token, custom_status->name);
-        } else if (json_string_equals(json, property_token, "standard")) {
-            is_standard = *(json + next_token->start) == 't';
-        } else if (json_string_equals(json, property_token, "hidden")) {
-            custom_status->is_hidden = *(json + next_token->start) == 't';
-        } else if (json_string_equals(json, property_token, "color")) {
-            String color_name;
-            json_token_to_string(json, next_token, color_name);
-
-            custom_status->color = argb_to_agbr(color_name_to_color_argb(color_name));
-        } else if (json_string_equals(json, property_token, "group")) {
-            String group_name;
-            json_token_to_string(json, next_token, group_name);
-
-            custom_status->group = status_group_name_to_status_group(group_name);
-        } else {
-            eat_json(token);
-            token--;
+        switch (json_to_custom_status_key(json, property_token)) {
+            case Custom_Status_Key_Id: {
+                json_token_to_right_part_of_id16(json, next_token, custom_status->id);
+                break;
+            }
+
+            case Custom_Status_Key_Name: {
+                String name;
+                json_token_to_string(json, next_token, name);
+
+                custom_status->name = intern_string(name);
+                break;
+            }
+
+            case Custom_Status_Key_Standard: {
+                is_standard = *(json + next_token->start) == 't';
+                break;
+            }
+
+            case Custom_Status_Key_Hidden: {
+                custom_status->is_hidden = *(json + next_token->start) == 't';
+                break;
+            }
+
+            case Custom_Status_Key_Color: {
+                String color_name;
+                json_token_to_string(json, next_token, color_name);
+
+                custom_status->color = argb_to_agbr(color_name_to_color_argb(color_name));
+                break;
+            }
+
+            case Custom_Status_Key_Group: {
+                String group_name;
+                json_token_to_string(json, next_token, group_name);
+
+                custom_status->group = status_group_name_to_status_group(group_name);
+                break;
+            }
+
+            default: {
+                json_skip(token);
+                token--;
+            }
         }
     }
 
@@ -164,21 +205,19 @@ void process_workflows_data(char* json, u32 data_size, jsmntok_t*&token) {
 
             jsmntok_t* next_token = token;
 
-            if (json_string_equals(json, property_token, "customStatuses")) {
+            if (json_to_workflow_key(json, property_token) == Workflow_Key_Custom_Statuses) {
                 total_statuses += next_token->size;
             }
 
-            eat_json(token);
+            json_skip(token);
             token--;
         }
     }
 
     token = json_start;
 
-    // TODO hacky, we need to clear the map when it's populated too
-    if (id_to_custom_status.size == 0) {
-        id_hash_map_init(&id_to_custom_status);
-    }
+    id_hash_map_clear(&id_to_custom_status);
+    id_hash_map_reserve(&id_to_custom_status, total_statuses);
 
     if (workflows.length < data_size) {
         workflows.data = (Workflow*) REALLOC(workflows.data, sizeof(Workflow) * data_size);
@@ -205,26 +244,40 @@ void process_workflows_data(char* json, u32 data_size, jsmntok_t*&token) {
 
             jsmntok_t* next_token = token;
 
-            if (json_string_equals(json, property_token, "id")) {
-                json_token_to_right_part_of_id16(json, next_token, workflow->id);
-            } else if (json_string_equals(json, property_token, "name")) {
-                json_token_to_string(json, next_token, workflow->name);
-            } else if (json_string_equals(json, property_token, "customStatuses")) {
-                assert(next_token->type == JSMN_ARRAY);
+            switch (json_to_workflow_key(json, property_token)) {
+                case Workflow_Key_Id: {
+                    json_token_to_right_part_of_id16(json, next_token, workflow->id);
+                    break;
+                }
+
+                case Workflow_Key_Name: {
+                    String name;
+                    json_token_to_string(json, next_token, name);
+
+                    workflow->name = intern_string(name);
+                    break;
+                }
+
+                case Workflow_Key_Custom_Statuses: {
+                    assert(next_token->type == JSMN_ARRAY);
 
-                token++;
+                    token++;
 
-                workflow->statuses.data = &custom_statuses[custom_statuses.length];
-                workflow->statuses.length = (u32) next_token->size;
+                    workflow->statuses.data = &custom_statuses[custom_statuses.length];
+                    workflow->statuses.length = (u32) next_token->size;
 
-                for (u32 status_index = 0; status_index < next_token->size; status_index++) {
-                    process_custom_status(workflow, json, token, status_index);
+                    for (u32 status_index = 0; status_index < next_token->size; status_index++) {
+                        process_custom_status(workflow, json, token, status_index);
+                    }
+
+                    token--;
+                    break;
                 }
 
-                token--;
-            } else {
-                eat_json(token);
-                token--;
+                default: {
+                    json_skip(token);
+                    token--;
+                }
             }
         }
     }